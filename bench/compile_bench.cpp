@@ -0,0 +1,357 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+// 用 -O0, -O2 和 -O3 重复编译 test 目录中的 lua, sqlite, 8cc 和 zcc,
+// 每个文件单独编译 (-c), 记录总耗时, 各阶段耗时, 峰值内存和目标文件大小,
+// 取耗时的中位数, 与保存的基线比较, 超过阈值时返回失败
+// 计时的编译不使用 -print-stats, 各阶段耗时和峰值内存由额外的一次编译收集
+// 用法: compile_bench kcc test_dir baseline [iterations] [threshold] [--update]
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace {
+
+struct Corpus {
+  std::string name;
+  std::string dir;
+  // 为空时编译目录中所有的 .c 文件, 否则只编译存在的文件
+  std::vector<std::string> files;
+  std::vector<std::string> flags;
+};
+
+struct Result {
+  double wall_ms{};
+  std::map<std::string, double> phases_ms;
+  std::int64_t max_rss_kb{};
+  std::int64_t object_bytes{};
+};
+
+// 与 CMakeLists.txt 中的测试使用相同的选项
+std::vector<Corpus> GetCorpora(const std::filesystem::path &test_dir) {
+  return {
+      {"lua",
+       "lua",
+       {},
+       {"-DLUA_USER_H=\"ltests.h\"", "-DLUA_USE_LINUX", "-DLUA_COMPAT_5_2"}},
+      {"sqlite",
+       "sqlite",
+       {"shell.c", "speedtest1.c", "sqlite3.c"},
+       {"-DSQLITE_DEFAULT_MEMSTATUS=0", "-DSQLITE_DQS=0",
+        "-DSQLITE_ENABLE_DBSTAT_VTAB", "-DSQLITE_ENABLE_FTS5",
+        "-DSQLITE_ENABLE_GEOPOLY", "-DSQLITE_ENABLE_JSON1",
+        "-DSQLITE_ENABLE_RBU", "-DSQLITE_ENABLE_RTREE",
+        "-DSQLITE_LIKE_DOESNT_MATCH_BLOBS", "-DSQLITE_MAX_EXPR_DEPTH=0",
+        "-DSQLITE_OMIT_DECLTYPE", "-DSQLITE_OMIT_DEPRECATED",
+        "-DSQLITE_USE_ALLOCA", "-DSQLITE_ENABLE_MEMSYS5"}},
+      {"8cc",
+       "8cc",
+       {},
+       {"-DBUILD_DIR=\"" + (test_dir / "8cc").string() + "\""}},
+      {"zcc", "zcc", {}, {}}};
+}
+
+std::vector<std::string> GetFiles(const Corpus &corpus,
+                                  const std::filesystem::path &test_dir) {
+  auto dir{test_dir / corpus.dir};
+  std::vector<std::string> files;
+
+  if (std::empty(corpus.files)) {
+    for (const auto &file : std::filesystem::directory_iterator{dir}) {
+      if (file.path().extension() == ".c") {
+        files.push_back(file.path().string());
+      }
+    }
+    std::sort(std::begin(files), std::end(files));
+  } else {
+    for (const auto &file : corpus.files) {
+      if (std::filesystem::exists(dir / file)) {
+        files.push_back((dir / file).string());
+      }
+    }
+  }
+
+  return files;
+}
+
+std::string ReadFile(const std::string &file_name) {
+  auto buffer{llvm::MemoryBuffer::getFile(file_name)};
+  if (!buffer) {
+    throw std::runtime_error{"can not read file: " + file_name};
+  }
+  return (*buffer)->getBuffer().str();
+}
+
+// -print-stats 的输出中只有一个翻译单元
+void AddStats(Result &result, const std::string &stats) {
+  auto json{llvm::json::parse(stats)};
+  if (!json) {
+    throw std::runtime_error{"invalid -print-stats output: " +
+                             llvm::toString(json.takeError())};
+  }
+
+  auto report{json->getAsObject()};
+  if (report == nullptr || report->getArray("files") == nullptr) {
+    throw std::runtime_error{"invalid -print-stats output"};
+  }
+
+  if (auto max_rss{report->getInteger("max_rss_kb")}) {
+    result.max_rss_kb = std::max(result.max_rss_kb, *max_rss);
+  }
+
+  for (const auto &file : *report->getArray("files")) {
+    auto object{file.getAsObject()};
+    auto phases{object ? object->getObject("phase_times_ms") : nullptr};
+    if (phases == nullptr) {
+      continue;
+    }
+
+    for (const auto &[phase, time] : *phases) {
+      result.phases_ms[phase.str()] += time.getAsNumber().getValueOr(0);
+    }
+  }
+}
+
+Result Compile(const std::string &kcc, const std::vector<std::string> &files,
+               const std::vector<std::string> &flags, std::string_view level,
+               const std::string &tmp_dir, bool print_stats) {
+  Result result;
+  auto obj_file{tmp_dir + "/bench.o"};
+  auto stats_file{tmp_dir + "/stats.json"};
+
+  for (const auto &file : files) {
+    std::vector<llvm::StringRef> args{kcc,
+                                      file,
+                                      "-c",
+                                      "-o",
+                                      obj_file,
+                                      {std::data(level), std::size(level)},
+                                      "-std=gnu17"};
+    if (print_stats) {
+      args.push_back("-print-stats");
+    }
+    for (const auto &flag : flags) {
+      args.push_back(flag);
+    }
+
+    // 不关心编译器的警告
+    llvm::Optional<llvm::StringRef> redirects[]{
+        llvm::None, llvm::StringRef{},
+        print_stats ? llvm::StringRef{stats_file} : llvm::StringRef{}};
+
+    auto begin{std::chrono::steady_clock::now()};
+    std::string error;
+    auto status{llvm::sys::ExecuteAndWait(kcc, args, llvm::None, redirects, 0,
+                                          0, &error)};
+    result.wall_ms += std::chrono::duration<double, std::milli>{
+        std::chrono::steady_clock::now() - begin}
+                          .count();
+
+    if (status != 0) {
+      throw std::runtime_error{"failed to compile " + file + ": " + error};
+    }
+
+    if (print_stats) {
+      AddStats(result, ReadFile(stats_file));
+    }
+    result.object_bytes +=
+        static_cast<std::int64_t>(std::filesystem::file_size(obj_file));
+  }
+
+  return result;
+}
+
+llvm::json::Value ToJson(const Result &result) {
+  llvm::json::Object phases;
+  for (const auto &[phase, time] : result.phases_ms) {
+    phases[phase] = time;
+  }
+
+  return llvm::json::Object{{"wall_ms", result.wall_ms},
+                            {"phases_ms", std::move(phases)},
+                            {"max_rss_kb", result.max_rss_kb},
+                            {"object_bytes", result.object_bytes}};
+}
+
+// 基线很小的值波动较大, 不参与比较
+constexpr double MinComparedMs{10};
+
+bool Compare(const std::string &name, const Result &result,
+             const llvm::json::Object *baseline, double threshold) {
+  if (baseline == nullptr) {
+    fmt::print("{}: no baseline\n", name);
+    return true;
+  }
+
+  bool ok{true};
+  auto check{[&](const std::string &metric, std::optional<double> base,
+                 double curr, double min_base) {
+    if (!base || *base < min_base || curr <= *base * (1 + threshold)) {
+      return;
+    }
+
+    fmt::print("{}: REGRESSION in {}: {:.1f} -> {:.1f} (+{:.1f}%)\n", name,
+               metric, *base, curr, (curr / *base - 1) * 100);
+    ok = false;
+  }};
+  auto get{[](const llvm::json::Object *object,
+              llvm::StringRef key) -> std::optional<double> {
+    if (object == nullptr) {
+      return {};
+    }
+    if (auto value{object->getNumber(key)}) {
+      return *value;
+    }
+    return {};
+  }};
+
+  check("wall_ms", get(baseline, "wall_ms"), result.wall_ms, MinComparedMs);
+  for (const auto &[phase, time] : result.phases_ms) {
+    check(phase + " ms", get(baseline->getObject("phases_ms"), phase), time,
+          MinComparedMs);
+  }
+  check("max_rss_kb", get(baseline, "max_rss_kb"),
+        static_cast<double>(result.max_rss_kb), 0);
+  check("object_bytes", get(baseline, "object_bytes"),
+        static_cast<double>(result.object_bytes), 0);
+
+  return ok;
+}
+
+void WriteJson(const std::string &file_name, llvm::json::Value value) {
+  std::error_code error_code;
+  llvm::raw_fd_ostream os{file_name, error_code, llvm::sys::fs::F_Text};
+  if (error_code) {
+    throw std::runtime_error{"can not open file: " + file_name};
+  }
+  os << llvm::formatv("{0:2}", value) << '\n';
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) try {
+  if (argc < 4) {
+    fmt::print(stderr,
+               "usage: {} kcc test_dir baseline [iterations] [threshold] "
+               "[--update]\n",
+               argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::string kcc{argv[1]};
+  std::filesystem::path test_dir{argv[2]};
+  std::string baseline_file{argv[3]};
+  std::int32_t iterations{argc > 4 ? std::stoi(argv[4]) : 3};
+  double threshold{argc > 5 ? std::stod(argv[5]) : 0.1};
+  bool update{argc > 6 && std::string_view{argv[6]} == "--update"};
+
+  if (iterations < 1) {
+    throw std::runtime_error{"iterations must be at least 1, got " +
+                             std::to_string(iterations)};
+  }
+
+  llvm::Optional<llvm::json::Value> baseline;
+  if (!update && std::filesystem::exists(baseline_file)) {
+    auto json{llvm::json::parse(ReadFile(baseline_file))};
+    if (!json) {
+      throw std::runtime_error{"invalid baseline: " +
+                               llvm::toString(json.takeError())};
+    }
+    baseline = std::move(*json);
+  }
+
+  llvm::SmallString<128> tmp_dir;
+  if (auto error_code{
+          llvm::sys::fs::createUniqueDirectory("kcc-bench", tmp_dir)}) {
+    throw std::runtime_error{"can not create temporary directory: " +
+                             error_code.message()};
+  }
+
+  llvm::json::Object results;
+  bool ok{true};
+
+  fmt::print("{:<14}{:>12}{:>12}{:>12}{:>14}\n", "corpus", "wall ms",
+             "opt ms", "rss KB", "object bytes");
+
+  for (const auto &corpus : GetCorpora(test_dir)) {
+    auto files{GetFiles(corpus, test_dir)};
+    if (std::empty(files)) {
+      continue;
+    }
+
+    for (std::string_view level : {"-O0", "-O2", "-O3"}) {
+      std::vector<Result> runs;
+      for (std::int32_t i{}; i < iterations; ++i) {
+        runs.push_back(Compile(kcc, files, corpus.flags, level,
+                               tmp_dir.str().str(), false));
+      }
+
+      std::sort(std::begin(runs), std::end(runs),
+                [](const Result &lhs, const Result &rhs) {
+                  return lhs.wall_ms < rhs.wall_ms;
+                });
+      auto median{runs[std::size(runs) / 2]};
+
+      // 收集各阶段耗时和峰值内存, 这次编译不计时
+      auto stats{Compile(kcc, files, corpus.flags, level, tmp_dir.str().str(),
+                         true)};
+      median.phases_ms = std::move(stats.phases_ms);
+      median.max_rss_kb = stats.max_rss_kb;
+
+      auto name{corpus.name + std::string{level}};
+      fmt::print("{:<14}{:>12.1f}{:>12.1f}{:>12}{:>14}\n", name,
+                 median.wall_ms, median.phases_ms.count("Optimization")
+                                     ? median.phases_ms.at("Optimization")
+                                     : 0.0,
+                 median.max_rss_kb, median.object_bytes);
+
+      if (!update) {
+        const llvm::json::Object *base{};
+        if (baseline && baseline->getAsObject()) {
+          base = baseline->getAsObject()->getObject(name);
+        }
+        ok = Compare(name, median, base, threshold) && ok;
+      }
+
+      results[name] = ToJson(median);
+    }
+  }
+
+  std::filesystem::remove_all(tmp_dir.str().str());
+
+  WriteJson("compile_bench.json", llvm::json::Object{results});
+  if (update) {
+    WriteJson(baseline_file, std::move(results));
+    fmt::print("baseline written to {}\n", baseline_file);
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+} catch (const std::exception &err) {
+  fmt::print(stderr, "error: {}\n", err.what());
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,55 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+// 词法分析的吞吐量, 输入先经过预处理, 只统计 Tokenize 的时间
+// 用法: lex_bench file [iterations]
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iterator>
+#include <string>
+
+#include <fmt/core.h>
+
+#include "cpp.h"
+#include "lex.h"
+#include "llvm_common.h"
+
+int main(int argc, char *argv[]) try {
+  if (argc < 2) {
+    fmt::print(stderr, "usage: {} file [iterations]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::string file_name{argv[1]};
+  std::int32_t iterations{argc > 2 ? std::stoi(argv[2]) : 20};
+
+  kcc::InitLLVM();
+  kcc::InitCompilationContext();
+
+  kcc::Preprocessor preprocessor;
+  auto code{preprocessor.Cpp(file_name)};
+
+  std::chrono::duration<double> elapsed{};
+  std::size_t tokens{};
+
+  for (std::int32_t i{}; i < iterations; ++i) {
+    kcc::Scanner scanner{code};
+
+    auto begin{std::chrono::steady_clock::now()};
+    tokens = std::size(scanner.Tokenize());
+    elapsed += std::chrono::steady_clock::now() - begin;
+  }
+
+  auto mb{static_cast<double>(std::size(code)) / (1024 * 1024)};
+  fmt::print("{}: {:.2f} MB, {} tokens, {} iterations, {:.1f} MB/s\n",
+             file_name, mb, tokens, iterations,
+             mb * iterations / elapsed.count());
+} catch (const std::exception &err) {
+  fmt::print(stderr, "error: {}\n", err.what());
+  return EXIT_FAILURE;
+}
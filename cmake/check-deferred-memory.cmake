@@ -0,0 +1,41 @@
+# cmake -DKCC=<kcc> -DWORK_DIR=<dir> [-DCOUNT=<n>] -P
+# 生成 COUNT 个 static 函数, 每个只被之后定义的函数引用, 因此全部推迟生成,
+# 检查同时保留的函数体所占内存 (包括块中未使用的部分) 平均每个不超过
+# per_func_limit, 即远小于 AstContext 的一个完整的块
+
+if(NOT COUNT)
+  set(COUNT 500)
+endif()
+set(per_func_limit 16384)
+
+set(source ${WORK_DIR}/deferred_statics.c)
+set(code "static int f1(int x) { return x + 1; }\n")
+foreach(i RANGE 2 ${COUNT})
+  math(EXPR prev "${i} - 1")
+  string(APPEND code "static int f${i}(int x) {\n"
+                     "  int y = x * ${i};\n"
+                     "  return f${prev}(y) + y;\n"
+                     "}\n")
+endforeach()
+string(APPEND code "int entry(int x) { return f${COUNT}(x); }\n")
+file(WRITE ${source} "${code}")
+
+execute_process(
+  COMMAND ${KCC} ${source} -c -O0 -std=gnu17 -print-stats -o
+          ${WORK_DIR}/deferred_statics.o
+  RESULT_VARIABLE result
+  ERROR_VARIABLE stats)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "failed to compile ${source}:\n${stats}")
+endif()
+
+if(NOT stats MATCHES "\"deferred_body_peak_reserved_bytes\": ([0-9]+)")
+  message(FATAL_ERROR "deferred_body_peak_reserved_bytes not found:\n${stats}")
+endif()
+set(bytes ${CMAKE_MATCH_1})
+
+math(EXPR limit "${COUNT} * ${per_func_limit}")
+if(bytes GREATER limit)
+  message(FATAL_ERROR "${COUNT} deferred functions reserve ${bytes} bytes, "
+                      "more than ${limit}")
+endif()
@@ -0,0 +1,10 @@
+# cmake -DIR_FILE=<file.ll> -DCALLEES=<func;...> -P
+# IR 中不能有对 CALLEES 中的函数的调用, 即它们都已经被内联
+
+file(READ ${IR_FILE} ir)
+
+foreach(name ${CALLEES})
+  if(ir MATCHES "call [^\n]*@${name}\\(")
+    message(FATAL_ERROR "${name}: call not inlined")
+  endif()
+endforeach()
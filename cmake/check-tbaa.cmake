@@ -0,0 +1,27 @@
+# cmake -DIR_FILE=<file.ll> -DNO_TBAA=<func;...> -DTBAA=<func;...> -P
+# NO_TBAA 中的函数的访存都没有 !tbaa, TBAA 中的函数的访存有 !tbaa
+
+file(READ ${IR_FILE} ir)
+
+function(get_function_body name body)
+  string(REGEX MATCH "define [^\n]*@${name}\\([^\n]*\n([^}]|}[^\n])*\n}" match
+               "${ir}")
+  if(NOT match)
+    message(FATAL_ERROR "function ${name} not found in ${IR_FILE}")
+  endif()
+  set(${body} "${match}" PARENT_SCOPE)
+endfunction()
+
+foreach(name ${NO_TBAA})
+  get_function_body(${name} body)
+  if(body MATCHES "!tbaa")
+    message(FATAL_ERROR "${name}: access through union has a !tbaa tag")
+  endif()
+endforeach()
+
+foreach(name ${TBAA})
+  get_function_body(${name} body)
+  if(NOT body MATCHES "!tbaa")
+    message(FATAL_ERROR "${name}: !tbaa tag expected")
+  endif()
+endforeach()
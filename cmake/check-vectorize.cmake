@@ -0,0 +1,31 @@
+# cmake -DIR_FILE=<file.ll> -DVECTORIZED=<func;...> -DCHECKED=<func;...> -P
+# VECTORIZED 中的函数的循环必须向量化, 并且不需要运行时的别名检查,
+# CHECKED 中的函数向量化时需要运行时的别名检查
+
+file(READ ${IR_FILE} ir)
+
+function(get_function_body name body)
+  string(REGEX MATCH "define [^\n]*@${name}\\([^\n]*\n([^}]|}[^\n])*\n}" match
+               "${ir}")
+  if(NOT match)
+    message(FATAL_ERROR "function ${name} not found in ${IR_FILE}")
+  endif()
+  set(${body} "${match}" PARENT_SCOPE)
+endfunction()
+
+foreach(name ${VECTORIZED})
+  get_function_body(${name} body)
+  if(NOT body MATCHES "vector\\.body")
+    message(FATAL_ERROR "${name}: loop not vectorized")
+  endif()
+  if(body MATCHES "vector\\.memcheck")
+    message(FATAL_ERROR "${name}: restrict ignored, runtime alias check emitted")
+  endif()
+endforeach()
+
+foreach(name ${CHECKED})
+  get_function_body(${name} body)
+  if(NOT body MATCHES "vector\\.memcheck")
+    message(FATAL_ERROR "${name}: runtime alias check expected")
+  endif()
+endforeach()
@@ -0,0 +1,396 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#include "abi.h"
+
+#include <algorithm>
+#include <cassert>
+#include <forward_list>
+#include <unordered_map>
+
+#include <llvm/IR/Attributes.h>
+#include <llvm/IR/DataLayout.h>
+
+#include "ast.h"
+#include "llvm_common.h"
+
+namespace kcc {
+
+namespace {
+
+// 参数中的每个 eightbyte 的类别, 这里不会出现 SSEUP, X87 和 COMPLEX_X87
+enum class ArgClass { kNoClass, kInteger, kSSE, kMemory };
+
+struct Classification {
+  ArgClass classes[2]{};
+  bool has_double[2]{};
+  // eightbyte 中最后一个数据的结束位置
+  std::int32_t end[2]{};
+};
+
+constexpr std::int32_t IntRegCount{6};
+constexpr std::int32_t SSERegCount{8};
+
+thread_local std::unordered_map<const Type*, ABIFuncInfo> FuncInfoCache;
+thread_local std::forward_list<ABIFuncInfo> IncompleteFuncInfos;
+
+ArgClass Merge(ArgClass lhs, ArgClass rhs) {
+  if (lhs == rhs || rhs == ArgClass::kNoClass) {
+    return lhs;
+  } else if (lhs == ArgClass::kNoClass) {
+    return rhs;
+  } else if (lhs == ArgClass::kMemory || rhs == ArgClass::kMemory) {
+    return ArgClass::kMemory;
+  } else {
+    return ArgClass::kInteger;
+  }
+}
+
+void AddScalar(Classification& result, std::int32_t offset, std::int32_t size,
+               ArgClass arg_class, bool is_double = false) {
+  if (size == 0) {
+    return;
+  }
+
+  auto last{std::min((offset + size - 1) / 8, 1)};
+  for (auto i{offset / 8}; i <= last; ++i) {
+    result.classes[i] = Merge(result.classes[i], arg_class);
+    result.end[i] = std::max(result.end[i], std::min(8, offset + size - 8 * i));
+    result.has_double[i] = result.has_double[i] || is_double;
+  }
+}
+
+void Classify(const Type* type, std::int32_t offset, Classification& result) {
+  if (offset >= 16) {
+    result.classes[0] = ArgClass::kMemory;
+    return;
+  }
+
+  // 没有对齐的成员 (e.g. packed) 必须通过内存传递
+  if (!type->IsArrayTy() && type->GetAlign() != 0 &&
+      offset % type->GetAlign() != 0) {
+    result.classes[0] = ArgClass::kMemory;
+    return;
+  }
+
+  if (type->IsFloatTy()) {
+    AddScalar(result, offset, 4, ArgClass::kSSE);
+  } else if (type->IsDoubleTy()) {
+    AddScalar(result, offset, 8, ArgClass::kSSE, true);
+  } else if (type->IsLongDoubleTy()) {
+    // X87 类别的参数通过内存传递
+    result.classes[0] = ArgClass::kMemory;
+  } else if (type->IsIntegerOrBoolTy() || type->IsPointerTy()) {
+    AddScalar(result, offset, type->GetWidth(), ArgClass::kInteger);
+  } else if (type->IsArrayTy()) {
+    auto element_type{type->ArrayGetElementType().GetType()};
+    auto width{element_type->GetWidth()};
+
+    for (std::size_t i{}; i < type->ArrayGetNumElements(); ++i) {
+      Classify(element_type, offset + static_cast<std::int32_t>(i) * width,
+               result);
+    }
+  } else if (type->IsStructOrUnionTy()) {
+    auto layout{Module->getDataLayout().getStructLayout(
+        llvm::cast<llvm::StructType>(type->GetLLVMType()))};
+
+    for (const auto& member : type->StructGetMembers()) {
+      auto member_offset{offset};
+
+      // 联合体的成员都从 0 开始, 结构体成员的位置以 LLVM 类型的布局为准
+      if (type->IsStructTy()) {
+        auto iter{std::find_if(
+            std::begin(member->GetIndexs()), std::end(member->GetIndexs()),
+            [type](const auto& index) { return index.first == type; })};
+        assert(iter != std::end(member->GetIndexs()));
+
+        member_offset += layout->getElementOffset(iter->second);
+      }
+
+      if (auto bit_width{member->GetBitFieldWidth()}) {
+        AddScalar(result, member_offset,
+                  (member->GetBitFieldBegin() + bit_width + 7) / 8,
+                  ArgClass::kInteger);
+      } else {
+        Classify(member->GetType(), member_offset, result);
+      }
+    }
+  } else {
+    result.classes[0] = ArgClass::kMemory;
+  }
+}
+
+// 返回 false 表示需要通过内存传递
+bool ClassifyAggregate(const Type* type, ABIArgInfo& info,
+                       std::int32_t& int_regs, std::int32_t& sse_regs) {
+  auto width{type->GetWidth()};
+  if (width > 16) {
+    return false;
+  }
+
+  Classification result;
+  Classify(type, 0, result);
+
+  auto count{width > 8 ? 2 : 1};
+  int_regs = sse_regs = 0;
+
+  for (std::int32_t i{}; i < count; ++i) {
+    auto arg_class{result.classes[i]};
+    auto size{std::min(8, width - 8 * i)};
+
+    if (arg_class == ArgClass::kMemory) {
+      return false;
+    } else if (arg_class == ArgClass::kSSE) {
+      ++sse_regs;
+      if (result.end[i] <= 4) {
+        info.coerce_types.push_back(Builder->getFloatTy());
+      } else if (result.has_double[i]) {
+        info.coerce_types.push_back(Builder->getDoubleTy());
+      } else {
+        info.coerce_types.push_back(
+            llvm::VectorType::get(Builder->getFloatTy(), 2));
+      }
+    } else {
+      // 只包含填充的 eightbyte 也用整数寄存器传递
+      ++int_regs;
+      info.coerce_types.push_back(Builder->getIntNTy(size * 8));
+    }
+  }
+
+  return true;
+}
+
+ABIArgInfo ClassifyReturn(const Type* type, std::int32_t& free_int_regs) {
+  ABIArgInfo info;
+  info.type = type->GetLLVMType();
+  info.align = type->IsVoidTy() ? 0 : type->GetAlign();
+
+  if (!type->IsStructOrUnionTy() || !type->IsComplete()) {
+    return info;
+  }
+
+  if (type->GetWidth() == 0) {
+    info.kind = ABIArgInfo::kIgnore;
+    return info;
+  }
+
+  // 返回值可以使用 rax, rdx 和 xmm0, xmm1
+  std::int32_t int_regs{}, sse_regs{};
+  if (ClassifyAggregate(type, info, int_regs, sse_regs)) {
+    info.kind = ABIArgInfo::kCoerce;
+  } else {
+    // 调用者提供的内存地址占用 rdi
+    info.kind = ABIArgInfo::kIndirect;
+    info.coerce_types.clear();
+    --free_int_regs;
+  }
+
+  return info;
+}
+
+llvm::Type* GetCoerceType(const ABIArgInfo& info) {
+  if (std::size(info.coerce_types) == 1) {
+    return info.coerce_types.front();
+  } else {
+    return llvm::StructType::get(*Context, info.coerce_types);
+  }
+}
+
+ABIFuncInfo ComputeFuncInfo(const Type* func_type) {
+  ABIFuncInfo info;
+  info.free_int_regs = IntRegCount;
+  info.free_sse_regs = SSERegCount;
+
+  info.ret = ClassifyReturn(func_type->FuncGetReturnType().GetType(),
+                            info.free_int_regs);
+
+  std::vector<llvm::Type*> params;
+  llvm::Type* return_type{};
+
+  switch (info.ret.kind) {
+    case ABIArgInfo::kDirect:
+      return_type = info.ret.type;
+      break;
+    case ABIArgInfo::kCoerce:
+      return_type = GetCoerceType(info.ret);
+      break;
+    case ABIArgInfo::kIndirect:
+      params.push_back(info.ret.type->getPointerTo());
+      [[fallthrough]];
+    case ABIArgInfo::kIgnore:
+      return_type = Builder->getVoidTy();
+      break;
+  }
+
+  for (const auto& param : func_type->FuncGetParams()) {
+    auto arg{ClassifyArg(param->GetType(), info.free_int_regs,
+                         info.free_sse_regs)};
+
+    switch (arg.kind) {
+      case ABIArgInfo::kDirect:
+        params.push_back(arg.type);
+        break;
+      case ABIArgInfo::kCoerce:
+        params.insert(std::end(params), std::begin(arg.coerce_types),
+                      std::end(arg.coerce_types));
+        break;
+      case ABIArgInfo::kIndirect:
+        params.push_back(arg.type->getPointerTo());
+        break;
+      case ABIArgInfo::kIgnore:
+        break;
+    }
+
+    info.params.push_back(std::move(arg));
+  }
+
+  info.llvm_type = llvm::FunctionType::get(return_type, params,
+                                           func_type->FuncIsVarArgs());
+  return info;
+}
+
+bool IsComplete(const Type* func_type) {
+  auto return_type{func_type->FuncGetReturnType().GetType()};
+  if (return_type->IsStructOrUnionTy() && !return_type->IsComplete()) {
+    return false;
+  }
+
+  for (const auto& param : func_type->FuncGetParams()) {
+    if (param->GetType()->IsStructOrUnionTy() &&
+        !param->GetType()->IsComplete()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Function 和 CallInst 的参数属性接口相同
+template <typename T>
+void AddAttributes(T* value, const ABIFuncInfo& info,
+                   llvm::ArrayRef<ABIArgInfo> var_args) {
+  std::uint32_t index{};
+
+  if (info.ret.kind == ABIArgInfo::kIndirect) {
+    value->addParamAttr(index, llvm::Attribute::StructRet);
+    value->addParamAttr(index, llvm::Attribute::NoAlias);
+    ++index;
+  }
+
+  auto add{[&](const ABIArgInfo& arg) {
+    switch (arg.kind) {
+      case ABIArgInfo::kDirect:
+        ++index;
+        break;
+      case ABIArgInfo::kCoerce:
+        index += std::size(arg.coerce_types);
+        break;
+      case ABIArgInfo::kIndirect:
+        value->addParamAttr(
+            index, llvm::Attribute::getWithByValType(*Context, arg.type));
+        value->addParamAttr(
+            index, llvm::Attribute::get(*Context, llvm::Attribute::Alignment,
+                                        std::max(arg.align, 8)));
+        ++index;
+        break;
+      case ABIArgInfo::kIgnore:
+        break;
+    }
+  }};
+
+  for (const auto& arg : info.params) {
+    add(arg);
+  }
+  for (const auto& arg : var_args) {
+    add(arg);
+  }
+}
+
+}  // namespace
+
+void ClearABIFuncInfoCache() {
+  FuncInfoCache.clear();
+  IncompleteFuncInfos.clear();
+}
+
+const ABIFuncInfo& GetABIFuncInfo(const Type* func_type) {
+  assert(func_type->IsFunctionTy());
+
+  if (auto iter{FuncInfoCache.find(func_type)};
+      iter != std::end(FuncInfoCache)) {
+    return iter->second;
+  }
+
+  if (!IsComplete(func_type)) {
+    return IncompleteFuncInfos.emplace_front(ComputeFuncInfo(func_type));
+  }
+
+  return FuncInfoCache.emplace(func_type, ComputeFuncInfo(func_type))
+      .first->second;
+}
+
+ABIArgInfo ClassifyArg(const Type* type, std::int32_t& free_int_regs,
+                       std::int32_t& free_sse_regs) {
+  ABIArgInfo info;
+  info.type = type->GetLLVMType();
+  info.align = type->GetAlign();
+
+  if (!type->IsStructOrUnionTy()) {
+    if (type->IsIntegerOrBoolTy() || type->IsPointerTy()) {
+      free_int_regs = std::max(free_int_regs - 1, 0);
+    } else if (type->IsFloatTy() || type->IsDoubleTy()) {
+      free_sse_regs = std::max(free_sse_regs - 1, 0);
+    }
+    return info;
+  }
+
+  if (!type->IsComplete()) {
+    return info;
+  }
+
+  if (type->GetWidth() == 0) {
+    info.kind = ABIArgInfo::kIgnore;
+    return info;
+  }
+
+  // 寄存器不够时整个参数通过栈传递, 不会拆开
+  std::int32_t int_regs{}, sse_regs{};
+  if (ClassifyAggregate(type, info, int_regs, sse_regs) &&
+      int_regs <= free_int_regs && sse_regs <= free_sse_regs) {
+    info.kind = ABIArgInfo::kCoerce;
+    free_int_regs -= int_regs;
+    free_sse_regs -= sse_regs;
+  } else {
+    info.kind = ABIArgInfo::kIndirect;
+    info.coerce_types.clear();
+  }
+
+  return info;
+}
+
+void AddABIAttributes(llvm::Function* func, const ABIFuncInfo& info) {
+  AddAttributes(func, info, {});
+}
+
+void AddABIAttributes(llvm::CallInst* call, const ABIFuncInfo& info,
+                      llvm::ArrayRef<ABIArgInfo> var_args) {
+  AddAttributes(call, info, var_args);
+}
+
+llvm::Function* GetOrCreateFunction(const std::string& name,
+                                    const Type* func_type,
+                                    llvm::GlobalValue::LinkageTypes linkage) {
+  auto func{Module->getFunction(name)};
+
+  if (!func) {
+    const auto& info{GetABIFuncInfo(func_type)};
+    func = llvm::Function::Create(info.llvm_type, linkage, name, Module.get());
+    AddABIAttributes(func, info);
+    AddGNUAttributes(func, func_type, false);
+  }
+
+  return func;
+}
+
+}  // namespace kcc
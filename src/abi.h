@@ -0,0 +1,72 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalValue.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Type.h>
+
+#include "type.h"
+
+namespace kcc {
+
+// x86-64 System V ABI 中一个参数或返回值的传递方式
+struct ABIArgInfo {
+  enum Kind {
+    // 标量, 按 LLVM 类型原样传递
+    kDirect,
+    // 不超过 16 字节的结构体或联合体, 拆分为一到两个 eightbyte,
+    // 分别用整数或浮点寄存器传递
+    kCoerce,
+    // 参数复制到栈上 (byval), 返回值写入调用者提供的内存 (sret)
+    kIndirect,
+    // 空结构体, 不占用参数
+    kIgnore
+  };
+
+  Kind kind{kDirect};
+  // 源类型, kCoerce 时为每个 eightbyte 对应的类型
+  llvm::Type* type{};
+  std::int32_t align{};
+  llvm::SmallVector<llvm::Type*, 2> coerce_types;
+};
+
+struct ABIFuncInfo {
+  ABIArgInfo ret;
+  std::vector<ABIArgInfo> params;
+  llvm::FunctionType* llvm_type{};
+  // 固定参数之后剩余的寄存器, 用于可变参数
+  std::int32_t free_int_regs{};
+  std::int32_t free_sse_regs{};
+};
+
+// 结构体类型不完整时不会缓存结果
+const ABIFuncInfo& GetABIFuncInfo(const Type* func_type);
+// CompilationContext 释放时清除, 缓存以类型的地址为键
+void ClearABIFuncInfoCache();
+
+// 用于可变参数部分, 会消耗剩余的寄存器
+ABIArgInfo ClassifyArg(const Type* type, std::int32_t& free_int_regs,
+                       std::int32_t& free_sse_regs);
+
+// sret 和 byval 等属性, 调用时还需要加上可变参数部分
+void AddABIAttributes(llvm::Function* func, const ABIFuncInfo& info);
+void AddABIAttributes(llvm::CallInst* call, const ABIFuncInfo& info,
+                      llvm::ArrayRef<ABIArgInfo> var_args);
+
+// 函数使用降级之后的类型, 已经存在时直接返回
+llvm::Function* GetOrCreateFunction(const std::string& name,
+                                    const Type* func_type,
+                                    llvm::GlobalValue::LinkageTypes linkage);
+
+}  // namespace kcc
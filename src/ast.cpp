@@ -6,9 +6,9 @@
 
 #include <algorithm>
 
+#include "ast_context.h"
 #include "error.h"
 #include "llvm_common.h"
-#include "memory_pool.h"
 #include "visitor.h"
 
 namespace kcc {
@@ -25,9 +25,9 @@ QString AstNodeTypes::ToQString(AstNodeTypes::Type type) {
  */
 QString AstNode::KindQString() const { return AstNodeTypes::ToQString(Kind()); }
 
-const Location& AstNode::GetLoc() const { return loc_; }
+SourceLocation AstNode::GetLoc() const { return loc_; }
 
-void AstNode::SetLoc(const Location& loc) { loc_ = loc; }
+void AstNode::SetLoc(SourceLocation loc) { loc_ = loc; }
 
 /*
  * Expr
@@ -102,6 +102,19 @@ bool Expr::IsZero(const Expr* expr) {
   return false;
 }
 
+std::optional<llvm::Constant*> Expr::GetFoldedValue() const {
+  if (folded_) {
+    return folded_value_;
+  } else {
+    return {};
+  }
+}
+
+void Expr::SetFoldedValue(llvm::Constant* value) const {
+  folded_ = true;
+  folded_value_ = value;
+}
+
 Expr::Expr(QualType type) : type_{type} {}
 
 /*
@@ -109,7 +122,7 @@ Expr::Expr(QualType type) : type_{type} {}
  */
 UnaryOpExpr* UnaryOpExpr::Get(Tag tag, Expr* expr) {
   assert(expr != nullptr);
-  return new (UnaryOpExprPool.Allocate()) UnaryOpExpr{tag, expr};
+  return GetNodeCtx().New<UnaryOpExpr>(tag, expr);
 }
 
 AstNodeType UnaryOpExpr::Kind() const { return AstNodeType::kUnaryOpExpr; }
@@ -228,7 +241,7 @@ void UnaryOpExpr::AddrOpCheck() {
  */
 TypeCastExpr* TypeCastExpr::Get(Expr* expr, QualType to) {
   assert(expr != nullptr);
-  return new (TypeCastExprPool.Allocate()) TypeCastExpr{expr, to};
+  return GetNodeCtx().New<TypeCastExpr>(expr, to);
 }
 
 AstNodeType TypeCastExpr::Kind() const { return AstNodeType::kTypeCastExpr; }
@@ -258,7 +271,7 @@ TypeCastExpr::TypeCastExpr(Expr* expr, QualType to) : Expr(to), expr_{expr} {}
  */
 BinaryOpExpr* BinaryOpExpr::Get(Tag tag, Expr* lhs, Expr* rhs) {
   assert(lhs != nullptr && rhs != nullptr);
-  return new (BinaryOpExprPool.Allocate()) BinaryOpExpr{tag, lhs, rhs};
+  return GetNodeCtx().New<BinaryOpExpr>(tag, lhs, rhs);
 }
 
 AstNodeType BinaryOpExpr::Kind() const { return AstNodeType::kBinaryOpExpr; }
@@ -511,7 +524,7 @@ void BinaryOpExpr::CommaOpCheck() { type_ = rhs_->GetQualType(); }
  */
 ConditionOpExpr* ConditionOpExpr::Get(Expr* cond, Expr* lhs, Expr* rhs) {
   assert(cond != nullptr && lhs != nullptr && rhs != nullptr);
-  return new (ConditionOpExprPool.Allocate()) ConditionOpExpr{cond, lhs, rhs};
+  return GetNodeCtx().New<ConditionOpExpr>(cond, lhs, rhs);
 }
 
 AstNodeType ConditionOpExpr::Kind() const {
@@ -586,10 +599,9 @@ ConditionOpExpr::ConditionOpExpr(Expr* cond, Expr* lhs, Expr* rhs)
 /*
  * FuncCallExpr
  */
-FuncCallExpr* FuncCallExpr::Get(Expr* callee, std::vector<Expr*> args) {
+FuncCallExpr* FuncCallExpr::Get(Expr* callee, ArenaVector<Expr*> args) {
   assert(callee != nullptr);
-  return new (FuncCallExprPool.Allocate())
-      FuncCallExpr{callee, std::move(args)};
+  return GetNodeCtx().New<FuncCallExpr>(callee, std::move(args));
 }
 
 AstNodeType FuncCallExpr::Kind() const { return AstNodeType::kFuncCallExpr; }
@@ -650,7 +662,7 @@ Type* FuncCallExpr::GetFuncType() const { return callee_->GetType(); }
 
 Expr* FuncCallExpr::GetCallee() const { return callee_; }
 
-const std::vector<Expr*>& FuncCallExpr::GetArgs() const { return args_; }
+const ArenaVector<Expr*>& FuncCallExpr::GetArgs() const { return args_; }
 
 void FuncCallExpr::SetVaArgType(Type* va_arg_type) {
   va_arg_type_ = va_arg_type;
@@ -658,24 +670,24 @@ void FuncCallExpr::SetVaArgType(Type* va_arg_type) {
 
 Type* FuncCallExpr::GetVaArgType() const { return va_arg_type_; }
 
-FuncCallExpr::FuncCallExpr(Expr* callee, std::vector<Expr*> args)
+FuncCallExpr::FuncCallExpr(Expr* callee, ArenaVector<Expr*> args)
     : callee_{callee}, args_{std::move(args)} {}
 
 /*
  * Constant
  */
 ConstantExpr* ConstantExpr::Get(std::int32_t val) {
-  return new (ConstantExprPool.Allocate()) ConstantExpr{val};
+  return GetNodeCtx().New<ConstantExpr>(val);
 }
 
 ConstantExpr* ConstantExpr::Get(Type* type, std::uint64_t val) {
   assert(type != nullptr);
-  return new (ConstantExprPool.Allocate()) ConstantExpr{type, val};
+  return GetNodeCtx().New<ConstantExpr>(type, val);
 }
 
 ConstantExpr* ConstantExpr::Get(Type* type, const std::string& str) {
   assert(type != nullptr);
-  return new (ConstantExprPool.Allocate()) ConstantExpr{type, str};
+  return GetNodeCtx().New<ConstantExpr>(type, str);
 }
 
 AstNodeType ConstantExpr::Kind() const { return AstNodeType::kConstantExpr; }
@@ -719,7 +731,7 @@ StringLiteralExpr* StringLiteralExpr::Get(const std::string& val) {
 
 StringLiteralExpr* StringLiteralExpr::Get(Type* type, const std::string& val) {
   assert(type != nullptr);
-  return new (StringLiteralExprPool.Allocate()) StringLiteralExpr{type, val};
+  return GetNodeCtx().New<StringLiteralExpr>(type, val);
 }
 
 AstNodeType StringLiteralExpr::Kind() const {
@@ -763,7 +775,7 @@ std::pair<llvm::Constant*, llvm::Constant*> StringLiteralExpr::Create() const {
       }
       // 空字符
       values.push_back(0);
-      arr = llvm::ConstantDataArray::get(Context, values);
+      arr = llvm::ConstantDataArray::get(*Context, values);
     } break;
     case 2: {
       std::vector<std::uint16_t> values;
@@ -772,7 +784,7 @@ std::pair<llvm::Constant*, llvm::Constant*> StringLiteralExpr::Create() const {
         str += 2;
       }
       values.push_back(0);
-      arr = llvm::ConstantDataArray::get(Context, values);
+      arr = llvm::ConstantDataArray::get(*Context, values);
     } break;
     case 4: {
       std::vector<std::uint32_t> values;
@@ -781,7 +793,7 @@ std::pair<llvm::Constant*, llvm::Constant*> StringLiteralExpr::Create() const {
         str += 4;
       }
       values.push_back(0);
-      arr = llvm::ConstantDataArray::get(Context, values);
+      arr = llvm::ConstantDataArray::get(*Context, values);
     } break;
     default:
       assert(false);
@@ -789,7 +801,7 @@ std::pair<llvm::Constant*, llvm::Constant*> StringLiteralExpr::Create() const {
 
   auto string{CreateGlobalString(arr, width)};
 
-  auto zero{llvm::ConstantInt::get(Builder.getInt64Ty(), 0)};
+  auto zero{llvm::ConstantInt::get(Builder->getInt64Ty(), 0)};
   llvm::Constant* indices[]{zero, zero};
   ptr = llvm::ConstantExpr::getInBoundsGetElementPtr(nullptr, string, indices);
 
@@ -803,8 +815,7 @@ std::pair<llvm::Constant*, llvm::Constant*> StringLiteralExpr::Create() const {
  */
 IdentifierExpr* IdentifierExpr::Get(const std::string& name, QualType type,
                                     enum Linkage linkage, bool is_type_name) {
-  return new (IdentifierExprPool.Allocate())
-      IdentifierExpr{name, type, linkage, is_type_name};
+  return GetNodeCtx().New<IdentifierExpr>(name, type, linkage, is_type_name);
 }
 
 AstNodeType IdentifierExpr::Kind() const {
@@ -843,7 +854,7 @@ IdentifierExpr::IdentifierExpr(const std::string& name, QualType type,
  * Enumerator
  */
 EnumeratorExpr* EnumeratorExpr::Get(const std::string& name, std::int32_t val) {
-  return new (EnumeratorExprPool.Allocate()) EnumeratorExpr{name, val};
+  return GetNodeCtx().New<EnumeratorExpr>(name, val);
 }
 
 AstNodeType EnumeratorExpr::Kind() const {
@@ -869,8 +880,8 @@ ObjectExpr* ObjectExpr::Get(const std::string& name, QualType type,
                             std::uint32_t storage_class_spec,
                             enum Linkage linkage, bool anonymous,
                             std::int32_t bit_field_width) {
-  return new (ObjectExprPool.Allocate()) ObjectExpr{
-      name, type, storage_class_spec, linkage, anonymous, bit_field_width};
+  return GetNodeCtx().New<ObjectExpr>(name, type, storage_class_spec, linkage,
+                                anonymous, bit_field_width);
 }
 
 AstNodeType ObjectExpr::Kind() const { return AstNodeType::kObjectExpr; }
@@ -895,6 +906,14 @@ std::int32_t ObjectExpr::GetAlign() const { return align_; }
 
 void ObjectExpr::SetAlign(std::int32_t align) { align_ = align; }
 
+const Attributes& ObjectExpr::GetAttrs() const { return attrs_; }
+
+// aligned 只能增大对齐
+void ObjectExpr::AddAttrs(const Attributes& attrs) {
+  attrs_.Merge(attrs);
+  align_ = std::max(align_, attrs_.align);
+}
+
 std::int32_t ObjectExpr::GetOffset() const { return offset_; }
 
 void ObjectExpr::SetOffset(std::int32_t offset) { offset_ = offset; }
@@ -911,12 +930,12 @@ bool ObjectExpr::IsLocalStaticVar() const {
   return linkage_ == Linkage::kNone && IsStatic();
 }
 
-void ObjectExpr::SetLocalPtr(llvm::AllocaInst* local_ptr) {
+void ObjectExpr::SetLocalPtr(llvm::Value* local_ptr) {
   assert(local_ptr_ == nullptr);
   local_ptr_ = local_ptr;
 }
 
-llvm::AllocaInst* ObjectExpr::GetLocalPtr() const {
+llvm::Value* ObjectExpr::GetLocalPtr() const {
   assert(local_ptr_ != nullptr);
   return local_ptr_;
 }
@@ -949,7 +968,8 @@ llvm::GlobalVariable* ObjectExpr::GetGlobalPtr() const {
     assert(false);
   }
 
-  ptr->setAlignment(GetType()->GetAlign());
+  ptr->setAlignment(GetAlign());
+  AddGNUAttributes(ptr, attrs_, true);
 
   if (GetDecl()->HasConstantInit()) {
     ptr->setInitializer(GetDecl()->GetConstant());
@@ -998,7 +1018,7 @@ ObjectExpr::ObjectExpr(const std::string& name, QualType type,
  */
 StmtExpr* StmtExpr::Get(CompoundStmt* block) {
   assert(block != nullptr);
-  return new (StmtExprPool.Allocate()) StmtExpr{block};
+  return GetNodeCtx().New<StmtExpr>(block);
 }
 
 AstNodeType StmtExpr::Kind() const { return AstNodeType::kStmtExpr; }
@@ -1036,7 +1056,7 @@ std::vector<Stmt*> Stmt::Children() const { return {}; }
  */
 LabelStmt* LabelStmt::Get(const std::string& name, Stmt* stmt) {
   assert(stmt != nullptr);
-  return new (LabelStmtPool.Allocate()) LabelStmt{name, stmt};
+  return GetNodeCtx().New<LabelStmt>(name, stmt);
 }
 
 AstNodeType LabelStmt::Kind() const { return AstNodeType::kLabelStmt; }
@@ -1059,12 +1079,12 @@ LabelStmt::LabelStmt(const std::string& name, Stmt* stmt)
  */
 CaseStmt* CaseStmt::Get(std::int64_t lhs, Stmt* stmt) {
   assert(stmt != nullptr);
-  return new (CaseStmtPool.Allocate()) CaseStmt{lhs, stmt};
+  return GetNodeCtx().New<CaseStmt>(lhs, stmt);
 }
 
 CaseStmt* CaseStmt::Get(std::int64_t lhs, std::int64_t rhs, Stmt* stmt) {
   assert(stmt != nullptr);
-  return new (CaseStmtPool.Allocate()) CaseStmt{lhs, rhs, stmt};
+  return GetNodeCtx().New<CaseStmt>(lhs, rhs, stmt);
 }
 
 AstNodeType CaseStmt::Kind() const { return AstNodeType::kCaseStmt; }
@@ -1091,7 +1111,7 @@ CaseStmt::CaseStmt(std::int64_t lhs, std::int64_t rhs, Stmt* stmt)
  */
 DefaultStmt* DefaultStmt::Get(Stmt* block) {
   assert(block != nullptr);
-  return new (DefaultStmtPool.Allocate()) DefaultStmt{block};
+  return GetNodeCtx().New<DefaultStmt>(block);
 }
 
 AstNodeType DefaultStmt::Kind() const { return AstNodeType::kDefaultStmt; }
@@ -1110,11 +1130,11 @@ DefaultStmt::DefaultStmt(Stmt* block) : stmt_{block} {}
  * CompoundStmt
  */
 CompoundStmt* CompoundStmt::Get() {
-  return new (CompoundStmtPool.Allocate()) CompoundStmt{};
+  return GetNodeCtx().New<CompoundStmt>();
 }
 
-CompoundStmt* CompoundStmt::Get(std::vector<Stmt*> stmts) {
-  return new (CompoundStmtPool.Allocate()) CompoundStmt{std::move(stmts)};
+CompoundStmt* CompoundStmt::Get(ArenaVector<Stmt*> stmts) {
+  return GetNodeCtx().New<CompoundStmt>(std::move(stmts));
 }
 
 AstNodeType CompoundStmt::Kind() const { return AstNodeType::kCompoundStmt; }
@@ -1123,9 +1143,11 @@ void CompoundStmt::Accept(Visitor& visitor) const { visitor.Visit(this); }
 
 void CompoundStmt::Check() {}
 
-std::vector<Stmt*> CompoundStmt::Children() const { return stmts_; }
+std::vector<Stmt*> CompoundStmt::Children() const {
+  return {std::begin(stmts_), std::end(stmts_)};
+}
 
-const std::vector<Stmt*>& CompoundStmt::GetStmts() const { return stmts_; }
+const ArenaVector<Stmt*>& CompoundStmt::GetStmts() const { return stmts_; }
 
 void CompoundStmt::AddStmt(Stmt* stmt) {
   // 非 typedef
@@ -1134,14 +1156,14 @@ void CompoundStmt::AddStmt(Stmt* stmt) {
   }
 }
 
-CompoundStmt::CompoundStmt(std::vector<Stmt*> stmts)
+CompoundStmt::CompoundStmt(ArenaVector<Stmt*> stmts)
     : stmts_{std::move(stmts)} {}
 
 /*
  * ExprStmt
  */
 ExprStmt* ExprStmt::Get(Expr* expr) {
-  return new (ExprStmtPool.Allocate()) ExprStmt{expr};
+  return GetNodeCtx().New<ExprStmt>(expr);
 }
 
 AstNodeType ExprStmt::Kind() const { return AstNodeType::kExprStmt; }
@@ -1159,7 +1181,7 @@ ExprStmt::ExprStmt(Expr* expr) : expr_{expr} {}
  */
 IfStmt* IfStmt::Get(Expr* cond, Stmt* then_block, Stmt* else_block) {
   assert(cond != nullptr && then_block != nullptr);
-  return new (IfStmtPool.Allocate()) IfStmt{cond, then_block, else_block};
+  return GetNodeCtx().New<IfStmt>(cond, then_block, else_block);
 }
 
 AstNodeType IfStmt::Kind() const { return AstNodeType::kIfStmt; }
@@ -1193,7 +1215,7 @@ IfStmt::IfStmt(Expr* cond, Stmt* then_block, Stmt* else_block)
  */
 SwitchStmt* SwitchStmt::Get(Expr* cond, Stmt* block) {
   assert(cond != nullptr && block != nullptr);
-  return new (SwitchStmtPool.Allocate()) SwitchStmt{cond, block};
+  return GetNodeCtx().New<SwitchStmt>(cond, block);
 }
 
 AstNodeType SwitchStmt::Kind() const { return AstNodeType::kSwitchStmt; }
@@ -1222,7 +1244,7 @@ SwitchStmt::SwitchStmt(Expr* cond, Stmt* block) : cond_{cond}, stmt_{block} {}
  */
 WhileStmt* WhileStmt::Get(Expr* cond, Stmt* block) {
   assert(cond != nullptr && block != nullptr);
-  return new (WhileStmtPool.Allocate()) WhileStmt{cond, block};
+  return GetNodeCtx().New<WhileStmt>(cond, block);
 }
 
 AstNodeType WhileStmt::Kind() const { return AstNodeType::kWhileStmt; }
@@ -1250,7 +1272,7 @@ WhileStmt::WhileStmt(Expr* cond, Stmt* block)
  */
 DoWhileStmt* DoWhileStmt::Get(Expr* cond, Stmt* block) {
   assert(cond != nullptr && block != nullptr);
-  return new (DoWhileStmtPool.Allocate()) DoWhileStmt{cond, block};
+  return GetNodeCtx().New<DoWhileStmt>(cond, block);
 }
 
 AstNodeType DoWhileStmt::Kind() const { return AstNodeType::kDoWhileStmt; }
@@ -1278,7 +1300,7 @@ DoWhileStmt::DoWhileStmt(Expr* cond, Stmt* block)
  */
 ForStmt* ForStmt::Get(Expr* init, Expr* cond, Expr* inc, Stmt* block,
                       Stmt* decl) {
-  return new (ForStmtPool.Allocate()) ForStmt{init, cond, inc, block, decl};
+  return GetNodeCtx().New<ForStmt>(init, cond, inc, block, decl);
 }
 
 AstNodeType ForStmt::Kind() const { return AstNodeType::kForStmt; }
@@ -1311,12 +1333,12 @@ ForStmt::ForStmt(Expr* init, Expr* cond, Expr* inc, Stmt* block, Stmt* decl)
  * GotoStmt
  */
 GotoStmt* GotoStmt::Get(const std::string& name) {
-  return new (GotoStmtPool.Allocate()) GotoStmt{name};
+  return GetNodeCtx().New<GotoStmt>(name);
 }
 
 GotoStmt* GotoStmt::Get(LabelStmt* label) {
   assert(label != nullptr);
-  return new (GotoStmtPool.Allocate()) GotoStmt{label};
+  return GetNodeCtx().New<GotoStmt>(label);
 }
 
 AstNodeType GotoStmt::Kind() const { return AstNodeType::kGotoStmt; }
@@ -1339,7 +1361,7 @@ GotoStmt::GotoStmt(LabelStmt* label) : label_{label} {}
  * ContinueStmt
  */
 ContinueStmt* ContinueStmt::Get() {
-  return new (ContinueStmtPool.Allocate()) ContinueStmt{};
+  return GetNodeCtx().New<ContinueStmt>();
 }
 
 AstNodeType ContinueStmt::Kind() const { return AstNodeType::kContinueStmt; }
@@ -1352,7 +1374,7 @@ void ContinueStmt::Check() {}
  * BreakStmt
  */
 BreakStmt* BreakStmt::Get() {
-  return new (BreakStmtPool.Allocate()) BreakStmt{};
+  return GetNodeCtx().New<BreakStmt>();
 }
 
 AstNodeType BreakStmt::Kind() const { return AstNodeType::kBreakStmt; }
@@ -1365,7 +1387,7 @@ void BreakStmt::Check() {}
  * ReturnStmt
  */
 ReturnStmt* ReturnStmt::Get(Expr* expr) {
-  return new (ReturnStmtPool.Allocate()) ReturnStmt{expr};
+  return GetNodeCtx().New<ReturnStmt>(expr);
 }
 
 AstNodeType ReturnStmt::Kind() const { return AstNodeType::kReturnStmt; }
@@ -1382,7 +1404,7 @@ ReturnStmt::ReturnStmt(Expr* expr) : expr_{expr} {}
  * TranslationUnit
  */
 TranslationUnit* TranslationUnit::Get() {
-  return new (TranslationUnitPool.Allocate()) TranslationUnit{};
+  return GetNodeCtx().New<TranslationUnit>();
 }
 
 AstNodeType TranslationUnit::Kind() const {
@@ -1400,7 +1422,7 @@ void TranslationUnit::AddExtDecl(ExtDecl* ext_decl) {
   }
 }
 
-const std::vector<ExtDecl*>& TranslationUnit::GetExtDecl() const {
+const ArenaVector<ExtDecl*>& TranslationUnit::GetExtDecl() const {
   return ext_decls_;
 }
 
@@ -1440,7 +1462,7 @@ Initializer::GetIndexs() const {
  */
 Declaration* Declaration::Get(IdentifierExpr* ident) {
   assert(ident != nullptr);
-  return new (DeclarationPool.Allocate()) Declaration{ident};
+  return GetNodeCtx().New<Declaration>(ident);
 }
 
 AstNodeType Declaration::Kind() const { return AstNodeType::kDeclaration; }
@@ -1525,7 +1547,7 @@ Declaration::Declaration(IdentifierExpr* ident) : ident_{ident} {}
  * FuncDef
  */
 FuncDef* FuncDef::Get(IdentifierExpr* ident) {
-  return new (FuncDefPool.Allocate()) FuncDef{ident};
+  return GetNodeCtx().New<FuncDef>(ident);
 }
 
 AstNodeType FuncDef::Kind() const { return AstNodeType::kFuncDef; }
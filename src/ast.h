@@ -22,6 +22,7 @@
 #include <QObject>
 #include <QString>
 
+#include "ast_context.h"
 #include "location.h"
 #include "token.h"
 #include "type.h"
@@ -34,11 +35,12 @@ class Declaration;
 class Visitor;
 
 // arr / ptr
-inline std::unordered_map<std::string,
-                          std::pair<llvm::Constant*, llvm::Constant*>>
+inline thread_local std::unordered_map<
+    std::string, std::pair<llvm::Constant*, llvm::Constant*>>
     StringMap;
 
-inline std::unordered_map<std::string, llvm::GlobalVariable*> GlobalVarMap;
+inline thread_local std::unordered_map<std::string, llvm::GlobalVariable*>
+    GlobalVarMap;
 
 class AstNodeTypes : public QObject {
   Q_OBJECT
@@ -93,13 +95,13 @@ class AstNode {
 
   QString KindQString() const;
 
-  const Location& GetLoc() const;
-  void SetLoc(const Location& loc);
+  SourceLocation GetLoc() const;
+  void SetLoc(SourceLocation loc);
 
  protected:
   AstNode() = default;
 
-  Location loc_;
+  SourceLocation loc_;
 };
 
 class Expr : public AstNode {
@@ -123,10 +125,18 @@ class Expr : public AstNode {
   // 判断是否是 int 0
   static bool IsZero(const Expr* expr);
 
+  // 没有计算过时返回 std::nullopt, 不是常量时为 nullptr
+  std::optional<llvm::Constant*> GetFoldedValue() const;
+  void SetFoldedValue(llvm::Constant* value) const;
+
  protected:
   explicit Expr(QualType type = {});
 
   QualType type_;
+
+  // 常量表达式求值的结果, 由 CalcConstantExpr 记录
+  mutable bool folded_{};
+  mutable llvm::Constant* folded_value_{};
 };
 
 /*
@@ -148,6 +158,8 @@ class UnaryOpExpr : public Expr {
   const Expr* GetExpr() const;
 
  private:
+  friend class AstContext;
+
   UnaryOpExpr(Tag tag, Expr* expr);
 
   void IncDecOpCheck();
@@ -174,6 +186,8 @@ class TypeCastExpr : public Expr {
   QualType GetCastToType() const;
 
  private:
+  friend class AstContext;
+
   TypeCastExpr(Expr* expr, QualType to);
 
   Expr* expr_;
@@ -202,6 +216,8 @@ class BinaryOpExpr : public Expr {
   const Expr* GetRHS() const;
 
  private:
+  friend class AstContext;
+
   BinaryOpExpr(Tag tag, Expr* lhs, Expr* rhs);
 
   void AssignOpCheck();
@@ -235,6 +251,8 @@ class ConditionOpExpr : public Expr {
   const Expr* GetRHS() const;
 
  private:
+  friend class AstContext;
+
   ConditionOpExpr(Expr* cond, Expr* lhs, Expr* rhs);
 
   Expr* cond_;
@@ -244,7 +262,7 @@ class ConditionOpExpr : public Expr {
 
 class FuncCallExpr : public Expr {
  public:
-  static FuncCallExpr* Get(Expr* callee, std::vector<Expr*> args = {});
+  static FuncCallExpr* Get(Expr* callee, ArenaVector<Expr*> args = {});
 
   virtual AstNodeType Kind() const override;
   virtual void Accept(Visitor& visitor) const override;
@@ -254,16 +272,18 @@ class FuncCallExpr : public Expr {
   Type* GetFuncType() const;
 
   Expr* GetCallee() const;
-  const std::vector<Expr*>& GetArgs() const;
+  const ArenaVector<Expr*>& GetArgs() const;
 
   void SetVaArgType(Type* va_arg_type);
   Type* GetVaArgType() const;
 
  private:
-  explicit FuncCallExpr(Expr* callee, std::vector<Expr*> args = {});
+  friend class AstContext;
+
+  explicit FuncCallExpr(Expr* callee, ArenaVector<Expr*> args = {});
 
   Expr* callee_;
-  std::vector<Expr*> args_;
+  ArenaVector<Expr*> args_;
 
   Type* va_arg_type_{nullptr};
 };
@@ -284,6 +304,8 @@ class ConstantExpr : public Expr {
   const llvm::APFloat& GetFloatPointVal() const;
 
  private:
+  friend class AstContext;
+
   ConstantExpr(std::int32_t val);
   ConstantExpr(Type* type, std::uint64_t val);
   ConstantExpr(Type* type, const std::string& str);
@@ -307,6 +329,8 @@ class StringLiteralExpr : public Expr {
   llvm::Constant* GetPtr() const;
 
  private:
+  friend class AstContext;
+
   StringLiteralExpr(Type* type, const std::string& val);
 
   std::pair<llvm::Constant*, llvm::Constant*> Create() const;
@@ -347,6 +371,8 @@ class IdentifierExpr : public Expr {
   const ObjectExpr* ToObjectExpr() const;
 
  protected:
+  friend class AstContext;
+
   IdentifierExpr(const std::string& name, QualType type,
                  enum Linkage linkage = Linkage::kNone,
                  bool is_type_name = false);
@@ -368,6 +394,8 @@ class EnumeratorExpr : public IdentifierExpr {
   std::int32_t GetVal() const;
 
  private:
+  friend class AstContext;
+
   EnumeratorExpr(const std::string& name, std::int32_t val);
 
   std::int32_t val_;
@@ -402,6 +430,8 @@ class ObjectExpr : public IdentifierExpr {
 
   std::int32_t GetAlign() const;
   void SetAlign(std::int32_t align);
+  const Attributes& GetAttrs() const;
+  void AddAttrs(const Attributes& attrs);
   std::int32_t GetOffset() const;
   void SetOffset(std::int32_t offset);
 
@@ -412,8 +442,8 @@ class ObjectExpr : public IdentifierExpr {
   bool IsGlobalVar() const;
   bool IsLocalStaticVar() const;
 
-  void SetLocalPtr(llvm::AllocaInst* local_ptr);
-  llvm::AllocaInst* GetLocalPtr() const;
+  void SetLocalPtr(llvm::Value* local_ptr);
+  llvm::Value* GetLocalPtr() const;
   llvm::GlobalVariable* GetGlobalPtr() const;
 
   std::list<std::pair<Type*, std::int32_t>>& GetIndexs();
@@ -428,6 +458,8 @@ class ObjectExpr : public IdentifierExpr {
   void SetFuncName(const std::string& func_name);
 
  private:
+  friend class AstContext;
+
   ObjectExpr(const std::string& name, QualType type,
              std::uint32_t storage_class_spec = 0,
              enum Linkage linkage = Linkage::kNone, bool anonymous = false,
@@ -437,6 +469,7 @@ class ObjectExpr : public IdentifierExpr {
 
   std::uint32_t storage_class_spec_{};
   std::int32_t align_{};
+  Attributes attrs_;
   std::int32_t offset_{};
 
   std::int32_t bit_field_width_{};
@@ -448,7 +481,7 @@ class ObjectExpr : public IdentifierExpr {
   // 用于索引结构体或数组成员
   std::list<std::pair<Type*, std::int32_t>> indexs_;
 
-  llvm::AllocaInst* local_ptr_{};
+  llvm::Value* local_ptr_{};
 
   std::string func_name_;
 };
@@ -466,6 +499,8 @@ class StmtExpr : public Expr {
   const CompoundStmt* GetBlock() const;
 
  private:
+  friend class AstContext;
+
   StmtExpr(CompoundStmt* block);
 
   CompoundStmt* block_;
@@ -489,6 +524,8 @@ class LabelStmt : public Stmt {
   const std::string& GetName() const;
 
  private:
+  friend class AstContext;
+
   explicit LabelStmt(const std::string& name, Stmt* stmt);
 
   std::string name_;
@@ -510,6 +547,8 @@ class CaseStmt : public Stmt {
   const Stmt* GetStmt() const;
 
  private:
+  friend class AstContext;
+
   CaseStmt(std::int64_t lhs, Stmt* stmt);
   CaseStmt(std::int64_t lhs, std::int64_t rhs, Stmt* stmt);
 
@@ -531,6 +570,8 @@ class DefaultStmt : public Stmt {
   const Stmt* GetStmt() const;
 
  private:
+  friend class AstContext;
+
   DefaultStmt(Stmt* stmt);
 
   Stmt* stmt_;
@@ -539,21 +580,23 @@ class DefaultStmt : public Stmt {
 class CompoundStmt : public Stmt {
  public:
   static CompoundStmt* Get();
-  static CompoundStmt* Get(std::vector<Stmt*> stmts);
+  static CompoundStmt* Get(ArenaVector<Stmt*> stmts);
 
   virtual AstNodeType Kind() const override;
   virtual void Accept(Visitor& visitor) const override;
   virtual void Check() override;
   virtual std::vector<Stmt*> Children() const override;
 
-  const std::vector<Stmt*>& GetStmts() const;
+  const ArenaVector<Stmt*>& GetStmts() const;
   void AddStmt(Stmt* stmt);
 
  private:
+  friend class AstContext;
+
   CompoundStmt() = default;
-  explicit CompoundStmt(std::vector<Stmt*> stmts);
+  explicit CompoundStmt(ArenaVector<Stmt*> stmts);
 
-  std::vector<Stmt*> stmts_;
+  ArenaVector<Stmt*> stmts_;
 };
 
 class ExprStmt : public Stmt {
@@ -567,6 +610,8 @@ class ExprStmt : public Stmt {
   Expr* GetExpr() const;
 
  private:
+  friend class AstContext;
+
   explicit ExprStmt(Expr* expr = nullptr);
 
   Expr* expr_;
@@ -586,6 +631,8 @@ class IfStmt : public Stmt {
   const Stmt* GetElse() const;
 
  private:
+  friend class AstContext;
+
   IfStmt(Expr* cond, Stmt* then_block, Stmt* else_block = nullptr);
 
   Expr* cond_;
@@ -606,6 +653,8 @@ class SwitchStmt : public Stmt {
   const Stmt* GetStmt() const;
 
  private:
+  friend class AstContext;
+
   SwitchStmt(Expr* cond, Stmt* stmt);
 
   Expr* cond_;
@@ -625,6 +674,8 @@ class WhileStmt : public Stmt {
   const Stmt* GetBlock() const;
 
  private:
+  friend class AstContext;
+
   WhileStmt(Expr* cond, Stmt* block);
 
   Expr* cond_;
@@ -644,6 +695,8 @@ class DoWhileStmt : public Stmt {
   const Stmt* GetBlock() const;
 
  private:
+  friend class AstContext;
+
   DoWhileStmt(Expr* cond, Stmt* block);
 
   Expr* cond_;
@@ -667,6 +720,8 @@ class ForStmt : public Stmt {
   const Stmt* GetDecl() const;
 
  private:
+  friend class AstContext;
+
   ForStmt(Expr* init, Expr* cond, Expr* inc, Stmt* block, Stmt* decl);
 
   Expr *init_, *cond_, *inc_;
@@ -688,6 +743,8 @@ class GotoStmt : public Stmt {
   const std::string& GetName() const;
 
  private:
+  friend class AstContext;
+
   explicit GotoStmt(const std::string& name);
   explicit GotoStmt(LabelStmt* ident);
 
@@ -704,6 +761,8 @@ class ContinueStmt : public Stmt {
   virtual void Check() override;
 
  private:
+  friend class AstContext;
+
   ContinueStmt() = default;
 };
 
@@ -716,6 +775,8 @@ class BreakStmt : public Stmt {
   virtual void Check() override;
 
  private:
+  friend class AstContext;
+
   BreakStmt() = default;
 };
 
@@ -730,6 +791,8 @@ class ReturnStmt : public Stmt {
   const Expr* GetExpr() const;
 
  private:
+  friend class AstContext;
+
   explicit ReturnStmt(Expr* expr = nullptr);
 
   Expr* expr_;
@@ -746,10 +809,12 @@ class TranslationUnit : public AstNode {
   virtual void Check() override;
 
   void AddExtDecl(ExtDecl* ext_decl);
-  const std::vector<ExtDecl*>& GetExtDecl() const;
+  const ArenaVector<ExtDecl*>& GetExtDecl() const;
 
  private:
-  std::vector<ExtDecl*> ext_decls_;
+  friend class AstContext;
+
+  ArenaVector<ExtDecl*> ext_decls_;
 };
 
 class Initializer {
@@ -801,6 +866,8 @@ class Declaration : public Stmt {
   bool IsObjDeclInGlobalOrLocalStatic() const;
 
  private:
+  friend class AstContext;
+
   explicit Declaration(IdentifierExpr* ident);
 
   IdentifierExpr* ident_;
@@ -828,6 +895,8 @@ class FuncDef : public ExtDecl {
   const CompoundStmt* GetBody() const;
 
  private:
+  friend class AstContext;
+
   explicit FuncDef(IdentifierExpr* ident);
 
   IdentifierExpr* ident_;
@@ -835,7 +904,7 @@ class FuncDef : public ExtDecl {
 };
 
 template <typename T, typename... Args>
-T* MakeAstNode(const Location& loc, Args&&... args) {
+T* MakeAstNode(SourceLocation loc, Args&&... args) {
   auto t{T::Get(std::forward<Args>(args)...)};
   t->SetLoc(loc);
   t->Check();
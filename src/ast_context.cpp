@@ -0,0 +1,114 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#include "ast_context.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+
+namespace kcc {
+
+AstContext::~AstContext() { Clear(); }
+
+void* AstContext::Allocate(std::size_t size, std::size_t align) {
+  assert(align != 0 && (align & (align - 1)) == 0);
+
+  auto padding{(align - reinterpret_cast<std::uintptr_t>(curr_) % align) %
+               align};
+
+  if (curr_ == nullptr ||
+      static_cast<std::size_t>(end_ - curr_) < padding + size) {
+    auto shift{std::min(std::size(blocks_), std::size_t{4})};
+    auto block_size{std::min(BlockSize, MinBlockSize << shift)};
+
+    // 较大的对象单独分配一块, 不影响当前块的剩余空间
+    if (size + align > block_size / 2) {
+      auto block{static_cast<char*>(operator new(size + align))};
+      blocks_.push_back(block);
+      bytes_allocated_ += size;
+      bytes_reserved_ += size + align;
+
+      auto offset{(align - reinterpret_cast<std::uintptr_t>(block) % align) %
+                  align};
+      return block + offset;
+    }
+
+    curr_ = static_cast<char*>(operator new(block_size));
+    end_ = curr_ + block_size;
+    blocks_.push_back(curr_);
+    bytes_reserved_ += block_size;
+
+    padding =
+        (align - reinterpret_cast<std::uintptr_t>(curr_) % align) % align;
+  }
+
+  auto ptr{curr_ + padding};
+  curr_ = ptr + size;
+  bytes_allocated_ += size;
+
+  return ptr;
+}
+
+std::size_t AstContext::GetBytesAllocated() const { return bytes_allocated_; }
+
+std::size_t AstContext::GetBytesReserved() const { return bytes_reserved_; }
+
+std::size_t AstContext::GetBlockCount() const { return std::size(blocks_); }
+
+std::size_t AstContext::GetPeakBytes() const {
+  return std::max(peak_bytes_, bytes_allocated_);
+}
+
+void AstContext::Clear() {
+  // 后创建的对象先析构
+  for (auto destructor{destructors_}; destructor != nullptr;
+       destructor = destructor->next) {
+    destructor->destroy(destructor->object);
+  }
+
+  for (auto block : blocks_) {
+    operator delete(block);
+  }
+
+  peak_bytes_ = GetPeakBytes();
+
+  blocks_.clear();
+  curr_ = nullptr;
+  end_ = nullptr;
+  bytes_allocated_ = 0;
+  bytes_reserved_ = 0;
+  destructors_ = nullptr;
+}
+
+void AstContext::Splice(AstContext& other) {
+  assert(&other != this);
+
+  // other 中的对象创建得更晚, 应当先析构
+  if (other.destructors_ != nullptr) {
+    auto last{other.destructors_};
+    while (last->next != nullptr) {
+      last = last->next;
+    }
+    last->next = destructors_;
+    destructors_ = other.destructors_;
+  }
+
+  blocks_.insert(std::end(blocks_), std::begin(other.blocks_),
+                 std::end(other.blocks_));
+  bytes_allocated_ += other.bytes_allocated_;
+  bytes_reserved_ += other.bytes_reserved_;
+
+  other.peak_bytes_ = other.GetPeakBytes();
+
+  other.blocks_.clear();
+  other.curr_ = nullptr;
+  other.end_ = nullptr;
+  other.bytes_allocated_ = 0;
+  other.bytes_reserved_ = 0;
+  other.destructors_ = nullptr;
+}
+
+}  // namespace kcc
@@ -0,0 +1,134 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <llvm/Support/TypeName.h>
+
+#include "stats.h"
+
+namespace kcc {
+
+// 翻译单元的内存区域, AST 节点, 类型和作用域都从这里分配
+// 分配时只移动指针, 在翻译单元编译结束时一次性调用析构函数并释放
+class AstContext {
+ public:
+  AstContext() = default;
+  ~AstContext();
+
+  AstContext(const AstContext&) = delete;
+  AstContext(AstContext&&) = delete;
+  AstContext& operator=(const AstContext&) = delete;
+  AstContext& operator=(AstContext&&) = delete;
+
+  void* Allocate(std::size_t size, std::size_t align);
+
+  // 类的构造函数一般是私有的, 需要将 AstContext 声明为友元
+  template <typename T, typename... Args>
+  T* New(Args&&... args);
+
+  std::size_t GetBytesAllocated() const;
+  // 包括块中未使用的部分
+  std::size_t GetBytesReserved() const;
+  std::size_t GetBlockCount() const;
+  // 包括 Clear 和 Splice 之前分配的字节数
+  std::size_t GetPeakBytes() const;
+  // 调用所有析构函数并释放内存, 之后可以继续分配
+  void Clear();
+  // 接管 other 中的所有对象, 它们的生存期变为与 this 相同, other 变为空
+  void Splice(AstContext& other);
+
+ private:
+  // 需要调用析构函数的对象, 记录本身也分配在内存区域中
+  struct Destructor {
+    void (*destroy)(void*);
+    void* object;
+    Destructor* next;
+  };
+
+  // 块的大小从 MinBlockSize 开始翻倍直到 BlockSize, 使只有一个函数体的
+  // 区域 (如推迟生成的函数) 不会占用远大于它的内存
+  constexpr static std::size_t MinBlockSize{4 * 1024};
+  constexpr static std::size_t BlockSize{64 * 1024};
+
+  std::vector<char*> blocks_;
+  char* curr_{};
+  char* end_{};
+  std::size_t bytes_allocated_{};
+  std::size_t bytes_reserved_{};
+  std::size_t peak_bytes_{};
+
+  Destructor* destructors_{};
+};
+
+template <typename T, typename... Args>
+T* AstContext::New(Args&&... args) {
+  auto ptr{new (Allocate(sizeof(T), alignof(T)))
+               T(std::forward<Args>(args)...)};
+
+  if (CollectStats) {
+    RecordAllocation(llvm::getTypeName<T>(), sizeof(T));
+  }
+
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    auto destructor{static_cast<Destructor*>(
+        Allocate(sizeof(Destructor), alignof(Destructor)))};
+    destructor->destroy = [](void* object) {
+      static_cast<T*>(object)->~T();
+    };
+    destructor->object = ptr;
+    destructor->next = destructors_;
+    destructors_ = destructor;
+  }
+
+  return ptr;
+}
+
+// 每个编译线程一个, 翻译单元的 CompilationContext 释放时清空
+inline thread_local AstContext AstCtx;
+
+// 函数体中的 AST 节点和块作用域分配在单独的区域中,
+// 流式编译时每个函数生成代码后即可释放, 类型总是分配在 AstCtx 中
+inline thread_local AstContext FuncBodyCtx;
+inline thread_local bool InFuncBody{false};
+
+inline AstContext& GetNodeCtx() { return InFuncBody ? FuncBodyCtx : AstCtx; }
+
+// 使容器的元素也和 AST 节点分配在同一区域中, 释放操作什么也不做
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  ArenaAllocator() = default;
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>&) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(GetNodeCtx().Allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T*, std::size_t) {}
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) {
+  return false;
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+}  // namespace kcc
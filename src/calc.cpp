@@ -5,24 +5,32 @@
 #include "calc.h"
 
 #include <cassert>
-#include <stdexcept>
+#include <iterator>
 
 #include <llvm/Support/Casting.h>
 
+#include "abi.h"
 #include "error.h"
 #include "llvm_common.h"
 
 namespace kcc {
 
-CalcConstantExpr::CalcConstantExpr(const Location& loc) : loc_{loc} {}
+CalcConstantExpr::CalcConstantExpr(SourceLocation loc) : loc_{loc} {}
 
 llvm::Constant* CalcConstantExpr::Calc(const Expr* expr) {
   assert(expr != nullptr);
 
-  try {
-    expr->Accept(*this);
-  } catch (const std::runtime_error&) {
-    return nullptr;
+  if (auto folded{expr->GetFoldedValue()}) {
+    return *folded;
+  }
+
+  val_ = nullptr;
+  expr->Accept(*this);
+
+  // 地址常量的计算可能创建全局变量, 不记录
+  if (val_ == nullptr || llvm::isa<llvm::ConstantInt>(val_) ||
+      llvm::isa<llvm::ConstantFP>(val_)) {
+    expr->SetFoldedValue(val_);
   }
 
   return val_;
@@ -48,53 +56,67 @@ std::optional<std::int64_t> CalcConstantExpr::CalcInteger(const Expr* expr,
   }
 }
 
-llvm::Constant* CalcConstantExpr::Throw(llvm::Constant* value) {
-  if (value == nullptr) {
-    throw std::runtime_error{"expect constant expression"};
-  } else {
-    return value;
+void CalcConstantExpr::Visit(const UnaryOpExpr* node) {
+  if (node->GetOp() == Tag::kAmp) {
+    val_ = Addr(node);
+    return;
   }
-}
 
-void CalcConstantExpr::Visit(const UnaryOpExpr* node) {
   auto expr{node->GetExpr()};
+  auto value{CalcConstantExpr{node->GetLoc()}.Calc(expr)};
+  if (!value) {
+    return;
+  }
 
   switch (node->GetOp()) {
     case Tag::kPlus:
-      val_ = Throw(CalcConstantExpr{node->GetLoc()}.Calc(expr));
+      val_ = value;
       break;
     case Tag::kMinus:
-      val_ = NegOp(Throw(CalcConstantExpr{node->GetLoc()}.Calc(expr)),
-                   expr->GetType()->IsUnsigned());
+      val_ = NegOp(value, expr->GetType()->IsUnsigned());
       break;
     case Tag::kTilde:
-      val_ = llvm::ConstantExpr::getNot(
-          Throw(CalcConstantExpr{node->GetLoc()}.Calc(expr)));
+      val_ = llvm::ConstantExpr::getNot(value);
       break;
     case Tag::kExclaim:
-      val_ = LogicNotOp(Throw(CalcConstantExpr{node->GetLoc()}.Calc(expr)));
-      break;
-    case Tag::kAmp:
-      val_ = Addr(node);
+      val_ = LogicNotOp(value);
       break;
     default:
-      Throw();
+      break;
   }
 }
 
 void CalcConstantExpr::Visit(const TypeCastExpr* node) {
   auto expr{node->GetExpr()};
-  val_ = ConstantCastTo(Throw(CalcConstantExpr{node->GetLoc()}.Calc(expr)),
-                        node->GetCastToType()->GetLLVMType(),
-                        expr->GetType()->IsUnsigned());
+
+  if (auto value{CalcConstantExpr{node->GetLoc()}.Calc(expr)}) {
+    val_ = ConstantCastTo(value, node->GetCastToType()->GetLLVMType(),
+                          expr->GetType()->IsUnsigned());
+  }
 }
 
 void CalcConstantExpr::Visit(const BinaryOpExpr* node) {
-#define L CalcConstantExpr{node->GetLoc()}.Calc(node->GetLHS())
-#define R CalcConstantExpr{node->GetLoc()}.Calc(node->GetRHS())
+  // 只计算需要的一边
+  switch (node->GetOp()) {
+    case Tag::kAmpAmp:
+      val_ = LogicAndOp(node);
+      return;
+    case Tag::kPipePipe:
+      val_ = LogicOrOp(node);
+      return;
+    default:
+      break;
+  }
 
-  Throw(L);
-  Throw(R);
+  auto lhs{CalcConstantExpr{node->GetLoc()}.Calc(node->GetLHS())};
+  if (!lhs) {
+    return;
+  }
+
+  auto rhs{CalcConstantExpr{node->GetLoc()}.Calc(node->GetRHS())};
+  if (!rhs) {
+    return;
+  }
 
   // 有时左右两边符号性可能不同
   // 如指针 + 整数(指针视为无符号）
@@ -102,88 +124,73 @@ void CalcConstantExpr::Visit(const BinaryOpExpr* node) {
 
   switch (node->GetOp()) {
     case Tag::kPlus:
-      val_ = AddOp(L, R, is_unsigned);
+      val_ = AddOp(lhs, rhs, is_unsigned);
       break;
     case Tag::kMinus:
-      val_ = SubOp(L, R, is_unsigned);
+      val_ = SubOp(lhs, rhs, is_unsigned);
       break;
     case Tag::kStar:
-      val_ = MulOp(L, R, is_unsigned);
+      val_ = MulOp(lhs, rhs, is_unsigned);
       break;
-    case Tag::kSlash: {
-      auto lhs{L};
-      auto rhs{R};
-      if (rhs->isZeroValue()) {
-        Error(node->GetRHS(), "division by zero");
+    case Tag::kSlash:
+      // 除以 0 不是常量表达式, 不在编译时求值
+      if (!rhs->isZeroValue()) {
+        val_ = DivOp(lhs, rhs, is_unsigned);
       }
-      val_ = DivOp(lhs, rhs, is_unsigned);
       break;
-    }
-    case Tag::kPercent: {
-      auto lhs{L};
-      auto rhs{R};
-      if (rhs->isZeroValue()) {
-        Error(node->GetRHS(), "division by zero");
+    case Tag::kPercent:
+      if (!rhs->isZeroValue()) {
+        val_ = ModOp(lhs, rhs, is_unsigned);
       }
-      val_ = ModOp(lhs, rhs, is_unsigned);
       break;
-    }
     case Tag::kAmp:
-      val_ = AndOp(L, R);
+      val_ = AndOp(lhs, rhs);
       break;
     case Tag::kPipe:
-      val_ = OrOp(L, R);
+      val_ = OrOp(lhs, rhs);
       break;
     case Tag::kCaret:
-      val_ = XorOp(L, R);
+      val_ = XorOp(lhs, rhs);
       break;
     case Tag::kLessLess:
-      val_ = ShlOp(L, R);
+      val_ = ShlOp(lhs, rhs);
       break;
     case Tag::kGreaterGreater:
-      val_ = ShrOp(L, R, is_unsigned);
-      break;
-    case Tag::kAmpAmp:
-      val_ = LogicAndOp(node);
-      break;
-    case Tag::kPipePipe:
-      val_ = LogicOrOp(node);
+      val_ = ShrOp(lhs, rhs, is_unsigned);
       break;
     case Tag::kEqualEqual:
-      val_ = EqualOp(L, R);
+      val_ = EqualOp(lhs, rhs);
       break;
     case Tag::kExclaimEqual:
-      val_ = NotEqualOp(L, R);
+      val_ = NotEqualOp(lhs, rhs);
       break;
     case Tag::kLess:
-      val_ = LessOp(L, R, is_unsigned);
+      val_ = LessOp(lhs, rhs, is_unsigned);
       break;
     case Tag::kGreater:
-      val_ = GreaterOp(L, R, is_unsigned);
+      val_ = GreaterOp(lhs, rhs, is_unsigned);
       break;
     case Tag::kLessEqual:
-      val_ = LessEqualOp(L, R, is_unsigned);
+      val_ = LessEqualOp(lhs, rhs, is_unsigned);
       break;
     case Tag::kGreaterEqual:
-      val_ = GreaterEqualOp(L, R, is_unsigned);
+      val_ = GreaterEqualOp(lhs, rhs, is_unsigned);
       break;
     default:
-      Throw();
+      break;
   }
-
-#undef L
-#undef R
-#undef I_L
-#undef I_R
 }
 
 void CalcConstantExpr::Visit(const ConditionOpExpr* node) {
-  auto cond{Throw(CalcConstantExpr{node->GetLoc()}.Calc(node->GetCond()))};
+  auto cond{CalcConstantExpr{node->GetLoc()}.Calc(node->GetCond())};
+  if (!cond) {
+    return;
+  }
 
   if (cond->isZeroValue()) {
-    val_ = Throw(CalcConstantExpr{node->GetLoc()}.Calc(node->GetRHS()));
+    val_ = CalcConstantExpr{node->GetLoc()}.Calc(node->GetRHS());
   } else {
-    val_ = Throw(CalcConstantExpr{node->GetLoc()}.Calc(node->GetLHS()));
+    val_ = CalcConstantExpr{node->GetLoc()}.Calc(node->GetLHS());
   }
 }
 
@@ -203,15 +210,16 @@ void CalcConstantExpr::Visit(const EnumeratorExpr* node) {
   val_ = llvm::ConstantInt::get(node->GetType()->GetLLVMType(), node->GetVal());
 }
 
+// 只有一条表达式语句时才可能是常量, 否则其余的语句可能有副作用
 void CalcConstantExpr::Visit(const StmtExpr* node) {
-  if (!node->GetType()->IsVoidTy()) {
-    auto last{node->GetBlock()->GetStmts().back()};
+  const auto& stmts{node->GetBlock()->GetStmts()};
+
+  if (!node->GetType()->IsVoidTy() && std::size(stmts) == 1) {
+    auto last{stmts.back()};
     assert(last->Kind() == AstNodeType::kExprStmt);
 
-    val_ = Throw(CalcConstantExpr{node->GetLoc()}.Calc(
-        dynamic_cast<ExprStmt*>(last)->GetExpr()));
-  } else {
-    Throw();
+    val_ = CalcConstantExpr{node->GetLoc()}.Calc(
+        dynamic_cast<ExprStmt*>(last)->GetExpr());
   }
 }
 
@@ -219,7 +227,27 @@ void CalcConstantExpr::Visit(const StringLiteralExpr* node) {
   val_ = node->GetPtr();
 }
 
-void CalcConstantExpr::Visit(const FuncCallExpr*) { Throw(); }
+// GNU 扩展, 内置函数的参数是常量时结果也是常量
+void CalcConstantExpr::Visit(const FuncCallExpr* node) {
+  auto func_type{node->GetFuncType()};
+  if (!func_type->IsFunctionTy()) {
+    return;
+  }
+
+  const auto& func_name{func_type->FuncGetName()};
+  const auto& args{node->GetArgs()};
+
+  if (func_name == "__builtin_constant_p") {
+    // 不是常量时需要在生成代码时判断
+    if (std::size(args) == 1 && args.front()->GetType()->IsArithmeticTy() &&
+        CalcConstantExpr{node->GetLoc()}.Calc(args.front())) {
+      val_ = llvm::ConstantInt::get(Builder->getInt32Ty(), 1);
+    }
+  } else if (func_name == "__builtin_expect" ||
+             func_name == "__builtin_expect_with_probability") {
+    val_ = CalcConstantExpr{node->GetLoc()}.Calc(args.front());
+  }
+}
 
 void CalcConstantExpr::Visit(const IdentifierExpr* node) {
   auto type{node->GetType()};
@@ -227,17 +255,13 @@ void CalcConstantExpr::Visit(const IdentifierExpr* node) {
 
   auto name{node->GetName()};
 
-  auto func{Module->getFunction(name)};
-  if (!func) {
-    func = llvm::Function::Create(
-        llvm::cast<llvm::FunctionType>(type->GetLLVMType()),
-        node->GetLinkage() == Linkage::kInternal
-            ? llvm::Function::InternalLinkage
-            : llvm::Function::ExternalLinkage,
-        name, Module.get());
-  }
+  auto func{GetOrCreateFunction(name, type,
+                                 node->GetLinkage() == Linkage::kInternal
+                                     ? llvm::Function::InternalLinkage
+                                     : llvm::Function::ExternalLinkage)};
 
-  val_ = func;
+  val_ = llvm::ConstantExpr::getBitCast(func,
+                                        type->GetLLVMType()->getPointerTo());
 }
 
 void CalcConstantExpr::Visit(const ObjectExpr* node) {
@@ -246,8 +270,6 @@ void CalcConstantExpr::Visit(const ObjectExpr* node) {
   if ((node->IsGlobalVar() || node->IsLocalStaticVar()) &&
       (type->IsArrayTy() || type->IsStructOrUnionTy())) {
     val_ = node->GetGlobalPtr();
-  } else {
-    Throw();
   }
 }
 
@@ -304,9 +326,9 @@ llvm::Constant* CalcConstantExpr::NegOp(llvm::Constant* value,
 llvm::Constant* CalcConstantExpr::LogicNotOp(llvm::Constant* value) {
   value = ConstantCastToBool(value);
   value =
-      llvm::ConstantExpr::getXor(value, llvm::ConstantInt::getTrue(Context));
+      llvm::ConstantExpr::getXor(value, llvm::ConstantInt::getTrue(*Context));
 
-  return llvm::ConstantExpr::getZExt(value, Builder.getInt32Ty());
+  return llvm::ConstantExpr::getZExt(value, Builder->getInt32Ty());
 }
 
 // 运算对象可以是:
@@ -322,34 +344,37 @@ llvm::Constant* CalcConstantExpr::Addr(const UnaryOpExpr* node) {
     assert(obj->IsGlobalVar() || obj->IsLocalStaticVar());
     return obj->GetGlobalPtr();
   } else if (expr->Kind() == AstNodeType::kIdentifierExpr) {
-    return Throw(CalcConstantExpr{node->GetLoc()}.Calc(expr));
+    return CalcConstantExpr{node->GetLoc()}.Calc(expr);
   } else if (auto unary{dynamic_cast<const UnaryOpExpr*>(expr)}) {
     if (unary->GetOp() != Tag::kStar) {
-      Throw();
+      return nullptr;
     }
 
     auto binary{dynamic_cast<const BinaryOpExpr*>(unary->GetExpr())};
-
     if (!binary || binary->GetOp() != Tag::kPlus) {
-      Throw();
+      return nullptr;
     }
 
-    assert(binary != nullptr);
-    auto lhs{Throw(CalcConstantExpr{node->GetLoc()}.Calc(binary->GetLHS()))};
-    auto rhs{Throw(CalcConstantExpr{node->GetLoc()}.Calc(binary->GetRHS()))};
+    auto lhs{CalcConstantExpr{node->GetLoc()}.Calc(binary->GetLHS())};
+    auto rhs{CalcConstantExpr{node->GetLoc()}.Calc(binary->GetRHS())};
+    if (!lhs || !rhs) {
+      return nullptr;
+    }
 
     llvm::Constant* index[]{rhs};
     return llvm::ConstantExpr::getInBoundsGetElementPtr(nullptr, lhs, index);
   } else if (auto binary{dynamic_cast<const BinaryOpExpr*>(expr)}) {
-    auto lhs{Throw(CalcConstantExpr{node->GetLoc()}.Calc(binary->GetLHS()))};
+    auto lhs{CalcConstantExpr{node->GetLoc()}.Calc(binary->GetLHS())};
+    if (!lhs) {
+      return nullptr;
+    }
 
     auto member{dynamic_cast<const ObjectExpr*>(binary->GetRHS())};
     assert(member != nullptr);
 
     return llvm::ConstantExpr::getInBoundsGetElementPtr(
-        nullptr, lhs, Builder.getInt64(member->GetIndexs().back().second));
+        nullptr, lhs, Builder->getInt64(member->GetIndexs().back().second));
   } else {
-    Throw();
     return nullptr;
   }
 }
@@ -389,12 +414,13 @@ llvm::Constant* CalcConstantExpr::SubOp(llvm::Constant* lhs,
   } else if (IsPointerTy(lhs) && IsPointerTy(rhs)) {
     auto type{lhs->getType()->getPointerElementType()};
 
-    lhs = ConstantCastTo(lhs, Builder.getInt64Ty(), true);
-    rhs = ConstantCastTo(rhs, Builder.getInt64Ty(), true);
+    lhs = ConstantCastTo(lhs, Builder->getInt64Ty(), true);
+    rhs = ConstantCastTo(rhs, Builder->getInt64Ty(), true);
 
     auto value{SubOp(lhs, rhs, true)};
     return DivOp(
-        value, Builder.getInt64(Module->getDataLayout().getTypeAllocSize(type)),
+        value,
+        Builder->getInt64(Module->getDataLayout().getTypeAllocSize(type)),
         true);
   } else {
     assert(false);
@@ -492,7 +518,7 @@ llvm::Constant* CalcConstantExpr::LessEqualOp(llvm::Constant* lhs,
     return nullptr;
   }
 
-  return llvm::ConstantExpr::getZExt(value, Builder.getInt32Ty());
+  return llvm::ConstantExpr::getZExt(value, Builder->getInt32Ty());
 }
 
 llvm::Constant* CalcConstantExpr::LessOp(llvm::Constant* lhs,
@@ -515,7 +541,7 @@ llvm::Constant* CalcConstantExpr::LessOp(llvm::Constant* lhs,
     return nullptr;
   }
 
-  return llvm::ConstantExpr::getZExt(value, Builder.getInt32Ty());
+  return llvm::ConstantExpr::getZExt(value, Builder->getInt32Ty());
 }
 
 llvm::Constant* CalcConstantExpr::GreaterEqualOp(llvm::Constant* lhs,
@@ -538,7 +564,7 @@ llvm::Constant* CalcConstantExpr::GreaterEqualOp(llvm::Constant* lhs,
     return nullptr;
   }
 
-  return llvm::ConstantExpr::getZExt(value, Builder.getInt32Ty());
+  return llvm::ConstantExpr::getZExt(value, Builder->getInt32Ty());
 }
 
 llvm::Constant* CalcConstantExpr::GreaterOp(llvm::Constant* lhs,
@@ -561,7 +587,7 @@ llvm::Constant* CalcConstantExpr::GreaterOp(llvm::Constant* lhs,
     return nullptr;
   }
 
-  return llvm::ConstantExpr::getZExt(value, Builder.getInt32Ty());
+  return llvm::ConstantExpr::getZExt(value, Builder->getInt32Ty());
 }
 
 llvm::Constant* CalcConstantExpr::EqualOp(llvm::Constant* lhs,
@@ -577,7 +603,7 @@ llvm::Constant* CalcConstantExpr::EqualOp(llvm::Constant* lhs,
     return nullptr;
   }
 
-  return llvm::ConstantExpr::getZExt(value, Builder.getInt32Ty());
+  return llvm::ConstantExpr::getZExt(value, Builder->getInt32Ty());
 }
 
 llvm::Constant* CalcConstantExpr::NotEqualOp(llvm::Constant* lhs,
@@ -593,28 +619,42 @@ llvm::Constant* CalcConstantExpr::NotEqualOp(llvm::Constant* lhs,
     return nullptr;
   }
 
-  return llvm::ConstantExpr::getZExt(value, Builder.getInt32Ty());
+  return llvm::ConstantExpr::getZExt(value, Builder->getInt32Ty());
 }
 
 llvm::Constant* CalcConstantExpr::LogicOrOp(const BinaryOpExpr* node) {
-  auto lhs{Throw(CalcConstantExpr{}.Calc(node->GetLHS()))};
+  auto lhs{CalcConstantExpr{}.Calc(node->GetLHS())};
+  if (!lhs) {
+    return nullptr;
+  }
 
   if (lhs->isZeroValue()) {
-    auto rhs{Throw(CalcConstantExpr{}.Calc(node->GetRHS()))};
-    return llvm::ConstantInt::get(Builder.getInt32Ty(), !rhs->isZeroValue());
+    auto rhs{CalcConstantExpr{}.Calc(node->GetRHS())};
+    if (!rhs) {
+      return nullptr;
+    }
+
+    return llvm::ConstantInt::get(Builder->getInt32Ty(), !rhs->isZeroValue());
   } else {
-    return llvm::ConstantInt::get(Builder.getInt32Ty(), 1);
+    return llvm::ConstantInt::get(Builder->getInt32Ty(), 1);
   }
 }
 
 llvm::Constant* CalcConstantExpr::LogicAndOp(const BinaryOpExpr* node) {
-  auto lhs{Throw(CalcConstantExpr{}.Calc(node->GetLHS()))};
+  auto lhs{CalcConstantExpr{}.Calc(node->GetLHS())};
+  if (!lhs) {
+    return nullptr;
+  }
 
   if (lhs->isZeroValue()) {
-    return llvm::ConstantInt::get(Builder.getInt32Ty(), 0);
+    return llvm::ConstantInt::get(Builder->getInt32Ty(), 0);
   } else {
-    auto rhs{Throw(CalcConstantExpr{}.Calc(node->GetRHS()))};
-    return llvm::ConstantInt::get(Builder.getInt32Ty(), !rhs->isZeroValue());
+    auto rhs{CalcConstantExpr{}.Calc(node->GetRHS())};
+    if (!rhs) {
+      return nullptr;
+    }
+
+    return llvm::ConstantInt::get(Builder->getInt32Ty(), !rhs->isZeroValue());
   }
 }
 
@@ -15,17 +15,17 @@
 
 namespace kcc {
 
+// 不是常量表达式时返回 nullptr
+// 整数和浮点数常量的结果以及"不是常量"的判断记录在 Expr 中, 只计算一次
 class CalcConstantExpr : public Visitor {
  public:
-  explicit CalcConstantExpr(const Location& loc = {});
+  explicit CalcConstantExpr(SourceLocation loc = {});
 
   llvm::Constant* Calc(const Expr* expr);
   std::optional<std::int64_t> CalcInteger(const Expr* expr,
                                           bool as_error = true);
 
  private:
-  static llvm::Constant* Throw(llvm::Constant* value = nullptr);
-
   virtual void Visit(const UnaryOpExpr* node) override;
   virtual void Visit(const TypeCastExpr* node) override;
   virtual void Visit(const BinaryOpExpr* node) override;
@@ -92,7 +92,7 @@ class CalcConstantExpr : public Visitor {
   static llvm::Constant* LogicAndOp(const BinaryOpExpr* node);
 
   llvm::Constant* val_{};
-  Location loc_;
+  SourceLocation loc_;
 };
 
 }  // namespace kcc
@@ -4,7 +4,12 @@
 
 #include "code_gen.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
 #include <vector>
 
 #include <llvm/IR/Attributes.h>
@@ -14,14 +19,18 @@
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Support/Casting.h>
+#include <llvm/Support/MathExtras.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetOptions.h>
 
 #include "calc.h"
 #include "error.h"
 #include "llvm_common.h"
+#include "tbaa.h"
+#include "time_trace.h"
 #include "util.h"
 
 namespace kcc {
@@ -36,12 +45,68 @@ CodeGen::BreakContinue::BreakContinue(llvm::BasicBlock* break_block,
 /*
  * CodeGen
  */
-void CodeGen::GenCode(const TranslationUnit* root) {
+CodeGen::CodeGen() {
+  DeferredBodyPeakBytes = 0;
+
   if (Debug) {
     debug_info_ = std::make_unique<DebugInfo>();
   }
+}
 
+void CodeGen::GenCode(const TranslationUnit* root) {
   root->Accept(*this);
+  Finish();
+}
+
+void CodeGen::GenCode(const ExtDecl* node, AstContext* body_ctx) {
+  if (node->Kind() != AstNodeType::kFuncDef) {
+    auto decls{dynamic_cast<const CompoundStmt*>(node)};
+    for (const auto& item : decls->GetStmts()) {
+      RecordFuncDecl(dynamic_cast<const Declaration*>(item)->GetIdent());
+    }
+    global_decls_.push_back(node);
+    return;
+  }
+
+  auto func_def{dynamic_cast<const FuncDef*>(node)};
+  RecordFuncDecl(func_def->GetIdent());
+  if (IsDeferrable(func_def) && !IsReferenced(func_def->GetName())) {
+    std::unique_ptr<AstContext> body;
+    if (body_ctx) {
+      body = std::make_unique<AstContext>();
+      body->Splice(*body_ctx);
+      deferred_bytes_ += body->GetBytesReserved();
+      DeferredBodyPeakBytes = std::max(DeferredBodyPeakBytes, deferred_bytes_);
+    }
+
+    deferred_funcs_.push_back({func_def, std::move(body)});
+    return;
+  }
+
+  TimeTraceScope scope{Phase::kCodeGen};
+  func_def->Accept(*this);
+  EmitReferencedFuncs();
+}
+
+void CodeGen::Finish() {
+  TimeTraceScope scope{Phase::kCodeGen};
+
+  for (const auto& item : global_decls_) {
+    item->Accept(*this);
+  }
+  global_decls_.clear();
+
+  // 全局变量的初始值也可能引用函数, 因此在它们之后生成
+  EmitDeferredFuncs();
+
+  // 内联定义之后的声明也可能使其成为外部定义
+  for (auto& func : *Module) {
+    if (func.hasAvailableExternallyLinkage() &&
+        external_funcs_.count(func.getName().str())) {
+      func.setLinkage(llvm::Function::ExternalLinkage);
+    }
+  }
+  external_funcs_.clear();
 
   if (debug_info_) {
     debug_info_->Finalize();
@@ -66,9 +131,9 @@ llvm::BasicBlock* CodeGen::CreateBasicBlock(const std::string& name,
                                             llvm::Function* parent) {
   (void)name;
 #ifdef NDEBUG
-  return llvm::BasicBlock::Create(Context, "", parent);
+  return llvm::BasicBlock::Create(*Context, "", parent);
 #else
-  return llvm::BasicBlock::Create(Context, name, parent);
+  return llvm::BasicBlock::Create(*Context, name, parent);
 #endif
 }
 
@@ -81,21 +146,21 @@ void CodeGen::EmitBlock(llvm::BasicBlock* bb, bool is_finished) {
   }
 
   func_->getBasicBlockList().push_back(bb);
-  Builder.SetInsertPoint(bb);
+  Builder->SetInsertPoint(bb);
 }
 
 void CodeGen::EmitBranch(llvm::BasicBlock* target) {
-  auto curr{Builder.GetInsertBlock()};
+  auto curr{Builder->GetInsertBlock()};
 
   if (curr && !curr->getTerminator()) {
-    Builder.CreateBr(target);
+    Builder->CreateBr(target);
   }
 
-  Builder.ClearInsertionPoint();
+  Builder->ClearInsertionPoint();
 }
 
 bool CodeGen::HaveInsertPoint() const {
-  return Builder.GetInsertBlock() != nullptr;
+  return Builder->GetInsertBlock() != nullptr;
 }
 
 void CodeGen::EnsureInsertPoint() {
@@ -146,7 +211,54 @@ void CodeGen::EmitBranchOnBoolExpr(const Expr* expr,
     return;
   }
 
-  Builder.CreateCondBr(EvaluateExprAsBool(expr), true_block, false_block);
+  auto weights{GetBranchWeights(expr)};
+  Builder->CreateCondBr(EvaluateExprAsBool(expr), true_block, false_block,
+                        weights);
+}
+
+// __builtin_expect(exp, c) 和 __builtin_expect_with_probability(exp, c, p)
+// 作为条件时转换为分支权重
+llvm::MDNode* CodeGen::GetBranchWeights(const Expr* cond) {
+  if (OptimizationLevel == OptLevel::kO0) {
+    return nullptr;
+  }
+
+  while (cond->Kind() == AstNodeType::kTypeCastExpr) {
+    cond = dynamic_cast<const TypeCastExpr*>(cond)->GetExpr();
+  }
+
+  auto call{dynamic_cast<const FuncCallExpr*>(cond)};
+  if (call == nullptr || !call->GetFuncType()->IsFunctionTy()) {
+    return nullptr;
+  }
+
+  // 与 LLVM 的 LowerExpectIntrinsic 使用相同的权重
+  const auto& func_name{call->GetFuncType()->FuncGetName()};
+  double probability{2000.0 / 2001.0};
+
+  if (func_name == "__builtin_expect_with_probability") {
+    // 概率在语法分析时已经检查
+    auto value{llvm::cast<llvm::ConstantFP>(
+        CalcConstantExpr{}.Calc(call->GetArgs()[2]))};
+    probability = value->getValueAPF().convertToDouble();
+  } else if (func_name != "__builtin_expect") {
+    return nullptr;
+  }
+
+  auto expected{CalcConstantExpr{}.CalcInteger(call->GetArgs()[1], false)};
+  if (!expected) {
+    return nullptr;
+  }
+
+  // 期望值为 0 时条件很可能为假
+  if (*expected == 0) {
+    probability = 1 - probability;
+  }
+
+  constexpr double Scale{std::numeric_limits<std::int32_t>::max() - 1};
+  return llvm::MDBuilder{*Context}.createBranchWeights(
+      static_cast<std::uint32_t>(std::round(probability * Scale)),
+      static_cast<std::uint32_t>(std::round((1 - probability) * Scale)));
 }
 
 void CodeGen::SimplifyForwardingBlocks(llvm::BasicBlock* bb) {
@@ -231,8 +343,8 @@ void CodeGen::EmitBranchThroughCleanup(llvm::BasicBlock* dest) {
     return;
   }
 
-  Builder.CreateBr(dest);
-  Builder.ClearInsertionPoint();
+  Builder->CreateBr(dest);
+  Builder->ClearInsertionPoint();
 }
 
 llvm::BasicBlock* CodeGen::GetBasicBlockForLabel(const LabelStmt* label) {
@@ -244,8 +356,110 @@ llvm::BasicBlock* CodeGen::GetBasicBlockForLabel(const LabelStmt* label) {
   return bb = CreateBasicBlock(label->GetName());
 }
 
+void CodeGen::RecordFuncDecl(const IdentifierExpr* ident) {
+  auto type{ident->GetType()};
+  if (type->IsFunctionTy() && ident->GetLinkage() == Linkage::kExternal &&
+      !type->FuncIsInlineDefinition()) {
+    external_funcs_.insert(ident->GetName());
+  }
+}
+
+// C99 6.7.4p7, 只有 inline 的定义不提供外部定义, 其他翻译单元中
+// 必须有外部定义, 因此生成的函数只用于内联
+bool CodeGen::IsInlineDefinition(const FuncDef* node) const {
+  return node->GetLinkage() == Linkage::kExternal &&
+         node->GetFuncType()->FuncIsInlineDefinition() &&
+         !external_funcs_.count(node->GetName());
+}
+
+// e.g. 头文件中的 static inline 函数, 大部分翻译单元都不会使用
+// used 的函数即使没有被引用也要生成
+bool CodeGen::IsDeferrable(const FuncDef* node) const {
+  if (node->GetFuncType()->FuncGetAttrs().attr_spec & kAttrUsed) {
+    return false;
+  }
+
+  return node->GetLinkage() == Linkage::kInternal || IsInlineDefinition(node);
+}
+
+bool CodeGen::IsReferenced(const std::string& name) {
+  auto func{Module->getFunction(name)};
+  if (!func) {
+    return false;
+  }
+
+  // 常量表达式求值时可能创建了没有被使用的常量
+  func->removeDeadConstantUsers();
+  return !func->use_empty();
+}
+
+// 生成的函数可能引用其他推迟的函数, 直到没有新的函数被引用为止
+void CodeGen::EmitReferencedFuncs() {
+  bool changed{true};
+
+  while (changed) {
+    changed = false;
+
+    // 之后的声明可能使内联定义成为外部定义
+    for (auto&& item : deferred_funcs_) {
+      if (item.func_def && (!IsDeferrable(item.func_def) ||
+                            IsReferenced(item.func_def->GetName()))) {
+        item.func_def->Accept(*this);
+        ReleaseDeferredFunc(item);
+        changed = true;
+      }
+    }
+  }
+
+  deferred_funcs_.erase(
+      std::remove_if(std::begin(deferred_funcs_), std::end(deferred_funcs_),
+                     [](const DeferredFunc& item) { return !item.func_def; }),
+      std::end(deferred_funcs_));
+}
+
+void CodeGen::ReleaseDeferredFunc(DeferredFunc& item) {
+  if (item.body) {
+    deferred_bytes_ -= item.body->GetBytesReserved();
+    item.body.reset();
+  }
+  item.func_def = nullptr;
+}
+
+void CodeGen::EmitDeferredFuncs() {
+  EmitReferencedFuncs();
+
+  for (auto&& item : deferred_funcs_) {
+    // 没有函数体的内部链接函数是非法的
+    if (auto func{Module->getFunction(item.func_def->GetName())}) {
+      func->eraseFromParent();
+    }
+    ReleaseDeferredFunc(item);
+    ++SkippedFuncCount;
+  }
+  deferred_funcs_.clear();
+}
+
 bool CodeGen::IsCheapEnoughToEvaluateUnconditionally(const Expr* expr) {
-  return expr->Kind() == AstNodeType::kConstantExpr;
+  if (expr->Kind() == AstNodeType::kConstantExpr) {
+    return true;
+  }
+
+  auto value{CalcConstantExpr{}.Calc(expr)};
+  return value && (llvm::isa<llvm::ConstantInt>(value) ||
+                   llvm::isa<llvm::ConstantFP>(value));
+}
+
+// 整个子树是算术常量时直接使用计算结果, 不再逐个节点生成指令
+bool CodeGen::TryEmitConstant(const Expr* expr) {
+  auto value{CalcConstantExpr{}.Calc(expr)};
+
+  if (value && (llvm::isa<llvm::ConstantInt>(value) ||
+                llvm::isa<llvm::ConstantFP>(value))) {
+    result_ = value;
+    return true;
+  } else {
+    return false;
+  }
 }
 
 llvm::AllocaInst* CodeGen::CreateEntryBlockAlloca(llvm::Type* type,
@@ -262,6 +476,197 @@ llvm::AllocaInst* CodeGen::CreateEntryBlockAlloca(llvm::Type* type,
   return ptr;
 }
 
+// e.g. u.a / s.u.a / u.arr[i] / *&u.a, 允许通过联合体的成员访问其他类型的对象
+bool CodeGen::IsAccessThroughUnion(const Expr* expr) {
+  while (true) {
+    if (auto binary{dynamic_cast<const BinaryOpExpr*>(expr)}) {
+      if (binary->GetOp() != Tag::kPeriod) {
+        return false;
+      }
+
+      auto obj{dynamic_cast<const ObjectExpr*>(binary->GetRHS())};
+      assert(obj != nullptr);
+
+      for (const auto& [type, index] : obj->GetIndexs()) {
+        if (type->IsUnionTy()) {
+          return true;
+        }
+      }
+
+      expr = binary->GetLHS();
+      continue;
+    }
+
+    auto unary{dynamic_cast<const UnaryOpExpr*>(expr)};
+    if (unary == nullptr || unary->GetOp() != Tag::kStar) {
+      return false;
+    }
+
+    // 下标 *(arr + i) 中的 arr 由数组转换而来, 它本身也是左值
+    auto ptr{unary->GetExpr()};
+    while (true) {
+      if (auto cast{dynamic_cast<const TypeCastExpr*>(ptr)}) {
+        ptr = cast->GetExpr();
+      } else if (auto binary{dynamic_cast<const BinaryOpExpr*>(ptr)};
+                 binary && (binary->GetOp() == Tag::kPlus ||
+                            binary->GetOp() == Tag::kMinus)) {
+        ptr = binary->GetLHS()->GetType()->IsPointerTy() ? binary->GetLHS()
+                                                          : binary->GetRHS();
+      } else {
+        break;
+      }
+    }
+
+    if (auto addr{dynamic_cast<const UnaryOpExpr*>(ptr)};
+        addr && addr->GetOp() == Tag::kAmp) {
+      expr = addr->GetExpr();
+    } else if (ptr->GetType()->IsArrayTy()) {
+      expr = ptr;
+    } else {
+      return false;
+    }
+  }
+}
+
+llvm::LoadInst* CodeGen::EmitLoad(llvm::Value* ptr, const Type* type,
+                                  bool is_volatile, bool may_alias) {
+  auto load{Builder->CreateLoad(ptr, is_volatile)};
+
+  if (type->IsScalarTy()) {
+    load->setAlignment(type->GetAlign());
+  }
+  if (auto tag{may_alias ? nullptr : GetTBAATag(type)}) {
+    load->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+  }
+
+  return load;
+}
+
+llvm::StoreInst* CodeGen::EmitStore(llvm::Value* value, llvm::Value* ptr,
+                                    const Type* type, bool is_volatile,
+                                    bool may_alias) {
+  auto store{Builder->CreateStore(value, ptr, is_volatile)};
+
+  if (type->IsScalarTy()) {
+    store->setAlignment(type->GetAlign());
+  }
+  if (auto tag{may_alias ? nullptr : GetTBAATag(type)}) {
+    store->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+  }
+
+  return store;
+}
+
+llvm::LoadInst* CodeGen::EmitLoad(llvm::Value* ptr, const Expr* lvalue,
+                                  bool is_volatile) {
+  auto load{EmitLoad(ptr, lvalue->GetType(), is_volatile,
+                     IsAccessThroughUnion(lvalue))};
+  AddRestrictMetadata(load, lvalue);
+  return load;
+}
+
+llvm::StoreInst* CodeGen::EmitStore(llvm::Value* value, llvm::Value* ptr,
+                                    const Expr* lvalue, bool is_volatile) {
+  auto store{EmitStore(value, ptr, lvalue->GetType(), is_volatile,
+                       IsAccessThroughUnion(lvalue))};
+  AddRestrictMetadata(store, lvalue);
+  return store;
+}
+
+// e.g. *p / p[i] / p->a
+// 由 restrict 指针计算得到的指针同样基于该指针
+const ObjectExpr* CodeGen::GetRestrictBase(const Expr* lvalue) {
+  while (lvalue->Kind() == AstNodeType::kBinaryOpExpr) {
+    auto binary{dynamic_cast<const BinaryOpExpr*>(lvalue)};
+    if (binary->GetOp() != Tag::kPeriod) {
+      return nullptr;
+    }
+    lvalue = binary->GetLHS();
+  }
+
+  auto unary{dynamic_cast<const UnaryOpExpr*>(lvalue)};
+  if (unary == nullptr || unary->GetOp() != Tag::kStar) {
+    return nullptr;
+  }
+
+  auto ptr{unary->GetExpr()};
+  while (true) {
+    if (auto cast{dynamic_cast<const TypeCastExpr*>(ptr)}) {
+      ptr = cast->GetExpr();
+    } else if (auto binary{dynamic_cast<const BinaryOpExpr*>(ptr)}) {
+      if (binary->GetOp() == Tag::kPlus || binary->GetOp() == Tag::kMinus) {
+        ptr = binary->GetLHS()->GetType()->IsPointerTy() ? binary->GetLHS()
+                                                          : binary->GetRHS();
+      } else {
+        return nullptr;
+      }
+    } else {
+      break;
+    }
+  }
+
+  auto obj{dynamic_cast<const ObjectExpr*>(ptr)};
+  if (obj && obj->GetQualType().IsRestrict()) {
+    return obj;
+  } else {
+    return nullptr;
+  }
+}
+
+void CodeGen::AddRestrict(const ObjectExpr* obj) {
+  if (OptimizationLevel == OptLevel::kO0) {
+    return;
+  }
+
+  for (const auto& item : restrict_scopes_) {
+    if (item.obj == obj) {
+      return;
+    }
+  }
+
+  llvm::MDBuilder builder{*Context};
+  if (!alias_domain_) {
+    alias_domain_ = builder.createAnonymousAliasScopeDomain(func_->getName());
+  }
+
+  restrict_scopes_.push_back(
+      {obj, builder.createAnonymousAliasScope(alias_domain_, obj->GetName())});
+}
+
+// 函数参数使用 noalias 属性
+void CodeGen::AddRestrictMetadata(llvm::Instruction* inst,
+                                  const Expr* lvalue) {
+  auto base{GetRestrictBase(lvalue)};
+  if (!base) {
+    return;
+  }
+
+  llvm::MDNode* scope{};
+  for (const auto& item : restrict_scopes_) {
+    if (item.obj == base) {
+      scope = item.scope;
+    }
+  }
+
+  if (!scope) {
+    return;
+  }
+
+  std::vector<llvm::Metadata*> noalias;
+  for (const auto& item : restrict_scopes_) {
+    if (item.obj != base) {
+      noalias.push_back(item.scope);
+    }
+  }
+
+  inst->setMetadata(llvm::LLVMContext::MD_alias_scope,
+                    llvm::MDNode::get(*Context, scope));
+  if (!std::empty(noalias)) {
+    inst->setMetadata(llvm::LLVMContext::MD_noalias,
+                      llvm::MDNode::get(*Context, noalias));
+  }
+}
+
 llvm::Value* CodeGen::GetPtr(const AstNode* node) {
   if (node->Kind() == AstNodeType::kObjectExpr) {
     auto obj{dynamic_cast<const ObjectExpr*>(node)};
@@ -276,6 +681,13 @@ llvm::Value* CodeGen::GetPtr(const AstNode* node) {
     // 函数指针
     node->Accept(*this);
     return result_;
+  } else if (node->Kind() == AstNodeType::kFuncCallExpr) {
+    // 返回值为结构体或联合体, e.g. f().a
+    auto load_struct{load_struct_};
+    load_struct_ = false;
+    node->Accept(*this);
+    load_struct_ = load_struct;
+    return result_;
   } else if (node->Kind() == AstNodeType::kUnaryOpExpr) {
     auto unary{dynamic_cast<const UnaryOpExpr*>(node)};
     assert(unary->GetOp() == Tag::kStar);
@@ -302,9 +714,9 @@ llvm::Value* CodeGen::GetPtr(const AstNode* node) {
       auto indexs{obj->GetIndexs()};
       for (const auto& [type, index] : indexs) {
         if (type->IsStructTy()) {
-          lhs_ptr = Builder.CreateStructGEP(lhs_ptr, index);
+          lhs_ptr = Builder->CreateStructGEP(lhs_ptr, index);
         } else {
-          lhs_ptr = Builder.CreateBitCast(
+          lhs_ptr = Builder->CreateBitCast(
               lhs_ptr,
               type->StructGetMemberType(index)->GetLLVMType()->getPointerTo());
         }
@@ -312,11 +724,11 @@ llvm::Value* CodeGen::GetPtr(const AstNode* node) {
 
       if (is_bit_field_) {
         if (obj->GetType()->IsBoolTy()) {
-          lhs_ptr = Builder.CreateBitCast(lhs_ptr,
-                                          Builder.getInt8Ty()->getPointerTo());
+          lhs_ptr = Builder->CreateBitCast(
+              lhs_ptr, Builder->getInt8Ty()->getPointerTo());
         } else {
-          lhs_ptr = Builder.CreateBitCast(lhs_ptr,
-                                          Builder.getInt32Ty()->getPointerTo());
+          lhs_ptr = Builder->CreateBitCast(
+              lhs_ptr, Builder->getInt32Ty()->getPointerTo());
         }
       }
 
@@ -366,7 +778,7 @@ void CodeGen::TryEmitFuncEnd() {
 }
 
 void CodeGen::TryEmitParamVar(const std::string& name, Type* type,
-                              llvm::AllocaInst* ptr, const Location& loc) {
+                              llvm::Value* ptr, SourceLocation loc) {
   if (debug_info_) {
     debug_info_->EmitParamVar(name, type, ptr, loc);
   }
@@ -388,7 +800,7 @@ void CodeGen::Visit(const TranslationUnit* node) {
   TryEmitLocation(node);
 
   for (const auto& item : node->GetExtDecl()) {
-    item->Accept(*this);
+    GenCode(item);
   }
 }
 
@@ -401,10 +813,13 @@ void CodeGen::Visit(const Declaration* node) {
   } else if (node->IsObjDeclInGlobalOrLocalStatic()) {
     if (node->IsObjDecl()) {
       auto obj{node->GetIdent()->ToObjectExpr()};
+      auto is_used{static_cast<bool>(obj->GetAttrs().attr_spec & kAttrUsed)};
       // 对于非 static 的全局变量直接生成
       // 其他的等到调用 GetGlobalPtr 是再生成
-      if (obj->IsGlobalVar() && !obj->IsStatic()) {
+      if (obj->IsGlobalVar() && (!obj->IsStatic() || is_used)) {
         CreateGlobalVar(obj);
+      } else if (obj->IsLocalStaticVar() && is_used) {
+        obj->GetGlobalPtr();
       }
     }
 
@@ -416,31 +831,66 @@ void CodeGen::Visit(const Declaration* node) {
 }
 
 void CodeGen::Visit(const FuncDef* node) {
+  FuncTimer timer{node->GetName()};
   StartFunction(node);
 
   TryEmitFuncStart(node);
   TryEmitLocation(nullptr);
 
-  auto iter{std::begin(node->GetFuncType()->FuncGetParams())};
-  for (auto&& arg : func_->args()) {
-    auto obj{*iter};
+  auto arg_iter{func_->arg_begin()};
+  if (func_abi_->ret.kind == ABIArgInfo::kIndirect) {
+    ++arg_iter;
+  }
+
+  auto abi_iter{std::begin(func_abi_->params)};
+  for (const auto& obj : node->GetFuncType()->FuncGetParams()) {
+    const auto& info{*abi_iter++};
     auto type{obj->GetType()};
     auto name{obj->GetName()};
 
+    // 按值传递的内存由调用者复制, 直接作为参数的存储
+    if (info.kind == ABIArgInfo::kIndirect) {
+      auto arg{&*arg_iter++};
+      arg->setName(name);
+      obj->SetLocalPtr(arg);
+      TryEmitParamVar(name, type, arg, obj->GetLoc());
+      continue;
+    }
+
     auto ptr{
-        CreateEntryBlockAlloca(type->GetLLVMType(), (*iter)->GetAlign(), name)};
-    (*iter)->SetLocalPtr(ptr);
+        CreateEntryBlockAlloca(type->GetLLVMType(), obj->GetAlign(), name)};
+    obj->SetLocalPtr(ptr);
 
     TryEmitParamVar(name, type, ptr, obj->GetLoc());
+
     // 将参数的值保存到分配的内存中
-    Builder.CreateStore(&arg, ptr, is_volatile_);
-    ++iter;
+    switch (info.kind) {
+      case ABIArgInfo::kDirect:
+        if (type->IsPointerTy() && obj->GetQualType().IsRestrict()) {
+          arg_iter->addAttr(llvm::Attribute::NoAlias);
+        }
+        EmitStore(&*arg_iter++, ptr, type, is_volatile_)
+            ->setAlignment(obj->GetAlign());
+        break;
+      case ABIArgInfo::kCoerce: {
+        std::vector<llvm::Value*> values;
+        for (std::size_t i{}; i < std::size(info.coerce_types); ++i) {
+          values.push_back(&*arg_iter++);
+        }
+        CreateCoercedStore(ptr, info, values);
+      } break;
+      case ABIArgInfo::kIndirect:
+        assert(false);
+        break;
+      case ABIArgInfo::kIgnore:
+        break;
+    }
   }
 
   TryEmitLocation(node);
 
   if (node->GetFuncType()->FuncGetName() == "main") {
-    Builder.CreateStore(Builder.getInt32(0), return_value_);
+    Builder->CreateStore(Builder->getInt32(0), return_value_);
   }
 
   EmitStmt(node->GetBody());
@@ -457,6 +907,13 @@ void CodeGen::DealLocaleDecl(const Declaration* node) {
   auto ptr{CreateEntryBlockAlloca(type->GetLLVMType(), obj->GetAlign(), name)};
   obj->SetLocalPtr(ptr);
 
+  // 嵌套的块 (如循环体) 每次执行时 restrict 指针都可能指向不同的对象,
+  // 而作用域是对整个函数的, 所以只处理函数最外层块中的局部变量
+  if (type->IsPointerTy() && obj->GetQualType().IsRestrict() &&
+      block_depth_ == 1) {
+    AddRestrict(obj);
+  }
+
   is_volatile_ = obj->GetQualType().IsVolatile();
 
   TryEmitLocalVar(node);
@@ -467,7 +924,8 @@ void CodeGen::DealLocaleDecl(const Declaration* node) {
       assert(std::size(init) == 1);
 
       init.front().GetExpr()->Accept(*this);
-      Builder.CreateStore(result_, obj->GetLocalPtr(), is_volatile_);
+      EmitStore(result_, obj->GetLocalPtr(), type, is_volatile_)
+          ->setAlignment(obj->GetAlign());
       is_volatile_ = false;
     } else if (type->IsAggregateTy()) {
       InitLocalAggregate(node);
@@ -475,13 +933,13 @@ void CodeGen::DealLocaleDecl(const Declaration* node) {
       assert(false);
     }
   } else if (node->HasConstantInit()) {
-    if (ptr->getType() != Builder.getInt8PtrTy()) {
-      result_ = Builder.CreateBitCast(ptr, Builder.getInt8PtrTy());
+    if (ptr->getType() != Builder->getInt8PtrTy()) {
+      result_ = Builder->CreateBitCast(ptr, Builder->getInt8PtrTy());
     }
 
-    Builder.CreateMemCpy(result_, obj->GetAlign(), node->GetConstant(),
-                         obj->GetAlign(), obj->GetType()->GetWidth(),
-                         is_volatile_);
+    Builder->CreateMemCpy(result_, obj->GetAlign(), node->GetConstant(),
+                          obj->GetAlign(), obj->GetType()->GetWidth(),
+                          is_volatile_);
     is_volatile_ = false;
   }
 }
@@ -492,9 +950,9 @@ void CodeGen::InitLocalAggregate(const Declaration* node) {
   auto obj{node->GetObject()};
   auto width{obj->GetType()->GetWidth()};
 
-  result_ = Builder.CreateBitCast(obj->GetLocalPtr(), Builder.getInt8PtrTy());
-  Builder.CreateMemSet(result_, Builder.getInt8(0), width, obj->GetAlign(),
-                       is_volatile_);
+  result_ = Builder->CreateBitCast(obj->GetLocalPtr(), Builder->getInt8PtrTy());
+  Builder->CreateMemSet(result_, Builder->getInt8(0), width, obj->GetAlign(),
+                        is_volatile_);
 
   for (const auto& item : node->GetLocalInits()) {
     Load_Struct_Obj();
@@ -504,22 +962,24 @@ void CodeGen::InitLocalAggregate(const Declaration* node) {
 
     llvm::Value* ptr{obj->GetLocalPtr()};
     Type* member_type{};
+    bool through_union{false};
     std::int8_t bit_field_begin{}, bit_field_width{};
     for (const auto& [type, index, begin, width] : item.GetIndexs()) {
       bit_field_begin = begin;
       bit_field_width = width;
+      through_union = through_union || type->IsUnionTy();
 
       if (type->IsArrayTy() && !width) {
         member_type = type->ArrayGetElementType().GetType();
-        ptr = Builder.CreateInBoundsGEP(
-            ptr, {Builder.getInt64(0), Builder.getInt64(index)});
+        ptr = Builder->CreateInBoundsGEP(
+            ptr, {Builder->getInt64(0), Builder->getInt64(index)});
       } else if (type->IsStructTy()) {
         member_type = type->StructGetMemberType(index).GetType();
-        ptr = Builder.CreateStructGEP(ptr, index);
+        ptr = Builder->CreateStructGEP(ptr, index);
       } else if (type->IsUnionTy()) {
         member_type = type->StructGetMemberType(index).GetType();
-        ptr = Builder.CreateBitCast(ptr,
-                                    member_type->GetLLVMType()->getPointerTo());
+        ptr = Builder->CreateBitCast(
+            ptr, member_type->GetLLVMType()->getPointerTo());
       } else {
         member_type = type;
         break;
@@ -530,33 +990,46 @@ void CodeGen::InitLocalAggregate(const Declaration* node) {
       auto size{member_type->IsBoolTy() ? 8 : 32};
 
       if (member_type->IsBoolTy()) {
-        ptr = Builder.CreateBitCast(ptr, Builder.getInt8PtrTy());
+        ptr = Builder->CreateBitCast(ptr, Builder->getInt8PtrTy());
       } else {
-        ptr = Builder.CreateBitCast(ptr, Builder.getInt32Ty()->getPointerTo());
+        ptr =
+            Builder->CreateBitCast(ptr, Builder->getInt32Ty()->getPointerTo());
       }
 
-      result_ = Builder.CreateLoad(ptr, is_volatile_);
+      result_ = Builder->CreateLoad(ptr, is_volatile_);
       result_ = GetBitField(result_, size, bit_field_width, bit_field_begin);
 
-      value = Builder.CreateShl(value, bit_field_begin);
-      value = CastTo(value, Builder.getInt32Ty(),
+      value = Builder->CreateShl(value, bit_field_begin);
+      value = CastTo(value, Builder->getInt32Ty(),
                      item.GetExpr()->GetType()->IsUnsigned());
-      value = Builder.CreateOr(result_, value);
+      value = Builder->CreateOr(result_, value);
+      result_ = Builder->CreateStore(value, ptr, is_volatile_);
+    } else if (member_type) {
+      result_ = EmitStore(value, ptr, member_type, is_volatile_, through_union);
+    } else {
+      result_ = Builder->CreateStore(value, ptr, is_volatile_);
     }
-
-    result_ = Builder.CreateStore(value, ptr, is_volatile_);
   }
 
   is_volatile_ = false;
 }
 
 void CodeGen::StartFunction(const FuncDef* node) {
-  node->GetIdent()->Accept(*this);
-  func_ = llvm::cast<llvm::Function>(result_);
-
   auto func_name{node->GetName()};
   auto func_type{node->GetFuncType()};
 
+  auto linkage{llvm::Function::ExternalLinkage};
+  if (node->GetLinkage() == Linkage::kInternal) {
+    linkage = llvm::Function::InternalLinkage;
+  } else if (IsInlineDefinition(node)) {
+    linkage = llvm::Function::AvailableExternallyLinkage;
+  }
+
+  func_abi_ = &GetABIFuncInfo(func_type);
+  func_ = GetOrCreateFunction(func_name, func_type, linkage);
+  // 被引用时创建的声明使用外部链接
+  func_->setLinkage(linkage);
+
   if (node->GetLinkage() != Linkage::kInternal) {
     func_->setDSOLocal(true);
   }
@@ -565,27 +1038,37 @@ void CodeGen::StartFunction(const FuncDef* node) {
   func_->addFnAttr(llvm::Attribute::StackProtectStrong);
   func_->addFnAttr(llvm::Attribute::UWTable);
 
-  if (OptimizationLevel == OptLevel::kO0) {
+  AddGNUAttributes(func_, func_type, true);
+  is_flatten_ = func_type->FuncGetAttrs().attr_spec & kAttrFlatten;
+
+  // 与 clang 相同, always_inline 的函数不能有 optnone, -O0 时由
+  // AlwaysInlinerPass 内联
+  if (OptimizationLevel == OptLevel::kO0 &&
+      !func_->hasFnAttribute(llvm::Attribute::AlwaysInline)) {
     func_->addFnAttr(llvm::Attribute::NoInline);
     func_->addFnAttr(llvm::Attribute::OptimizeNone);
   }
 
   auto entry{CreateBasicBlock("entry", func_)};
 
-  auto undef{llvm::UndefValue::get(Builder.getInt32Ty())};
+  auto undef{llvm::UndefValue::get(Builder->getInt32Ty())};
   alloc_insert_point_ =
-      new llvm::BitCastInst{undef, Builder.getInt32Ty(), "", entry};
+      new llvm::BitCastInst{undef, Builder->getInt32Ty(), "", entry};
 
   return_block_ = CreateBasicBlock("return");
   return_value_ = nullptr;
 
   auto return_type{func_type->FuncGetReturnType()};
-  if (!return_type->IsVoidTy()) {
+  if (func_abi_->ret.kind == ABIArgInfo::kIndirect) {
+    // 直接写入调用者提供的内存
+    return_value_ = func_->arg_begin();
+    return_value_->setName("agg.result");
+  } else if (!return_type->IsVoidTy()) {
     return_value_ = CreateEntryBlockAlloca(return_type->GetLLVMType(),
                                            return_type->GetAlign(), "ret.val");
   }
 
-  Builder.SetInsertPoint(entry);
+  Builder->SetInsertPoint(entry);
 }
 
 void CodeGen::FinishFunction(const FuncDef* node) {
@@ -599,13 +1082,15 @@ void CodeGen::FinishFunction(const FuncDef* node) {
   ptr->eraseFromParent();
 
   labels_.clear();
+  restrict_scopes_.clear();
+  alias_domain_ = nullptr;
 
   // 验证生成的代码, 检查一致性
   llvm::verifyFunction(*func);
 }
 
 void CodeGen::EmitReturnBlock() {
-  auto bb{Builder.GetInsertBlock()};
+  auto bb{Builder->GetInsertBlock()};
 
   if (bb) {
     assert(!bb->getTerminator());
@@ -625,16 +1110,57 @@ void CodeGen::EmitReturnBlock() {
 }
 
 void CodeGen::EmitFunctionEpilog() {
-  llvm::Value* value{};
+  if (!return_value_) {
+    Builder->CreateRetVoid();
+    return;
+  }
+
+  switch (func_abi_->ret.kind) {
+    case ABIArgInfo::kDirect:
+      Builder->CreateRet(Builder->CreateLoad(return_value_));
+      break;
+    case ABIArgInfo::kCoerce: {
+      std::vector<llvm::Value*> values;
+      CreateCoercedLoad(return_value_, func_abi_->ret, values);
+
+      if (std::size(values) == 1) {
+        Builder->CreateRet(values.front());
+      } else {
+        Builder->CreateAggregateRet(std::data(values), std::size(values));
+      }
+    } break;
+    case ABIArgInfo::kIndirect:
+    case ABIArgInfo::kIgnore:
+      Builder->CreateRetVoid();
+      break;
+  }
+}
 
-  if (return_value_) {
-    value = Builder.CreateLoad(return_value_);
+// 每个 eightbyte 位于结构体中 8 字节的倍数处
+void CodeGen::CreateCoercedLoad(llvm::Value* ptr, const ABIArgInfo& info,
+                                std::vector<llvm::Value*>& values) {
+  ptr = Builder->CreateBitCast(ptr, Builder->getInt8PtrTy());
+
+  for (std::uint32_t i{}; i < std::size(info.coerce_types); ++i) {
+    auto type{info.coerce_types[i]};
+    auto part{Builder->CreateBitCast(
+        Builder->CreateConstInBoundsGEP1_64(ptr, 8 * i), type->getPointerTo())};
+    values.push_back(
+        Builder->CreateAlignedLoad(part, llvm::MinAlign(info.align, 8 * i)));
   }
+}
 
-  if (value) {
-    Builder.CreateRet(value);
-  } else {
-    Builder.CreateRetVoid();
+void CodeGen::CreateCoercedStore(llvm::Value* ptr, const ABIArgInfo& info,
+                                 llvm::ArrayRef<llvm::Value*> values) {
+  assert(std::size(values) == std::size(info.coerce_types));
+  ptr = Builder->CreateBitCast(ptr, Builder->getInt8PtrTy());
+
+  for (std::uint32_t i{}; i < std::size(values); ++i) {
+    auto part{Builder->CreateBitCast(
+        Builder->CreateConstInBoundsGEP1_64(ptr, 8 * i),
+        values[i]->getType()->getPointerTo())};
+    Builder->CreateAlignedStore(values[i], part,
+                                llvm::MinAlign(info.align, 8 * i));
   }
 }
 
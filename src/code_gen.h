@@ -4,20 +4,27 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <stack>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include <llvm/ADT/ArrayRef.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Instruction.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/Metadata.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
 #include <llvm/IR/ValueHandle.h>
 
+#include "abi.h"
 #include "ast.h"
 #include "debug_info.h"
 #include "visitor.h"
@@ -35,7 +42,13 @@ namespace kcc {
 
 class CodeGen : public Visitor {
  public:
+  CodeGen();
+
   void GenCode(const TranslationUnit *root);
+  // 流式编译时逐个生成外部声明, 全部完成后调用 Finish
+  // 函数被推迟生成时接管 body_ctx 中函数体的 AST
+  void GenCode(const ExtDecl *node, AstContext *body_ctx = nullptr);
+  void Finish();
 
  private:
   struct BreakContinue {
@@ -47,6 +60,12 @@ class CodeGen : public Visitor {
     llvm::BasicBlock *continue_block;
   };
 
+  struct DeferredFunc {
+    const FuncDef *func_def;
+    // 函数体的 AST, 生成或丢弃函数后释放
+    std::unique_ptr<AstContext> body;
+  };
+
   static llvm::BasicBlock *CreateBasicBlock(const std::string &name = "",
                                             llvm::Function *parent = nullptr);
   void EmitBlock(llvm::BasicBlock *bb, bool is_finished = false);
@@ -56,6 +75,7 @@ class CodeGen : public Visitor {
   llvm::Value *EvaluateExprAsBool(const Expr *expr);
   void EmitBranchOnBoolExpr(const Expr *expr, llvm::BasicBlock *true_block,
                             llvm::BasicBlock *false_block);
+  static llvm::MDNode *GetBranchWeights(const Expr *cond);
   static void SimplifyForwardingBlocks(llvm::BasicBlock *bb);
   void EmitStmt(const Stmt *stmt);
   bool EmitSimpleStmt(const Stmt *stmt);
@@ -63,9 +83,32 @@ class CodeGen : public Visitor {
   void EmitBranchThroughCleanup(llvm::BasicBlock *dest);
   llvm::BasicBlock *GetBasicBlockForLabel(const LabelStmt *label);
   static bool IsCheapEnoughToEvaluateUnconditionally(const Expr *expr);
+  void RecordFuncDecl(const IdentifierExpr *ident);
+  bool IsInlineDefinition(const FuncDef *node) const;
+  bool IsDeferrable(const FuncDef *node) const;
+  static bool IsReferenced(const std::string &name);
+  void EmitReferencedFuncs();
+  void ReleaseDeferredFunc(DeferredFunc &item);
+  void EmitDeferredFuncs();
+  bool TryEmitConstant(const Expr *expr);
   llvm::AllocaInst *CreateEntryBlockAlloca(llvm::Type *type, std::int32_t align,
                                            const std::string &name);
   llvm::Value *GetPtr(const AstNode *node);
+  static bool IsAccessThroughUnion(const Expr *expr);
+  // 附加 TBAA 元数据和类型的对齐, may_alias 时不使用严格别名规则
+  static llvm::LoadInst *EmitLoad(llvm::Value *ptr, const Type *type,
+                                  bool is_volatile, bool may_alias = false);
+  static llvm::StoreInst *EmitStore(llvm::Value *value, llvm::Value *ptr,
+                                    const Type *type, bool is_volatile,
+                                    bool may_alias = false);
+  // 通过左值访问, 还会附加 restrict 对应的 alias.scope 和 noalias 元数据
+  llvm::LoadInst *EmitLoad(llvm::Value *ptr, const Expr *lvalue,
+                           bool is_volatile);
+  llvm::StoreInst *EmitStore(llvm::Value *value, llvm::Value *ptr,
+                             const Expr *lvalue, bool is_volatile);
+  static const ObjectExpr *GetRestrictBase(const Expr *lvalue);
+  void AddRestrict(const ObjectExpr *obj);
+  void AddRestrictMetadata(llvm::Instruction *inst, const Expr *lvalue);
   void PushBlock(llvm::BasicBlock *break_stack,
                  llvm::BasicBlock *continue_block);
   void PopBlock();
@@ -76,7 +119,7 @@ class CodeGen : public Visitor {
   void TryEmitFuncStart(const FuncDef *node);
   void TryEmitFuncEnd();
   void TryEmitParamVar(const std::string &name, Type *type,
-                       llvm::AllocaInst *ptr, const Location &loc);
+                       llvm::Value *ptr, SourceLocation loc);
   void TryEmitLocalVar(const Declaration *node);
   void TryEmitGlobalVar(const Declaration *node);
 
@@ -146,7 +189,8 @@ class CodeGen : public Visitor {
   llvm::Value *LogicAndOp(const BinaryOpExpr *node);
   llvm::Value *AssignOp(const BinaryOpExpr *node);
   llvm::Value *MemberRef(const BinaryOpExpr *node);
-  llvm::Value *Assign(llvm::Value *lhs_ptr, llvm::Value *rhs, bool is_unsigned);
+  llvm::Value *Assign(const Expr *lhs, llvm::Value *lhs_ptr, llvm::Value *rhs,
+                      bool is_unsigned);
 
   bool MayCallBuiltinFunc(const FuncCallExpr *node);
   llvm::Value *VaStart(Expr *arg);
@@ -160,10 +204,22 @@ class CodeGen : public Visitor {
   llvm::Value *Ctz(Expr *arg);
   llvm::Value *IsInfSign(Expr *arg);
   llvm::Value *IsFinite(Expr *arg);
+  llvm::Value *ByteSwap(Expr *arg);
+  llvm::Value *Prefetch(const ArenaVector<Expr *> &args);
+  llvm::Value *AssumeAligned(const ArenaVector<Expr *> &args);
+  llvm::Value *Unreachable();
+  llvm::Value *MemCpy(Expr *dst, Expr *src, Expr *size);
+  llvm::Value *MemSet(Expr *dst, Expr *value, Expr *size);
+  llvm::Value *ConstantP(Expr *arg);
 
   void DealLocaleDecl(const Declaration *node);
   void InitLocalAggregate(const Declaration *node);
 
+  static void CreateCoercedLoad(llvm::Value *ptr, const ABIArgInfo &info,
+                                std::vector<llvm::Value *> &values);
+  static void CreateCoercedStore(llvm::Value *ptr, const ABIArgInfo &info,
+                                 llvm::ArrayRef<llvm::Value *> values);
+
   void StartFunction(const FuncDef *node);
   void FinishFunction(const FuncDef *node);
   void EmitFunctionEpilog();
@@ -179,6 +235,9 @@ class CodeGen : public Visitor {
   llvm::SwitchInst *switch_inst_{};
 
   llvm::Function *func_{};
+  const ABIFuncInfo *func_abi_{};
+  // 当前函数有 __attribute__((flatten))
+  bool is_flatten_{};
   llvm::BasicBlock *return_block_{};
   llvm::Value *return_value_{};
 
@@ -189,6 +248,30 @@ class CodeGen : public Visitor {
   bool ignore_assign_result_{false};
 
   std::unique_ptr<DebugInfo> debug_info_;
+
+  // 函数最外层块中 restrict 限定的局部变量, 基于不同指针的访问不会重叠
+  struct RestrictScope {
+    const ObjectExpr *obj;
+    llvm::MDNode *scope;
+  };
+  std::vector<RestrictScope> restrict_scopes_;
+  llvm::MDNode *alias_domain_{};
+  std::int32_t block_depth_{};
+
+  // 文件作用域的声明可能被之后的声明补全, 留到最后生成
+  std::vector<const ExtDecl *> global_decls_;
+  // 具有内部链接的函数定义或内联定义, 第一次被引用后生成. 从未被引用的
+  // 函数的 AST 要保留到翻译单元结束, 这部分内存记录在 -print-stats 中
+  std::vector<DeferredFunc> deferred_funcs_;
+  std::size_t deferred_bytes_{};
+  // 存在没有 inline 或者带有 extern 的声明, 其定义是外部定义
+  std::unordered_set<std::string> external_funcs_;
 };
 
+// 所有翻译单元中因没有被引用而跳过的函数定义的个数
+inline std::atomic<std::uint64_t> SkippedFuncCount;
+// 当前翻译单元中同时保留的推迟生成的函数体所占内存 (包括块中未使用的部分)
+// 的峰值
+inline thread_local std::size_t DeferredBodyPeakBytes;
+
 }  // namespace kcc
@@ -11,14 +11,21 @@
 #include <llvm/IR/CFG.h>
 #include <llvm/IR/Constant.h>
 #include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/Support/Casting.h>
 
 #include "calc.h"
+#include "error.h"
 #include "llvm_common.h"
+#include "util.h"
 
 namespace kcc {
 
 void CodeGen::Visit(const UnaryOpExpr* node) {
+  if (TryEmitConstant(node)) {
+    return;
+  }
+
   auto is_unsigned{node->GetExpr()->GetType()->IsUnsigned()};
 
   switch (node->GetOp()) {
@@ -45,7 +52,7 @@ void CodeGen::Visit(const UnaryOpExpr* node) {
     case Tag::kTilde:
       node->GetExpr()->Accept(*this);
       TryEmitLocation(node);
-      result_ = Builder.CreateNot(result_);
+      result_ = Builder->CreateNot(result_);
       break;
     case Tag::kExclaim:
       node->GetExpr()->Accept(*this);
@@ -64,6 +71,10 @@ void CodeGen::Visit(const UnaryOpExpr* node) {
 }
 
 void CodeGen::Visit(const TypeCastExpr* node) {
+  if (TryEmitConstant(node)) {
+    return;
+  }
+
   node->GetExpr()->Accept(*this);
   TryEmitLocation(node);
   result_ = CastTo(result_, node->GetCastToType()->GetLLVMType(),
@@ -71,6 +82,10 @@ void CodeGen::Visit(const TypeCastExpr* node) {
 }
 
 void CodeGen::Visit(const BinaryOpExpr* node) {
+  if (TryEmitConstant(node)) {
+    return;
+  }
+
   switch (node->GetOp()) {
     case Tag::kPipePipe:
       result_ = LogicOrOp(node);
@@ -155,6 +170,10 @@ void CodeGen::Visit(const BinaryOpExpr* node) {
 }
 
 void CodeGen::Visit(const ConditionOpExpr* node) {
+  if (TryEmitConstant(node)) {
+    return;
+  }
+
   if (auto cond{CalcConstantExpr{}.Calc(node->GetCond())}) {
     TryEmitLocation(node);
     auto live{node->GetLHS()}, dead{node->GetRHS()};
@@ -174,7 +193,7 @@ void CodeGen::Visit(const ConditionOpExpr* node) {
     auto lhs{result_};
     node->GetRHS()->Accept(*this);
     TryEmitLocation(node);
-    result_ = Builder.CreateSelect(cond, lhs, result_);
+    result_ = Builder->CreateSelect(cond, lhs, result_);
     return;
   }
 
@@ -187,13 +206,13 @@ void CodeGen::Visit(const ConditionOpExpr* node) {
   EmitBlock(lhs_block);
   node->GetLHS()->Accept(*this);
   auto lhs{result_};
-  lhs_block = Builder.GetInsertBlock();
+  lhs_block = Builder->GetInsertBlock();
   EmitBranch(end_block);
 
   EmitBlock(rhs_block);
   node->GetRHS()->Accept(*this);
   auto rhs{result_};
-  rhs_block = Builder.GetInsertBlock();
+  rhs_block = Builder->GetInsertBlock();
   EmitBranch(end_block);
 
   EmitBlock(end_block);
@@ -206,32 +225,116 @@ void CodeGen::Visit(const ConditionOpExpr* node) {
 
   TryEmitLocation(node);
 
-  auto phi{Builder.CreatePHI(lhs->getType(), 2)};
+  auto phi{Builder->CreatePHI(lhs->getType(), 2)};
   phi->addIncoming(lhs, lhs_block);
   phi->addIncoming(rhs, rhs_block);
 
   result_ = phi;
 }
 
-// LLVM 默认使用本机 C 调用约定
+// LLVM 默认使用本机 C 调用约定, 结构体和联合体按照 x86-64 System V ABI
+// 拆分到寄存器中或者通过内存传递
 void CodeGen::Visit(const FuncCallExpr* node) {
   if (MayCallBuiltinFunc(node)) {
     return;
   }
 
+  auto load_struct{load_struct_};
+  load_struct_ = false;
+
+  const auto& abi{GetABIFuncInfo(node->GetFuncType())};
+  auto free_int_regs{abi.free_int_regs};
+  auto free_sse_regs{abi.free_sse_regs};
+
   node->GetCallee()->Accept(*this);
-  auto callee{result_};
+  auto callee{Builder->CreateBitCast(result_, abi.llvm_type->getPointerTo())};
 
   std::vector<llvm::Value*> args;
-  Load_Struct_Obj();
+  llvm::Value* ret_ptr{};
+  if (abi.ret.kind == ABIArgInfo::kIndirect) {
+    ret_ptr = CreateEntryBlockAlloca(abi.ret.type, abi.ret.align, "agg.tmp");
+    args.push_back(ret_ptr);
+  }
+
+  std::vector<ABIArgInfo> var_args;
+  auto param_iter{std::begin(abi.params)};
   for (const auto& item : node->GetArgs()) {
+    const ABIArgInfo* info{};
+    if (param_iter != std::end(abi.params)) {
+      info = &*param_iter++;
+    } else {
+      var_args.push_back(
+          ClassifyArg(item->GetType(), free_int_regs, free_sse_regs));
+      info = &var_args.back();
+    }
+
     item->Accept(*this);
-    args.push_back(result_);
+    if (info->kind == ABIArgInfo::kDirect) {
+      args.push_back(result_);
+      continue;
+    }
+
+    // 结构体的值 (e.g. 赋值表达式的结果) 需要先保存到内存中
+    auto ptr{result_};
+    if (!ptr->getType()->isPointerTy()) {
+      ptr = CreateEntryBlockAlloca(info->type, info->align, "agg.tmp");
+      Builder->CreateStore(result_, ptr);
+    }
+
+    if (info->kind == ABIArgInfo::kCoerce) {
+      CreateCoercedLoad(ptr, *info, args);
+    } else if (info->kind == ABIArgInfo::kIndirect) {
+      // byval 由调用者复制一份
+      args.push_back(Builder->CreateBitCast(ptr, info->type->getPointerTo()));
+    }
   }
-  Finish_Load();
 
   TryEmitLocation(node);
-  result_ = Builder.CreateCall(callee, args);
+  auto call{Builder->CreateCall(abi.llvm_type, callee, args)};
+  AddABIAttributes(call, abi, var_args);
+
+  // flatten 的函数中的调用都尽可能内联
+  if (is_flatten_) {
+    if (auto func{llvm::dyn_cast<llvm::Function>(callee->stripPointerCasts())};
+        func && !func->hasFnAttribute(llvm::Attribute::NoInline)) {
+      call->addAttribute(llvm::AttributeList::FunctionIndex,
+                         llvm::Attribute::AlwaysInline);
+    }
+  }
+
+  load_struct_ = load_struct;
+
+  llvm::Value* ptr{ret_ptr};
+  switch (abi.ret.kind) {
+    case ABIArgInfo::kDirect:
+      result_ = call;
+      return;
+    case ABIArgInfo::kCoerce: {
+      ptr = CreateEntryBlockAlloca(abi.ret.type, abi.ret.align, "coerce");
+
+      std::vector<llvm::Value*> values;
+      if (std::size(abi.ret.coerce_types) == 1) {
+        values.push_back(call);
+      } else {
+        for (std::uint32_t i{}; i < std::size(abi.ret.coerce_types); ++i) {
+          values.push_back(Builder->CreateExtractValue(call, i));
+        }
+      }
+      CreateCoercedStore(ptr, abi.ret, values);
+    } break;
+    case ABIArgInfo::kIndirect:
+      break;
+    case ABIArgInfo::kIgnore:
+      ptr = CreateEntryBlockAlloca(abi.ret.type, abi.ret.align, "agg.tmp");
+      break;
+  }
+
+  // 和对象一样, 只在需要时加载整个结构体
+  if (load_struct_) {
+    result_ = Builder->CreateLoad(ptr);
+  } else {
+    result_ = ptr;
+  }
 }
 
 // 常量用 ConstantFP / ConstantInt 类表示
@@ -242,7 +345,7 @@ void CodeGen::Visit(const ConstantExpr* node) {
   auto type{node->GetType()->GetLLVMType()};
 
   if (type->isIntegerTy()) {
-    result_ = llvm::ConstantInt::get(Context, node->GetIntegerVal());
+    result_ = llvm::ConstantInt::get(*Context, node->GetIntegerVal());
   } else if (type->isFloatingPointTy()) {
     result_ = llvm::ConstantFP::get(type, node->GetFloatPointVal());
   } else {
@@ -264,22 +367,18 @@ void CodeGen::Visit(const IdentifierExpr* node) {
 
   auto name{node->GetName()};
 
-  auto func{Module->getFunction(name)};
-  if (!func) {
-    func = llvm::Function::Create(
-        llvm::cast<llvm::FunctionType>(type->GetLLVMType()),
-        node->GetLinkage() == Linkage::kInternal
-            ? llvm::Function::InternalLinkage
-            : llvm::Function::ExternalLinkage,
-        name, Module.get());
-  }
+  auto func{GetOrCreateFunction(name, type,
+                                 node->GetLinkage() == Linkage::kInternal
+                                     ? llvm::Function::InternalLinkage
+                                     : llvm::Function::ExternalLinkage)};
 
-  result_ = func;
+  // 函数的实际类型是降级之后的, 其他地方使用的是 C 语言中的类型
+  result_ = Builder->CreateBitCast(func, type->GetLLVMType()->getPointerTo());
 }
 
 void CodeGen::Visit(const EnumeratorExpr* node) {
   TryEmitLocation(node);
-  result_ = llvm::ConstantInt::get(Builder.getInt32Ty(), node->GetVal());
+  result_ = llvm::ConstantInt::get(Builder->getInt32Ty(), node->GetVal());
 }
 
 void CodeGen::Visit(const ObjectExpr* node) {
@@ -296,7 +395,9 @@ void CodeGen::Visit(const ObjectExpr* node) {
   if (type->IsArrayTy() || (type->IsStructOrUnionTy() && !load_struct_)) {
     result_ = ptr;
   } else {
-    result_ = Builder.CreateLoad(ptr, is_volatile_);
+    auto load{EmitLoad(ptr, type, is_volatile_)};
+    load->setAlignment(node->GetAlign());
+    result_ = load;
     is_volatile_ = false;
   }
 }
@@ -311,7 +412,12 @@ llvm::Value* CodeGen::IncOrDec(const Expr* expr, bool is_inc, bool is_postfix) {
   auto lhs_ptr{GetPtr(expr)};
 
   TryEmitLocation(expr);
-  llvm::Value* lhs_value{Builder.CreateLoad(lhs_ptr, is_volatile_)};
+  llvm::Value* lhs_value{};
+  if (is_bit_field_) {
+    lhs_value = Builder->CreateLoad(lhs_ptr, is_volatile_);
+  } else {
+    lhs_value = EmitLoad(lhs_ptr, expr, is_volatile_);
+  }
 
   if (is_bit_field_) {
     auto size{bit_field_->GetType()->IsCharacterTy() ? 8 : 32};
@@ -331,7 +437,7 @@ llvm::Value* CodeGen::IncOrDec(const Expr* expr, bool is_inc, bool is_postfix) {
   } else if (type->isFloatingPointTy()) {
     one_value = llvm::ConstantFP::get(type, 1.0);
   } else if (type->isPointerTy()) {
-    one_value = Builder.getInt64(1);
+    one_value = Builder->getInt64(1);
   } else {
     assert(false);
   }
@@ -342,7 +448,7 @@ llvm::Value* CodeGen::IncOrDec(const Expr* expr, bool is_inc, bool is_postfix) {
     rhs_value = AddOp(lhs_value, NegOp(one_value, false), is_unsigned);
   }
 
-  Assign(lhs_ptr, rhs_value, is_unsigned);
+  Assign(expr, lhs_ptr, rhs_value, is_unsigned);
 
   return is_postfix ? lhs_value : rhs_value;
 }
@@ -350,12 +456,12 @@ llvm::Value* CodeGen::IncOrDec(const Expr* expr, bool is_inc, bool is_postfix) {
 llvm::Value* CodeGen::NegOp(llvm::Value* value, bool is_unsigned) {
   if (IsIntegerTy(value)) {
     if (is_unsigned) {
-      return Builder.CreateNeg(value);
+      return Builder->CreateNeg(value);
     } else {
-      return Builder.CreateNSWNeg(value);
+      return Builder->CreateNSWNeg(value);
     }
   } else if (IsFloatingPointTy(value)) {
-    return Builder.CreateFNeg(value);
+    return Builder->CreateFNeg(value);
   } else {
     assert(false);
     return nullptr;
@@ -363,8 +469,8 @@ llvm::Value* CodeGen::NegOp(llvm::Value* value, bool is_unsigned) {
 }
 
 llvm::Value* CodeGen::LogicNotOp(llvm::Value* value) {
-  result_ = Builder.CreateNot(CastToBool(value));
-  return Builder.CreateZExt(result_, Builder.getInt32Ty());
+  result_ = Builder->CreateNot(CastToBool(value));
+  return Builder->CreateZExt(result_, Builder->getInt32Ty());
 }
 
 llvm::Value* CodeGen::Deref(const UnaryOpExpr* node) {
@@ -377,10 +483,11 @@ llvm::Value* CodeGen::Deref(const UnaryOpExpr* node) {
     TryEmitLocation(node);
 
     if (IsArrayPointer(lhs->getType())) {
-      result_ = Builder.CreateInBoundsGEP(lhs, {result_, Builder.getInt64(0)});
+      result_ =
+          Builder->CreateInBoundsGEP(lhs, {result_, Builder->getInt64(0)});
     } else {
-      result_ = Builder.CreateInBoundsGEP(lhs, {result_});
-      result_ = Builder.CreateLoad(result_, is_volatile_);
+      result_ = Builder->CreateInBoundsGEP(lhs, {result_});
+      result_ = EmitLoad(result_, node, is_volatile_);
       is_volatile_ = false;
     }
   } else if (IsFuncPointer(node->GetExpr()->GetType()->GetLLVMType())) {
@@ -390,7 +497,7 @@ llvm::Value* CodeGen::Deref(const UnaryOpExpr* node) {
     node->GetExpr()->Accept(*this);
     TryEmitLocation(node);
     if (!node->GetType()->IsArrayTy()) {
-      result_ = Builder.CreateLoad(result_, is_volatile_);
+      result_ = EmitLoad(result_, node, is_volatile_);
     }
     is_volatile_ = false;
   }
@@ -402,15 +509,15 @@ llvm::Value* CodeGen::AddOp(llvm::Value* lhs, llvm::Value* rhs,
                             bool is_unsigned) {
   if (IsIntegerTy(lhs)) {
     if (is_unsigned) {
-      return Builder.CreateAdd(lhs, rhs);
+      return Builder->CreateAdd(lhs, rhs);
     } else {
-      return Builder.CreateNSWAdd(lhs, rhs);
+      return Builder->CreateNSWAdd(lhs, rhs);
     }
   } else if (IsFloatingPointTy(lhs)) {
-    return Builder.CreateFAdd(lhs, rhs);
+    return Builder->CreateFAdd(lhs, rhs);
   } else if (IsPointerTy(lhs)) {
     // 进行地址计算, 第二个参数是偏移量列表
-    return Builder.CreateInBoundsGEP(lhs, {rhs});
+    return Builder->CreateInBoundsGEP(lhs, {rhs});
   } else {
     assert(false);
     return nullptr;
@@ -421,23 +528,24 @@ llvm::Value* CodeGen::SubOp(llvm::Value* lhs, llvm::Value* rhs,
                             bool is_unsigned) {
   if (IsIntegerTy(lhs)) {
     if (is_unsigned) {
-      return Builder.CreateSub(lhs, rhs);
+      return Builder->CreateSub(lhs, rhs);
     } else {
-      return Builder.CreateNSWSub(lhs, rhs);
+      return Builder->CreateNSWSub(lhs, rhs);
     }
   } else if (IsFloatingPointTy(lhs)) {
-    return Builder.CreateFSub(lhs, rhs);
+    return Builder->CreateFSub(lhs, rhs);
   } else if (IsPointerTy(lhs) && IsIntegerTy(rhs)) {
-    return Builder.CreateInBoundsGEP(lhs, {Builder.CreateNeg(rhs)});
+    return Builder->CreateInBoundsGEP(lhs, {Builder->CreateNeg(rhs)});
   } else if (IsPointerTy(lhs) && IsPointerTy(rhs)) {
     auto type{lhs->getType()->getPointerElementType()};
 
-    lhs = CastTo(lhs, Builder.getInt64Ty(), true);
-    rhs = CastTo(rhs, Builder.getInt64Ty(), true);
+    lhs = CastTo(lhs, Builder->getInt64Ty(), true);
+    rhs = CastTo(rhs, Builder->getInt64Ty(), true);
 
     auto value{SubOp(lhs, rhs, true)};
     return DivOp(
-        value, Builder.getInt64(Module->getDataLayout().getTypeAllocSize(type)),
+        value,
+        Builder->getInt64(Module->getDataLayout().getTypeAllocSize(type)),
         true);
   } else {
     assert(false);
@@ -449,12 +557,12 @@ llvm::Value* CodeGen::MulOp(llvm::Value* lhs, llvm::Value* rhs,
                             bool is_unsigned) {
   if (IsIntegerTy(lhs)) {
     if (is_unsigned) {
-      return Builder.CreateMul(lhs, rhs);
+      return Builder->CreateMul(lhs, rhs);
     } else {
-      return Builder.CreateNSWMul(lhs, rhs);
+      return Builder->CreateNSWMul(lhs, rhs);
     }
   } else if (IsFloatingPointTy(lhs)) {
-    return Builder.CreateFMul(lhs, rhs);
+    return Builder->CreateFMul(lhs, rhs);
   } else {
     assert(false);
     return nullptr;
@@ -465,12 +573,12 @@ llvm::Value* CodeGen::DivOp(llvm::Value* lhs, llvm::Value* rhs,
                             bool is_unsigned) {
   if (IsIntegerTy(lhs)) {
     if (is_unsigned) {
-      return Builder.CreateUDiv(lhs, rhs);
+      return Builder->CreateUDiv(lhs, rhs);
     } else {
-      return Builder.CreateSDiv(lhs, rhs);
+      return Builder->CreateSDiv(lhs, rhs);
     }
   } else if (IsFloatingPointTy(lhs)) {
-    return Builder.CreateFDiv(lhs, rhs);
+    return Builder->CreateFDiv(lhs, rhs);
   } else {
     assert(false);
     return nullptr;
@@ -480,34 +588,34 @@ llvm::Value* CodeGen::DivOp(llvm::Value* lhs, llvm::Value* rhs,
 llvm::Value* CodeGen::ModOp(llvm::Value* lhs, llvm::Value* rhs,
                             bool is_unsigned) {
   if (is_unsigned) {
-    return Builder.CreateURem(lhs, rhs);
+    return Builder->CreateURem(lhs, rhs);
   } else {
-    return Builder.CreateSRem(lhs, rhs);
+    return Builder->CreateSRem(lhs, rhs);
   }
 }
 
 llvm::Value* CodeGen::OrOp(llvm::Value* lhs, llvm::Value* rhs) {
-  return Builder.CreateOr(lhs, rhs);
+  return Builder->CreateOr(lhs, rhs);
 }
 
 llvm::Value* CodeGen::AndOp(llvm::Value* lhs, llvm::Value* rhs) {
-  return Builder.CreateAnd(lhs, rhs);
+  return Builder->CreateAnd(lhs, rhs);
 }
 
 llvm::Value* CodeGen::XorOp(llvm::Value* lhs, llvm::Value* rhs) {
-  return Builder.CreateXor(lhs, rhs);
+  return Builder->CreateXor(lhs, rhs);
 }
 
 llvm::Value* CodeGen::ShlOp(llvm::Value* lhs, llvm::Value* rhs) {
-  return Builder.CreateShl(lhs, rhs);
+  return Builder->CreateShl(lhs, rhs);
 }
 
 llvm::Value* CodeGen::ShrOp(llvm::Value* lhs, llvm::Value* rhs,
                             bool is_unsigned) {
   if (is_unsigned) {
-    return Builder.CreateLShr(lhs, rhs);
+    return Builder->CreateLShr(lhs, rhs);
   } else {
-    return Builder.CreateAShr(lhs, rhs);
+    return Builder->CreateAShr(lhs, rhs);
   }
 }
 
@@ -517,20 +625,20 @@ llvm::Value* CodeGen::LessEqualOp(llvm::Value* lhs, llvm::Value* rhs,
 
   if (IsIntegerTy(lhs)) {
     if (is_unsigned) {
-      value = Builder.CreateICmpULE(lhs, rhs);
+      value = Builder->CreateICmpULE(lhs, rhs);
     } else {
-      value = Builder.CreateICmpSLE(lhs, rhs);
+      value = Builder->CreateICmpSLE(lhs, rhs);
     }
   } else if (IsFloatingPointTy(lhs)) {
-    value = Builder.CreateFCmpOLE(lhs, rhs);
+    value = Builder->CreateFCmpOLE(lhs, rhs);
   } else if (IsPointerTy(lhs)) {
-    value = Builder.CreateICmpULE(lhs, rhs);
+    value = Builder->CreateICmpULE(lhs, rhs);
   } else {
     assert(false);
     return nullptr;
   }
 
-  return Builder.CreateZExt(value, Builder.getInt32Ty());
+  return Builder->CreateZExt(value, Builder->getInt32Ty());
 }
 
 llvm::Value* CodeGen::LessOp(llvm::Value* lhs, llvm::Value* rhs,
@@ -539,20 +647,20 @@ llvm::Value* CodeGen::LessOp(llvm::Value* lhs, llvm::Value* rhs,
 
   if (IsIntegerTy(lhs)) {
     if (is_unsigned) {
-      value = Builder.CreateICmpULT(lhs, rhs);
+      value = Builder->CreateICmpULT(lhs, rhs);
     } else {
-      value = Builder.CreateICmpSLT(lhs, rhs);
+      value = Builder->CreateICmpSLT(lhs, rhs);
     }
   } else if (IsFloatingPointTy(lhs)) {
-    value = Builder.CreateFCmpOLT(lhs, rhs);
+    value = Builder->CreateFCmpOLT(lhs, rhs);
   } else if (IsPointerTy(lhs)) {
-    value = Builder.CreateICmpULT(lhs, rhs);
+    value = Builder->CreateICmpULT(lhs, rhs);
   } else {
     assert(false);
     return nullptr;
   }
 
-  return Builder.CreateZExt(value, Builder.getInt32Ty());
+  return Builder->CreateZExt(value, Builder->getInt32Ty());
 }
 
 llvm::Value* CodeGen::GreaterEqualOp(llvm::Value* lhs, llvm::Value* rhs,
@@ -561,20 +669,20 @@ llvm::Value* CodeGen::GreaterEqualOp(llvm::Value* lhs, llvm::Value* rhs,
 
   if (IsIntegerTy(lhs)) {
     if (is_unsigned) {
-      value = Builder.CreateICmpUGE(lhs, rhs);
+      value = Builder->CreateICmpUGE(lhs, rhs);
     } else {
-      value = Builder.CreateICmpSGE(lhs, rhs);
+      value = Builder->CreateICmpSGE(lhs, rhs);
     }
   } else if (IsFloatingPointTy(lhs)) {
-    value = Builder.CreateFCmpOGE(lhs, rhs);
+    value = Builder->CreateFCmpOGE(lhs, rhs);
   } else if (IsPointerTy(lhs)) {
-    value = Builder.CreateICmpUGE(lhs, rhs);
+    value = Builder->CreateICmpUGE(lhs, rhs);
   } else {
     assert(false);
     return nullptr;
   }
 
-  return Builder.CreateZExt(value, Builder.getInt32Ty());
+  return Builder->CreateZExt(value, Builder->getInt32Ty());
 }
 
 llvm::Value* CodeGen::GreaterOp(llvm::Value* lhs, llvm::Value* rhs,
@@ -583,59 +691,59 @@ llvm::Value* CodeGen::GreaterOp(llvm::Value* lhs, llvm::Value* rhs,
 
   if (IsIntegerTy(lhs)) {
     if (is_unsigned) {
-      value = Builder.CreateICmpUGT(lhs, rhs);
+      value = Builder->CreateICmpUGT(lhs, rhs);
     } else {
-      value = Builder.CreateICmpSGT(lhs, rhs);
+      value = Builder->CreateICmpSGT(lhs, rhs);
     }
   } else if (IsFloatingPointTy(lhs)) {
-    value = Builder.CreateFCmpOGT(lhs, rhs);
+    value = Builder->CreateFCmpOGT(lhs, rhs);
   } else if (IsPointerTy(lhs)) {
-    value = Builder.CreateICmpUGT(lhs, rhs);
+    value = Builder->CreateICmpUGT(lhs, rhs);
   } else {
     assert(false);
     return nullptr;
   }
 
-  return Builder.CreateZExt(value, Builder.getInt32Ty());
+  return Builder->CreateZExt(value, Builder->getInt32Ty());
 }
 
 llvm::Value* CodeGen::EqualOp(llvm::Value* lhs, llvm::Value* rhs) {
   llvm::Value* value{};
 
   if (IsIntegerTy(lhs) || IsPointerTy(lhs)) {
-    value = Builder.CreateICmpEQ(lhs, rhs);
+    value = Builder->CreateICmpEQ(lhs, rhs);
   } else if (IsFloatingPointTy(lhs)) {
-    value = Builder.CreateFCmpOEQ(lhs, rhs);
+    value = Builder->CreateFCmpOEQ(lhs, rhs);
   } else {
     assert(false);
     return nullptr;
   }
 
-  return Builder.CreateZExt(value, Builder.getInt32Ty());
+  return Builder->CreateZExt(value, Builder->getInt32Ty());
 }
 
 llvm::Value* CodeGen::NotEqualOp(llvm::Value* lhs, llvm::Value* rhs) {
   llvm::Value* value{};
 
   if (IsIntegerTy(lhs) || IsPointerTy(lhs)) {
-    value = Builder.CreateICmpNE(lhs, rhs);
+    value = Builder->CreateICmpNE(lhs, rhs);
   } else if (IsFloatingPointTy(lhs)) {
-    value = Builder.CreateFCmpONE(lhs, rhs);
+    value = Builder->CreateFCmpONE(lhs, rhs);
   } else {
     assert(false);
     return nullptr;
   }
 
-  return Builder.CreateZExt(value, Builder.getInt32Ty());
+  return Builder->CreateZExt(value, Builder->getInt32Ty());
 }
 
 llvm::Value* CodeGen::LogicOrOp(const BinaryOpExpr* node) {
   if (auto lhs{CalcConstantExpr{}.Calc(node->GetLHS())}) {
     if (lhs->isZeroValue()) {
       auto rhs{EvaluateExprAsBool(node->GetRHS())};
-      return Builder.CreateZExt(rhs, Builder.getInt32Ty());
+      return Builder->CreateZExt(rhs, Builder->getInt32Ty());
     } else {
-      return Builder.getInt32(1);
+      return Builder->getInt32(1);
     }
   }
 
@@ -643,32 +751,32 @@ llvm::Value* CodeGen::LogicOrOp(const BinaryOpExpr* node) {
   auto end_block{CreateBasicBlock("logic.or.end")};
 
   EmitBranchOnBoolExpr(node->GetLHS(), end_block, rhs_block);
-  auto phi{llvm::PHINode::Create(Builder.getInt1Ty(), 2, "", end_block)};
+  auto phi{llvm::PHINode::Create(Builder->getInt1Ty(), 2, "", end_block)};
 
   // llvm::predecessors 获取 basic block 的所有前驱
   for (const auto& item : llvm::predecessors(end_block)) {
-    phi->addIncoming(Builder.getTrue(), item);
+    phi->addIncoming(Builder->getTrue(), item);
   }
 
   EmitBlock(rhs_block);
   auto rhs_value{EvaluateExprAsBool(node->GetRHS())};
 
-  rhs_block = Builder.GetInsertBlock();
+  rhs_block = Builder->GetInsertBlock();
   EmitBlock(end_block);
 
   TryEmitLocation(node);
   phi->addIncoming(rhs_value, rhs_block);
 
-  return Builder.CreateZExt(phi, Builder.getInt32Ty());
+  return Builder->CreateZExt(phi, Builder->getInt32Ty());
 }
 
 llvm::Value* CodeGen::LogicAndOp(const BinaryOpExpr* node) {
   if (auto lhs{CalcConstantExpr{}.Calc(node->GetLHS())}) {
     if (lhs->isOneValue()) {
       auto rhs{EvaluateExprAsBool(node->GetRHS())};
-      return Builder.CreateZExt(rhs, Builder.getInt32Ty());
+      return Builder->CreateZExt(rhs, Builder->getInt32Ty());
     } else {
-      return Builder.getInt32(0);
+      return Builder->getInt32(0);
     }
   }
 
@@ -676,23 +784,23 @@ llvm::Value* CodeGen::LogicAndOp(const BinaryOpExpr* node) {
   auto end_block{CreateBasicBlock("logic.and.end")};
 
   EmitBranchOnBoolExpr(node->GetLHS(), rhs_block, end_block);
-  auto phi{llvm::PHINode::Create(Builder.getInt1Ty(), 2, "", end_block)};
+  auto phi{llvm::PHINode::Create(Builder->getInt1Ty(), 2, "", end_block)};
 
   for (const auto& item : llvm::predecessors(end_block)) {
-    phi->addIncoming(Builder.getFalse(), item);
+    phi->addIncoming(Builder->getFalse(), item);
   }
 
   EmitBlock(rhs_block);
   auto rhs_value{EvaluateExprAsBool(node->GetRHS())};
 
-  rhs_block = Builder.GetInsertBlock();
+  rhs_block = Builder->GetInsertBlock();
 
   EmitBlock(end_block);
 
   TryEmitLocation(node);
   phi->addIncoming(rhs_value, rhs_block);
 
-  return Builder.CreateZExt(phi, Builder.getInt32Ty());
+  return Builder->CreateZExt(phi, Builder->getInt32Ty());
 }
 
 llvm::Value* CodeGen::AssignOp(const BinaryOpExpr* node) {
@@ -704,7 +812,8 @@ llvm::Value* CodeGen::AssignOp(const BinaryOpExpr* node) {
   auto lhs_ptr{GetPtr(node->GetLHS())};
   TryEmitLocation(node);
 
-  return Assign(lhs_ptr, rhs, node->GetRHS()->GetType()->IsUnsigned());
+  return Assign(node->GetLHS(), lhs_ptr, rhs,
+                node->GetRHS()->GetType()->IsUnsigned());
 }
 
 llvm::Value* CodeGen::MemberRef(const BinaryOpExpr* node) {
@@ -713,7 +822,7 @@ llvm::Value* CodeGen::MemberRef(const BinaryOpExpr* node) {
   auto type{ptr->getType()->getPointerElementType()};
 
   if (is_bit_field_) {
-    result_ = Builder.CreateLoad(ptr, is_volatile_);
+    result_ = Builder->CreateLoad(ptr, is_volatile_);
 
     auto size{bit_field_->GetType()->IsCharacterTy() ? 8 : 32};
 
@@ -727,30 +836,30 @@ llvm::Value* CodeGen::MemberRef(const BinaryOpExpr* node) {
     if (type->isArrayTy() || (type->isStructTy() && !load_struct_)) {
       result_ = ptr;
     } else {
-      result_ = Builder.CreateLoad(ptr, is_volatile_);
+      result_ = EmitLoad(ptr, node, is_volatile_);
     }
   }
 
   return result_;
 }
 
-llvm::Value* CodeGen::Assign(llvm::Value* lhs_ptr, llvm::Value* rhs,
-                             bool is_unsigned) {
+llvm::Value* CodeGen::Assign(const Expr* lhs, llvm::Value* lhs_ptr,
+                             llvm::Value* rhs, bool is_unsigned) {
   if (is_bit_field_) {
-    result_ = Builder.CreateLoad(lhs_ptr, is_volatile_);
+    result_ = Builder->CreateLoad(lhs_ptr, is_volatile_);
 
     auto size{bit_field_->GetType()->IsCharacterTy() ? 8 : 32};
     result_ = GetBitField(result_, size, bit_field_->GetBitFieldWidth(),
                           bit_field_->GetBitFieldBegin());
 
-    rhs = Builder.CreateShl(rhs, bit_field_->GetBitFieldBegin());
-    rhs = CastTo(rhs, Builder.getInt32Ty(), is_unsigned);
-    result_ = Builder.CreateOr(result_, rhs);
+    rhs = Builder->CreateShl(rhs, bit_field_->GetBitFieldBegin());
+    rhs = CastTo(rhs, Builder->getInt32Ty(), is_unsigned);
+    result_ = Builder->CreateOr(result_, rhs);
 
-    Builder.CreateStore(result_, lhs_ptr, is_volatile_);
+    Builder->CreateStore(result_, lhs_ptr, is_volatile_);
 
     if (!TestAndClearIgnoreAssignResult()) {
-      result_ = Builder.CreateLoad(lhs_ptr, is_volatile_);
+      result_ = Builder->CreateLoad(lhs_ptr, is_volatile_);
 
       result_ = GetBitFieldValue(result_, size, bit_field_->GetBitFieldWidth(),
                                  bit_field_->GetBitFieldBegin(),
@@ -769,10 +878,10 @@ llvm::Value* CodeGen::Assign(llvm::Value* lhs_ptr, llvm::Value* rhs,
       return lhs_ptr;
     }
   } else {
-    Builder.CreateStore(rhs, lhs_ptr, is_volatile_);
+    EmitStore(rhs, lhs_ptr, lhs, is_volatile_);
 
     if (!TestAndClearIgnoreAssignResult()) {
-      result_ = Builder.CreateLoad(lhs_ptr, is_volatile_);
+      result_ = EmitLoad(lhs_ptr, lhs, is_volatile_);
       is_volatile_ = false;
       return result_;
     } else {
@@ -805,16 +914,22 @@ bool CodeGen::MayCallBuiltinFunc(const FuncCallExpr* node) {
   } else if (func_name == "__builtin_alloca") {
     result_ = Alloc(node->GetArgs().front());
     return true;
-  } else if (func_name == "__builtin_popcount") {
+  } else if (func_name == "__builtin_popcount" ||
+             func_name == "__builtin_popcountl" ||
+             func_name == "__builtin_popcountll") {
     result_ = PopCount(node->GetArgs().front());
     return true;
-  } else if (func_name == "__builtin_clz") {
+  } else if (func_name == "__builtin_clz" || func_name == "__builtin_clzl" ||
+             func_name == "__builtin_clzll") {
     result_ = Clz(node->GetArgs().front());
     return true;
-  } else if (func_name == "__builtin_ctz") {
+  } else if (func_name == "__builtin_ctz" || func_name == "__builtin_ctzl" ||
+             func_name == "__builtin_ctzll") {
     result_ = Ctz(node->GetArgs().front());
     return true;
-  } else if (func_name == "__builtin_expect") {
+  } else if (func_name == "__builtin_expect" ||
+             func_name == "__builtin_expect_with_probability") {
+    // 作为条件时在 EmitBranchOnBoolExpr 中转换为分支权重
     node->GetArgs().front()->Accept(*this);
     return true;
   } else if (func_name == "__builtin_isinf_sign") {
@@ -823,36 +938,57 @@ bool CodeGen::MayCallBuiltinFunc(const FuncCallExpr* node) {
   } else if (func_name == "__builtin_isfinite") {
     result_ = IsFinite(node->GetArgs().front());
     return true;
+  } else if (func_name == "__builtin_bswap16" ||
+             func_name == "__builtin_bswap32" ||
+             func_name == "__builtin_bswap64") {
+    result_ = ByteSwap(node->GetArgs().front());
+    return true;
+  } else if (func_name == "__builtin_prefetch") {
+    result_ = Prefetch(node->GetArgs());
+    return true;
+  } else if (func_name == "__builtin_assume_aligned") {
+    result_ = AssumeAligned(node->GetArgs());
+    return true;
+  } else if (func_name == "__builtin_unreachable") {
+    result_ = Unreachable();
+    return true;
+  } else if (func_name == "__builtin_memcpy") {
+    const auto& args{node->GetArgs()};
+    result_ = MemCpy(args[0], args[1], args[2]);
+    return true;
+  } else if (func_name == "__builtin_memset") {
+    const auto& args{node->GetArgs()};
+    result_ = MemSet(args[0], args[1], args[2]);
+    return true;
+  } else if (func_name == "__builtin_constant_p") {
+    if (std::size(node->GetArgs()) != 1) {
+      Error(node->GetLoc(), "__builtin_constant_p expects one argument");
+    }
+    result_ = ConstantP(node->GetArgs().front());
+    return true;
   } else {
     return false;
   }
 }
 
 llvm::Value* CodeGen::VaStart(Expr* arg) {
-  static auto func_type{llvm::FunctionType::get(
-      Builder.getVoidTy(), {Builder.getInt8PtrTy()}, false)};
-
-  static auto va_start{llvm::Function::Create(func_type,
-                                              llvm::Function::ExternalLinkage,
-                                              "llvm.va_start", Module.get())};
+  auto va_start{
+      llvm::Intrinsic::getDeclaration(Module.get(), llvm::Intrinsic::vastart)};
 
   arg->Accept(*this);
 
-  result_ = Builder.CreateBitCast(result_, Builder.getInt8PtrTy());
-  return Builder.CreateCall(va_start, {result_});
+  result_ = Builder->CreateBitCast(result_, Builder->getInt8PtrTy());
+  return Builder->CreateCall(va_start, {result_});
 }
 
 llvm::Value* CodeGen::VaEnd(Expr* arg) {
-  static auto func_type{llvm::FunctionType::get(
-      Builder.getVoidTy(), {Builder.getInt8PtrTy()}, false)};
-
-  static auto va_end{llvm::Function::Create(
-      func_type, llvm::Function::ExternalLinkage, "llvm.va_end", Module.get())};
+  auto va_end{
+      llvm::Intrinsic::getDeclaration(Module.get(), llvm::Intrinsic::vaend)};
 
   arg->Accept(*this);
 
-  result_ = Builder.CreateBitCast(result_, Builder.getInt8PtrTy());
-  return Builder.CreateCall(va_end, {result_});
+  result_ = Builder->CreateBitCast(result_, Builder->getInt8PtrTy());
+  return Builder->CreateCall(va_end, {result_});
 }
 
 llvm::Value* CodeGen::VaArg(Expr* arg, llvm::Type* type) {
@@ -867,51 +1003,51 @@ llvm::Value* CodeGen::VaArg(Expr* arg, llvm::Type* type) {
   auto ptr{result_};
 
   if (type->isIntegerTy() || type->isPointerTy()) {
-    offset_ptr = Builder.CreateStructGEP(ptr, 0);
-    offset = Builder.CreateLoad(offset_ptr);
-    result_ = Builder.CreateICmpULE(
-        offset, llvm::ConstantInt::get(Builder.getInt32Ty(), 40));
+    offset_ptr = Builder->CreateStructGEP(ptr, 0);
+    offset = Builder->CreateLoad(offset_ptr);
+    result_ = Builder->CreateICmpULE(
+        offset, llvm::ConstantInt::get(Builder->getInt32Ty(), 40));
   } else if (type->isFloatingPointTy()) {
-    offset_ptr = Builder.CreateStructGEP(ptr, 1);
-    offset = Builder.CreateLoad(offset_ptr);
-    result_ = Builder.CreateICmpULE(
-        offset, llvm::ConstantInt::get(Builder.getInt32Ty(), 160));
+    offset_ptr = Builder->CreateStructGEP(ptr, 1);
+    offset = Builder->CreateLoad(offset_ptr);
+    result_ = Builder->CreateICmpULE(
+        offset, llvm::ConstantInt::get(Builder->getInt32Ty(), 160));
   } else {
     assert(false);
   }
 
-  Builder.CreateCondBr(result_, lhs_block, rhs_block);
+  Builder->CreateCondBr(result_, lhs_block, rhs_block);
 
   EmitBlock(lhs_block);
-  result_ = Builder.CreateStructGEP(ptr, 3);
-  result_ = Builder.CreateLoad(result_);
-  result_ = Builder.CreateGEP(result_, offset);
-  auto result_ptr{Builder.CreateBitCast(result_, type->getPointerTo())};
+  result_ = Builder->CreateStructGEP(ptr, 3);
+  result_ = Builder->CreateLoad(result_);
+  result_ = Builder->CreateGEP(result_, offset);
+  auto result_ptr{Builder->CreateBitCast(result_, type->getPointerTo())};
 
   if (type->isIntegerTy() || type->isPointerTy()) {
-    result_ = Builder.CreateAdd(
-        offset, llvm::ConstantInt::get(Builder.getInt32Ty(), 8));
+    result_ = Builder->CreateAdd(
+        offset, llvm::ConstantInt::get(Builder->getInt32Ty(), 8));
   } else if (type->isFloatingPointTy()) {
-    result_ = Builder.CreateAdd(
-        offset, llvm::ConstantInt::get(Builder.getInt32Ty(), 16));
+    result_ = Builder->CreateAdd(
+        offset, llvm::ConstantInt::get(Builder->getInt32Ty(), 16));
   } else {
     assert(false);
   }
 
-  Builder.CreateStore(result_, offset_ptr);
+  Builder->CreateStore(result_, offset_ptr);
   EmitBranch(end_block);
 
   EmitBlock(rhs_block);
-  auto pp{Builder.CreateStructGEP(ptr, 2)};
-  result_ = Builder.CreateLoad(pp);
-  auto result_ptr2{Builder.CreateBitCast(result_, type->getPointerTo())};
-  result_ = Builder.CreateGEP(result_,
-                              llvm::ConstantInt::get(Builder.getInt32Ty(), 8));
-  Builder.CreateStore(result_, pp);
+  auto pp{Builder->CreateStructGEP(ptr, 2)};
+  result_ = Builder->CreateLoad(pp);
+  auto result_ptr2{Builder->CreateBitCast(result_, type->getPointerTo())};
+  result_ = Builder->CreateGEP(
+      result_, llvm::ConstantInt::get(Builder->getInt32Ty(), 8));
+  Builder->CreateStore(result_, pp);
   EmitBranch(end_block);
 
   EmitBlock(end_block);
-  auto phi{Builder.CreatePHI(type->getPointerTo(), 2)};
+  auto phi{Builder->CreatePHI(type->getPointerTo(), 2)};
   phi->addIncoming(result_ptr, lhs_block);
   phi->addIncoming(result_ptr2, rhs_block);
 
@@ -919,116 +1055,219 @@ llvm::Value* CodeGen::VaArg(Expr* arg, llvm::Type* type) {
 }
 
 llvm::Value* CodeGen::VaCopy(Expr* arg, Expr* arg2) {
-  static auto func_type{llvm::FunctionType::get(
-      Builder.getVoidTy(), {Builder.getInt8PtrTy(), Builder.getInt8PtrTy()},
-      false)};
-
-  static auto va_copy{llvm::Function::Create(func_type,
-                                             llvm::Function::ExternalLinkage,
-                                             "llvm.va_copy", Module.get())};
+  auto va_copy{
+      llvm::Intrinsic::getDeclaration(Module.get(), llvm::Intrinsic::vacopy)};
 
   arg->Accept(*this);
   auto param{result_};
   arg2->Accept(*this);
   auto param2{result_};
 
-  return Builder.CreateCall(
-      va_copy, {Builder.CreateBitCast(param, Builder.getInt8PtrTy()),
-                Builder.CreateBitCast(param2, Builder.getInt8PtrTy())});
+  return Builder->CreateCall(
+      va_copy, {Builder->CreateBitCast(param, Builder->getInt8PtrTy()),
+                Builder->CreateBitCast(param2, Builder->getInt8PtrTy())});
 }
 
 llvm::Value* CodeGen::SyncSynchronize() {
-  return Builder.CreateFence(llvm::AtomicOrdering::SequentiallyConsistent,
-                             llvm::SyncScope::System);
+  return Builder->CreateFence(llvm::AtomicOrdering::SequentiallyConsistent,
+                              llvm::SyncScope::System);
 }
 
 llvm::Value* CodeGen::Alloc(Expr* arg) {
   arg->Accept(*this);
-  return Builder.CreateAlloca(Builder.getInt8Ty(), result_);
+  return Builder->CreateAlloca(Builder->getInt8Ty(), result_);
 }
 
+// 参数可能是 unsigned int 或 unsigned long, 结果都是 int
 llvm::Value* CodeGen::PopCount(Expr* arg) {
-  static auto func_type{llvm::FunctionType::get(Builder.getInt32Ty(),
-                                                {Builder.getInt32Ty()}, false)};
+  arg->Accept(*this);
 
-  static auto ctpop_i32{llvm::Function::Create(func_type,
-                                               llvm::Function::ExternalLinkage,
-                                               "llvm.ctpop.i32", Module.get())};
+  auto ctpop{llvm::Intrinsic::getDeclaration(
+      Module.get(), llvm::Intrinsic::ctpop, {result_->getType()})};
+  result_ = Builder->CreateCall(ctpop, {result_});
 
-  arg->Accept(*this);
-  return Builder.CreateCall(ctpop_i32, {result_});
+  return Builder->CreateTrunc(result_, Builder->getInt32Ty());
 }
 
+// 参数为 0 时结果未定义
 llvm::Value* CodeGen::Clz(Expr* arg) {
-  static auto func_type{llvm::FunctionType::get(
-      Builder.getInt32Ty(), {Builder.getInt32Ty(), Builder.getInt1Ty()},
-      false)};
+  arg->Accept(*this);
 
-  static auto ctlz_i32{llvm::Function::Create(func_type,
-                                              llvm::Function::ExternalLinkage,
-                                              "llvm.ctlz.i32", Module.get())};
+  auto ctlz{llvm::Intrinsic::getDeclaration(
+      Module.get(), llvm::Intrinsic::ctlz, {result_->getType()})};
+  result_ = Builder->CreateCall(ctlz, {result_, Builder->getTrue()});
 
-  arg->Accept(*this);
-  return Builder.CreateCall(ctlz_i32, {result_, Builder.getTrue()});
+  return Builder->CreateTrunc(result_, Builder->getInt32Ty());
 }
 
 llvm::Value* CodeGen::Ctz(Expr* arg) {
-  static auto func_type{llvm::FunctionType::get(
-      Builder.getInt32Ty(), {Builder.getInt32Ty(), Builder.getInt1Ty()},
-      false)};
+  arg->Accept(*this);
 
-  static auto cttz_i32{llvm::Function::Create(func_type,
-                                              llvm::Function::ExternalLinkage,
-                                              "llvm.cttz.i32", Module.get())};
+  auto cttz{llvm::Intrinsic::getDeclaration(
+      Module.get(), llvm::Intrinsic::cttz, {result_->getType()})};
+  result_ = Builder->CreateCall(cttz, {result_, Builder->getTrue()});
 
-  arg->Accept(*this);
-  return Builder.CreateCall(cttz_i32, {result_, Builder.getTrue()});
+  return Builder->CreateTrunc(result_, Builder->getInt32Ty());
 }
 
 llvm::Value* CodeGen::IsInfSign(Expr* arg) {
-  static auto func_type{llvm::FunctionType::get(Builder.getFloatTy(),
-                                                {Builder.getFloatTy()}, false)};
-
-  static auto fabs_f32{llvm::Function::Create(func_type,
-                                              llvm::Function::ExternalLinkage,
-                                              "llvm.fabs.f32", Module.get())};
+  auto fabs_f32{llvm::Intrinsic::getDeclaration(
+      Module.get(), llvm::Intrinsic::fabs, {Builder->getFloatTy()})};
 
   arg->Accept(*this);
   auto load{result_};
-  result_ = Builder.CreateCall(fabs_f32, {result_});
+  result_ = Builder->CreateCall(fabs_f32, {result_});
 
-  auto mark{Builder.CreateFCmpOEQ(
+  auto mark{Builder->CreateFCmpOEQ(
       result_,
-      llvm::ConstantFP::get(
-          Builder.getFloatTy(),
-          llvm::APFloat::getInf(GetFloatTypeSemantics(Builder.getFloatTy()))))};
+      llvm::ConstantFP::get(Builder->getFloatTy(),
+                            llvm::APFloat::getInf(GetFloatTypeSemantics(
+                                Builder->getFloatTy()))))};
 
-  result_ = Builder.CreateBitCast(load, Builder.getInt32Ty());
-  result_ = Builder.CreateICmpSLT(result_, Builder.getInt32(0));
-  result_ =
-      Builder.CreateSelect(result_, Builder.getInt32(-1), Builder.getInt32(1));
+  result_ = Builder->CreateBitCast(load, Builder->getInt32Ty());
+  result_ = Builder->CreateICmpSLT(result_, Builder->getInt32(0));
+  result_ = Builder->CreateSelect(result_, Builder->getInt32(-1),
+                                  Builder->getInt32(1));
 
-  return Builder.CreateSelect(mark, result_, Builder.getInt32(0));
+  return Builder->CreateSelect(mark, result_, Builder->getInt32(0));
 }
 
 llvm::Value* CodeGen::IsFinite(Expr* arg) {
-  static auto func_type{llvm::FunctionType::get(Builder.getFloatTy(),
-                                                {Builder.getFloatTy()}, false)};
-
-  static auto fabs_f32{llvm::Function::Create(func_type,
-                                              llvm::Function::ExternalLinkage,
-                                              "llvm.fabs.f32", Module.get())};
+  auto fabs_f32{llvm::Intrinsic::getDeclaration(
+      Module.get(), llvm::Intrinsic::fabs, {Builder->getFloatTy()})};
 
   arg->Accept(*this);
-  result_ = Builder.CreateCall(fabs_f32, {result_});
+  result_ = Builder->CreateCall(fabs_f32, {result_});
 
-  result_ = Builder.CreateFCmpONE(
+  result_ = Builder->CreateFCmpONE(
       result_,
       llvm::ConstantFP::get(
-          Builder.getFloatTy(),
-          llvm::APFloat::getInf(GetFloatTypeSemantics(Builder.getFloatTy()))));
+          Builder->getFloatTy(),
+          llvm::APFloat::getInf(GetFloatTypeSemantics(Builder->getFloatTy()))));
+
+  return Builder->CreateZExt(result_, Builder->getInt32Ty());
+}
+
+llvm::Value* CodeGen::ByteSwap(Expr* arg) {
+  arg->Accept(*this);
+
+  auto bswap{llvm::Intrinsic::getDeclaration(
+      Module.get(), llvm::Intrinsic::bswap, {result_->getType()})};
+  return Builder->CreateCall(bswap, {result_});
+}
+
+// __builtin_prefetch(addr, rw = 0, locality = 3)
+llvm::Value* CodeGen::Prefetch(const ArenaVector<Expr*>& args) {
+  args[0]->Accept(*this);
+  auto addr{Builder->CreateBitCast(result_, Builder->getInt8PtrTy())};
+
+  std::int64_t rw{}, locality{3};
+  if (std::size(args) > 1) {
+    rw = *CalcConstantExpr{}.CalcInteger(args[1]);
+  }
+  if (std::size(args) > 2) {
+    locality = *CalcConstantExpr{}.CalcInteger(args[2]);
+  }
+
+  if (rw < 0 || rw > 1) {
+    Error(args[1]->GetLoc(), "argument must be a constant 0 or 1");
+  }
+  if (locality < 0 || locality > 3) {
+    Error(args[2]->GetLoc(), "argument must be a constant between 0 and 3");
+  }
+
+  // 最后一个参数为 1 表示数据缓存
+  auto prefetch{
+      llvm::Intrinsic::getDeclaration(Module.get(), llvm::Intrinsic::prefetch)};
+  return Builder->CreateCall(
+      prefetch, {addr, Builder->getInt32(rw), Builder->getInt32(locality),
+                 Builder->getInt32(1)});
+}
+
+// __builtin_assume_aligned(ptr, align, offset = 0)
+// 返回 ptr, 同时告诉优化器 (ptr - offset) 按 align 对齐
+llvm::Value* CodeGen::AssumeAligned(const ArenaVector<Expr*>& args) {
+  args[0]->Accept(*this);
+  auto ptr{result_};
+
+  auto align{*CalcConstantExpr{}.CalcInteger(args[1])};
+  if (align <= 0 || (align & (align - 1)) != 0) {
+    Error(args[1]->GetLoc(), "requested alignment is not a power of 2");
+  }
+
+  llvm::Value* offset{};
+  if (std::size(args) > 2) {
+    args[2]->Accept(*this);
+    offset = result_;
+  }
+
+  if (OptimizationLevel != OptLevel::kO0) {
+    Builder->CreateAlignmentAssumption(Module->getDataLayout(), ptr,
+                                       static_cast<std::uint32_t>(align),
+                                       offset);
+  }
+
+  return ptr;
+}
+
+llvm::Value* CodeGen::Unreachable() {
+  auto unreachable{Builder->CreateUnreachable()};
+  // 之后的代码不可达, 但是仍然需要插入点
+  EmitBlock(CreateBasicBlock("unreachable.cont"));
+
+  return unreachable;
+}
+
+// 返回 dst
+llvm::Value* CodeGen::MemCpy(Expr* dst, Expr* src, Expr* size) {
+  dst->Accept(*this);
+  auto dst_ptr{result_};
+  src->Accept(*this);
+  auto src_ptr{result_};
+  size->Accept(*this);
+
+  Builder->CreateMemCpy(dst_ptr, 1, src_ptr, 1, result_);
+
+  return dst_ptr;
+}
+
+llvm::Value* CodeGen::MemSet(Expr* dst, Expr* value, Expr* size) {
+  dst->Accept(*this);
+  auto dst_ptr{result_};
+  value->Accept(*this);
+  auto byte{Builder->CreateTrunc(result_, Builder->getInt8Ty())};
+  size->Accept(*this);
+
+  Builder->CreateMemSet(dst_ptr, byte, result_, 1);
+
+  return dst_ptr;
+}
+
+// 常量表达式直接得到 1, 否则不求值参数 (没有副作用),
+// 对于变量交给优化器在内联和常量传播之后判断
+llvm::Value* CodeGen::ConstantP(Expr* arg) {
+  if (arg->GetType()->IsArithmeticTy() && CalcConstantExpr{}.Calc(arg)) {
+    return Builder->getInt32(1);
+  }
+
+  const Expr* expr{arg};
+  while (expr->Kind() == AstNodeType::kTypeCastExpr) {
+    expr = dynamic_cast<const TypeCastExpr*>(expr)->GetExpr();
+  }
+
+  if (OptimizationLevel == OptLevel::kO0 ||
+      expr->Kind() != AstNodeType::kObjectExpr ||
+      !arg->GetType()->IsScalarTy() || expr->GetQualType().IsVolatile()) {
+    return Builder->getInt32(0);
+  }
+
+  arg->Accept(*this);
+
+  auto is_constant{llvm::Intrinsic::getDeclaration(
+      Module.get(), llvm::Intrinsic::is_constant, {result_->getType()})};
+  result_ = Builder->CreateCall(is_constant, {result_});
 
-  return Builder.CreateZExt(result_, Builder.getInt32Ty());
+  return Builder->CreateZExt(result_, Builder->getInt32Ty());
 }
 
 }  // namespace kcc
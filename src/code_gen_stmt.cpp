@@ -36,7 +36,7 @@ void CodeGen::Visit(const CaseStmt* node) {
   }
 
   for (auto i{begin}; i <= end; ++i) {
-    switch_inst_->addCase(llvm::ConstantInt::get(Builder.getInt64Ty(), i),
+    switch_inst_->addCase(llvm::ConstantInt::get(Builder->getInt64Ty(), i),
                           block);
   }
 
@@ -54,9 +54,13 @@ void CodeGen::Visit(const DefaultStmt* node) {
 }
 
 void CodeGen::Visit(const CompoundStmt* node) {
+  ++block_depth_;
+
   for (const auto& item : node->GetStmts()) {
     EmitStmt(item);
   }
+
+  --block_depth_;
 }
 
 void CodeGen::Visit(const ExprStmt* node) {
@@ -120,9 +124,9 @@ void CodeGen::Visit(const SwitchStmt* node) {
 
   auto default_block{CreateBasicBlock("switch.default")};
   auto end_block{CreateBasicBlock("switch.end")};
-  switch_inst_ = Builder.CreateSwitch(cond_val, default_block);
+  switch_inst_ = Builder->CreateSwitch(cond_val, default_block);
 
-  Builder.ClearInsertionPoint();
+  Builder->ClearInsertionPoint();
 
   llvm::BasicBlock* continue_block{};
   if (!std::empty(break_continue_stack_)) {
@@ -163,7 +167,8 @@ void CodeGen::Visit(const WhileStmt* node) {
     }
   }
   if (emit_br) {
-    Builder.CreateCondBr(cond_val, body_block, end_block);
+    Builder->CreateCondBr(cond_val, body_block, end_block,
+                          GetBranchWeights(node->GetCond()));
   }
 
   EmitBlock(body_block);
@@ -209,7 +214,8 @@ void CodeGen::Visit(const DoWhileStmt* node) {
     }
   }
   if (emit_br) {
-    Builder.CreateCondBr(cond_val, body_block, end_block);
+    Builder->CreateCondBr(cond_val, body_block, end_block,
+                          GetBranchWeights(node->GetCond()));
   }
 
   EmitBlock(end_block);
@@ -295,11 +301,25 @@ void CodeGen::Visit(const ReturnStmt* node) {
     return;
   }
 
-  if (return_value_) {
+  if (return_value_ && expr->GetType()->IsStructOrUnionTy()) {
+    // 直接复制到返回值的内存中, 避免加载整个结构体
+    auto load_struct{load_struct_};
+    load_struct_ = false;
+    expr->Accept(*this);
+    load_struct_ = load_struct;
+
+    auto type{expr->GetType()};
+    if (result_->getType()->isPointerTy()) {
+      Builder->CreateMemCpy(return_value_, type->GetAlign(), result_,
+                            type->GetAlign(), type->GetWidth());
+    } else {
+      Builder->CreateStore(result_, return_value_);
+    }
+  } else if (return_value_) {
     Load_Struct_Obj();
     node->GetExpr()->Accept(*this);
     Finish_Load();
-    Builder.CreateStore(result_, return_value_);
+    Builder->CreateStore(result_, return_value_);
   } else {
     Error(node->GetLoc(), "void function '{}' should not return a value",
           func_->getName().str());
@@ -4,6 +4,8 @@
 
 #include "cpp.h"
 
+#include <cstdint>
+
 #include <clang/Basic/SourceLocation.h>
 #include <clang/Basic/SourceManager.h>
 #include <clang/Frontend/PreprocessorOutputOptions.h>
@@ -12,13 +14,164 @@
 #include <fmt/format.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include "dict.h"
 #include "error.h"
+#include "identifier_table.h"
 #include "llvm_common.h"
+#include "source_manager.h"
+#include "stats.h"
+#include "time_trace.h"
 
 namespace kcc {
 
+namespace {
+
+// 与 Scanner::SkipNumber 的判断方式相同
+Tag NumericConstantTag(std::string_view str) {
+  bool saw_hex_prefix{false};
+
+  for (auto ch : str) {
+    if (ch == 'x' || ch == 'X') {
+      saw_hex_prefix = true;
+    } else if (ch == '.') {
+      return Tag::kFloatingPoint;
+    } else if ((ch == 'p' || ch == 'P') && saw_hex_prefix) {
+      return Tag::kFloatingPoint;
+    } else if ((ch == 'e' || ch == 'E') && !saw_hex_prefix) {
+      return Tag::kFloatingPoint;
+    }
+  }
+
+  return Tag::kInteger;
+}
+
+Tag ToTag(const clang::Token &tok) {
+  // 关键字统一由 KeywordsDictionary 处理, 包括 GNU 扩展的别名
+  if (auto ident{tok.getIdentifierInfo()}) {
+    auto name{ident->getName()};
+    return Keywords.Find({name.data(), name.size()});
+  }
+
+  switch (tok.getKind()) {
+    case clang::tok::l_square:
+      return Tag::kLeftSquare;
+    case clang::tok::r_square:
+      return Tag::kRightSquare;
+    case clang::tok::l_paren:
+      return Tag::kLeftParen;
+    case clang::tok::r_paren:
+      return Tag::kRightParen;
+    case clang::tok::l_brace:
+      return Tag::kLeftBrace;
+    case clang::tok::r_brace:
+      return Tag::kRightBrace;
+    case clang::tok::period:
+      return Tag::kPeriod;
+    case clang::tok::ellipsis:
+      return Tag::kEllipsis;
+    case clang::tok::amp:
+      return Tag::kAmp;
+    case clang::tok::ampamp:
+      return Tag::kAmpAmp;
+    case clang::tok::ampequal:
+      return Tag::kAmpEqual;
+    case clang::tok::star:
+      return Tag::kStar;
+    case clang::tok::starequal:
+      return Tag::kStarEqual;
+    case clang::tok::plus:
+      return Tag::kPlus;
+    case clang::tok::plusplus:
+      return Tag::kPlusPlus;
+    case clang::tok::plusequal:
+      return Tag::kPlusEqual;
+    case clang::tok::minus:
+      return Tag::kMinus;
+    case clang::tok::arrow:
+      return Tag::kArrow;
+    case clang::tok::minusminus:
+      return Tag::kMinusMinus;
+    case clang::tok::minusequal:
+      return Tag::kMinusEqual;
+    case clang::tok::tilde:
+      return Tag::kTilde;
+    case clang::tok::exclaim:
+      return Tag::kExclaim;
+    case clang::tok::exclaimequal:
+      return Tag::kExclaimEqual;
+    case clang::tok::slash:
+      return Tag::kSlash;
+    case clang::tok::slashequal:
+      return Tag::kSlashEqual;
+    case clang::tok::percent:
+      return Tag::kPercent;
+    case clang::tok::percentequal:
+      return Tag::kPercentEqual;
+    case clang::tok::less:
+      return Tag::kLess;
+    case clang::tok::lessless:
+      return Tag::kLessLess;
+    case clang::tok::lessequal:
+      return Tag::kLessEqual;
+    case clang::tok::lesslessequal:
+      return Tag::kLessLessEqual;
+    case clang::tok::greater:
+      return Tag::kGreater;
+    case clang::tok::greatergreater:
+      return Tag::kGreaterGreater;
+    case clang::tok::greaterequal:
+      return Tag::kGreaterEqual;
+    case clang::tok::greatergreaterequal:
+      return Tag::kGreaterGreaterEqual;
+    case clang::tok::caret:
+      return Tag::kCaret;
+    case clang::tok::caretequal:
+      return Tag::kCaretEqual;
+    case clang::tok::pipe:
+      return Tag::kPipe;
+    case clang::tok::pipepipe:
+      return Tag::kPipePipe;
+    case clang::tok::pipeequal:
+      return Tag::kPipeEqual;
+    case clang::tok::question:
+      return Tag::kQuestion;
+    case clang::tok::colon:
+      return Tag::kColon;
+    case clang::tok::semi:
+      return Tag::kSemicolon;
+    case clang::tok::equal:
+      return Tag::kEqual;
+    case clang::tok::equalequal:
+      return Tag::kEqualEqual;
+    case clang::tok::comma:
+      return Tag::kComma;
+    case clang::tok::hash:
+      return Tag::kSharp;
+    case clang::tok::hashhash:
+      return Tag::kSharpSharp;
+    case clang::tok::numeric_constant:
+      return NumericConstantTag({tok.getLiteralData(), tok.getLength()});
+    case clang::tok::char_constant:
+    case clang::tok::wide_char_constant:
+    case clang::tok::utf8_char_constant:
+    case clang::tok::utf16_char_constant:
+    case clang::tok::utf32_char_constant:
+      return Tag::kCharacter;
+    case clang::tok::string_literal:
+    case clang::tok::wide_string_literal:
+    case clang::tok::utf8_string_literal:
+    case clang::tok::utf16_string_literal:
+    case clang::tok::utf32_string_literal:
+      return Tag::kStringLiteral;
+    default:
+      return Tag::kNone;
+  }
+}
+
+}  // namespace
+
 Preprocessor::Preprocessor() {
-  pp_ = &Ci.getPreprocessor();
+  pp_ = &Ci->getPreprocessor();
   header_search_ = &pp_->getHeaderSearchInfo();
 
   AddIncludePath("/usr/include", true);
@@ -68,13 +221,7 @@ void Preprocessor::AddMacroDefinitions(
 }
 
 std::string Preprocessor::Cpp(const std::string &input_file) {
-  Module->setSourceFileName(input_file);
-
-  auto file{Ci.getFileManager().getFile(input_file)};
-  Ci.getSourceManager().setMainFileID(Ci.getSourceManager().createFileID(
-      file, clang::SourceLocation(), clang::SrcMgr::C_User));
-
-  Ci.getDiagnosticClient().BeginSourceFile(Ci.getLangOpts(), pp_);
+  SetMainFile(input_file);
 
   std::string code;
   code.reserve(Preprocessor::StrReserve);
@@ -86,22 +233,94 @@ std::string Preprocessor::Cpp(const std::string &input_file) {
   clang::DoPrintPreprocessedInput(*pp_, &os, opts);
   os.flush();
 
-  if (Ci.getDiagnostics().hasErrorOccurred()) {
-    Error("Preprocess failure");
+  CheckDiagnostics();
+
+  return code;
+}
+
+void Preprocessor::EnterMainFile(const std::string &input_file) {
+  SetMainFile(input_file);
+  Sources->SetClangSourceManager(&Ci->getSourceManager());
+
+  pp_->EnterMainSourceFile();
+}
+
+Token Preprocessor::Lex() {
+  if (eof_) {
+    return *eof_;
   }
 
-  Ci.getDiagnosticClient().EndSourceFile();
+  // 逐个 token 计时, 不在 Chrome trace 中记录
+  PhaseTimer timer{Phase::kPreprocess};
 
-  return code;
+  clang::Token tok;
+  pp_->Lex(tok);
+
+  if (tok.is(clang::tok::eof)) {
+    eof_ = Token{Tag::kEof, tok.getLocation().getRawEncoding(), 0};
+    CheckDiagnostics();
+    return *eof_;
+  }
+
+  auto offset{tok.getLocation().getRawEncoding()};
+  auto length{tok.getLength()};
+
+  // 如含有续行符或三标符, 此时源代码中的拼写与 token 不同
+  if (tok.needsCleaning()) {
+    auto spelling{pp_->getSpelling(tok)};
+    length = std::size(spelling);
+    Sources->AddCleanedSpelling(offset, std::move(spelling));
+  }
+
+  if (CollectStats) {
+    RecordToken(length);
+  }
+
+  Token token{ToTag(tok), offset, length};
+  if (token.TagIs(Tag::kNone)) {
+    Error(token, "Invalid input: '{}'", token.GetStr());
+  } else if (token.IsIdentifier()) {
+    // clang 已经对标识符做了一次 intern, 将 id 缓存在 IdentifierInfo 中
+    auto ident{tok.getIdentifierInfo()};
+    auto id{reinterpret_cast<std::uintptr_t>(ident->getFETokenInfo())};
+
+    if (id == 0) {
+      auto name{ident->getName()};
+      id = Identifiers->Intern({name.data(), name.size()});
+      ident->setFETokenInfo(reinterpret_cast<void *>(id));
+    }
+
+    token.SetIdentifierId(static_cast<std::uint32_t>(id));
+  }
+
+  return token;
+}
+
+void Preprocessor::SetMainFile(const std::string &input_file) {
+  Module->setSourceFileName(input_file);
+
+  auto file{Ci->getFileManager().getFile(input_file)};
+  Ci->getSourceManager().setMainFileID(Ci->getSourceManager().createFileID(
+      file, clang::SourceLocation(), clang::SrcMgr::C_User));
+
+  Ci->getDiagnosticClient().BeginSourceFile(Ci->getLangOpts(), pp_);
+}
+
+void Preprocessor::CheckDiagnostics() {
+  if (Ci->getDiagnostics().hasErrorOccurred()) {
+    Error("Preprocess failure");
+  }
+
+  Ci->getDiagnosticClient().EndSourceFile();
 }
 
 void Preprocessor::AddIncludePath(const std::string &path, bool is_system) {
   if (is_system) {
-    clang::DirectoryLookup directory{Ci.getFileManager().getDirectory(path),
+    clang::DirectoryLookup directory{Ci->getFileManager().getDirectory(path),
                                      clang::SrcMgr::C_System, false};
     header_search_->AddSearchPath(directory, true);
   } else {
-    clang::DirectoryLookup directory{Ci.getFileManager().getDirectory(path),
+    clang::DirectoryLookup directory{Ci->getFileManager().getDirectory(path),
                                      clang::SrcMgr::C_User, false};
     header_search_->AddSearchPath(directory, false);
   }
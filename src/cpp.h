@@ -5,12 +5,15 @@
 #pragma once
 
 #include <cstddef>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include <clang/Lex/HeaderSearch.h>
 #include <clang/Lex/Preprocessor.h>
 
+#include "token.h"
+
 namespace kcc {
 
 class Preprocessor {
@@ -21,15 +24,25 @@ class Preprocessor {
   // 输入形式为 name=value 或 name
   void AddMacroDefinitions(const std::vector<std::string> &macro_definitions);
 
+  // 用于 -E 和 -emit-tokens, 输出预处理后的代码
   std::string Cpp(const std::string &input_file);
 
+  // 不输出预处理后的代码, Parser 直接从 clang::Preprocessor 中获取 token
+  void EnterMainFile(const std::string &input_file);
+  Token Lex();
+
  private:
   void AddIncludePath(const std::string &path, bool is_system);
+  void SetMainFile(const std::string &input_file);
+  void CheckDiagnostics();
 
   constexpr static std::size_t StrReserve{4096};
 
   clang::Preprocessor *pp_;
   clang::HeaderSearch *header_search_;
+
+  // 到达文件末尾后不再从 clang 获取 token, 预处理的错误也只报告一次
+  std::optional<Token> eof_;
 };
 
 }  // namespace kcc
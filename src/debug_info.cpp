@@ -48,11 +48,11 @@ void DebugInfo::Finalize() {
 
 void DebugInfo::EmitLocation(const AstNode* node) {
   if (!node) {
-    return Builder.SetCurrentDebugLocation(llvm::DebugLoc{});
+    return Builder->SetCurrentDebugLocation(llvm::DebugLoc{});
   }
 
-  auto loc{node->GetLoc()};
-  Builder.SetCurrentDebugLocation(
+  auto loc{node->GetLoc().Decode()};
+  Builder->SetCurrentDebugLocation(
       llvm::DebugLoc::get(loc.GetRow(), loc.GetColumn(), GetScope()));
 }
 
@@ -83,7 +83,7 @@ void DebugInfo::EmitFuncEnd() {
 }
 
 void DebugInfo::EmitParamVar(const std::string& name, Type* type,
-                             llvm::AllocaInst* ptr, const Location& loc) {
+                             llvm::Value* ptr, SourceLocation loc) {
   assert(subprogram_ != nullptr);
 
   auto line_no{loc.GetRow()};
@@ -93,19 +93,19 @@ void DebugInfo::EmitParamVar(const std::string& name, Type* type,
 
   builder_->insertDeclare(ptr, param, builder_->createExpression(),
                           llvm::DebugLoc::get(line_no, 0, subprogram_),
-                          Builder.GetInsertBlock());
+                          Builder->GetInsertBlock());
 }
 
 void DebugInfo::EmitLocalVar(const Declaration* decl) {
   assert(decl && decl->IsObjDecl());
 
-  if (Builder.GetInsertBlock() == nullptr) {
+  if (Builder->GetInsertBlock() == nullptr) {
     return;
   }
 
   llvm::DIScope* scope{lexical_blocks_.back()};
   auto ident{decl->GetIdent()};
-  auto loc{decl->GetLoc()};
+  auto loc{decl->GetLoc().Decode()};
   auto ptr{decl->GetIdent()->ToObjectExpr()->GetLocalPtr()};
 
   auto var{builder_->createAutoVariable(
@@ -115,7 +115,7 @@ void DebugInfo::EmitLocalVar(const Declaration* decl) {
   builder_->insertDeclare(
       ptr, var, builder_->createExpression(),
       llvm::DebugLoc::get(loc.GetRow(), loc.GetColumn(), scope),
-      Builder.GetInsertBlock());
+      Builder->GetInsertBlock());
 }
 
 void DebugInfo::EmitGlobalVar(const Declaration* decl) {
@@ -143,7 +143,7 @@ llvm::DIScope* DebugInfo::GetScope() {
   }
 }
 
-llvm::DIType* DebugInfo::GetOrCreateType(Type* type, const Location& loc) {
+llvm::DIType* DebugInfo::GetOrCreateType(Type* type, SourceLocation loc) {
   assert(type != nullptr);
 
   auto& cache{type_cache_[type]};
@@ -221,7 +221,7 @@ llvm::DIType* DebugInfo::CreateArrayType(Type* type) {
       builder_->getOrCreateArray(subscripts));
 }
 
-llvm::DIType* DebugInfo::CreateStructType(Type* type, const Location& loc) {
+llvm::DIType* DebugInfo::CreateStructType(Type* type, SourceLocation loc) {
   std::int32_t tag{};
   if (type->IsStructTy()) {
     tag = llvm::dwarf::DW_TAG_structure_type;
@@ -243,9 +243,11 @@ llvm::DIType* DebugInfo::CreateStructType(Type* type, const Location& loc) {
   type_cache_[type] = fwd_type;
 
   llvm::SmallVector<llvm::Metadata*, 16> ele_types;
-  for (const auto& [name, ident] : *type->StructGetScope()) {
+  for (const auto& member : *type->StructGetScope()) {
+    auto ident{member.second};
     auto member_type{GetOrCreateType(ident->GetType(), ident->GetLoc())};
 
+    const auto& name{ident->GetName()};
     if (std::empty(name)) {
       continue;
     }
@@ -32,20 +32,20 @@ class DebugInfo {
   void EmitFuncStart(const FuncDef* node);
   void EmitFuncEnd();
 
-  void EmitParamVar(const std::string& name, Type* type, llvm::AllocaInst* ptr,
-                    const Location& loc);
+  void EmitParamVar(const std::string& name, Type* type, llvm::Value* ptr,
+                    SourceLocation loc);
   void EmitLocalVar(const Declaration* node);
   void EmitGlobalVar(const Declaration* node);
 
  private:
   llvm::DIScope* GetScope();
 
-  llvm::DIType* GetOrCreateType(Type* type, const Location& loc = Location{});
+  llvm::DIType* GetOrCreateType(Type* type, SourceLocation loc = {});
 
   llvm::DIType* CreateBuiltinType(Type* type);
   llvm::DIType* CreatePointerType(Type* type);
   llvm::DIType* CreateArrayType(Type* type);
-  llvm::DIType* CreateStructType(Type* type, const Location& loc);
+  llvm::DIType* CreateStructType(Type* type, SourceLocation loc);
   llvm::DISubroutineType* CreateFunctionType(Type* type);
 
   bool optimize_;
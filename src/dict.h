@@ -4,21 +4,180 @@
 
 #pragma once
 
-#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <string_view>
-#include <unordered_map>
 
 #include "token.h"
 
 namespace kcc {
 
+// 编译期生成的完美哈希, 每个关键字占据不同的槽位
+// 查找时只需计算一次哈希并比较一次字符串
 class KeywordsDictionary {
  public:
-  KeywordsDictionary();
-  Tag Find(const std::string& name) const;
+  constexpr KeywordsDictionary();
+  constexpr Tag Find(std::string_view name) const;
 
  private:
-  std::unordered_map<std::string_view, Tag> keywords_;
+  struct Keyword {
+    std::string_view name;
+    Tag tag;
+  };
+
+  constexpr static Keyword KeywordList[]{
+      {"auto", Tag::kAuto},
+      {"break", Tag::kBreak},
+      {"case", Tag::kCase},
+      {"char", Tag::kChar},
+      {"const", Tag::kConst},
+      {"continue", Tag::kContinue},
+      {"default", Tag::kDefault},
+      {"do", Tag::kDo},
+      {"double", Tag::kDouble},
+      {"else", Tag::kElse},
+      {"enum", Tag::kEnum},
+      {"extern", Tag::kExtern},
+      {"float", Tag::kFloat},
+      {"for", Tag::kFor},
+      {"goto", Tag::kGoto},
+      {"if", Tag::kIf},
+      {"inline", Tag::kInline},
+      {"int", Tag::kInt},
+      {"long", Tag::kLong},
+      {"register", Tag::kRegister},
+      {"restrict", Tag::kRestrict},
+      {"return", Tag::kReturn},
+      {"short", Tag::kShort},
+      {"signed", Tag::kSigned},
+      {"sizeof", Tag::kSizeof},
+      {"static", Tag::kStatic},
+      {"struct", Tag::kStruct},
+      {"switch", Tag::kSwitch},
+      {"typedef", Tag::kTypedef},
+      {"union", Tag::kUnion},
+      {"unsigned", Tag::kUnsigned},
+      {"void", Tag::kVoid},
+      {"volatile", Tag::kVolatile},
+      {"while", Tag::kWhile},
+      {"_Alignas", Tag::kAlignas},
+      {"_Alignof", Tag::kAlignof},
+      {"_Atomic", Tag::kAtomic},
+      {"_Bool", Tag::kBool},
+      {"_Complex", Tag::kComplex},
+      {"_Generic", Tag::kGeneric},
+      {"_Imaginary", Tag::kImaginary},
+      {"_Noreturn", Tag::kNoreturn},
+      {"_Static_assert", Tag::kStaticAssert},
+      {"_Thread_local", Tag::kThreadLocal},
+
+      {"__func__", Tag::kFuncName},
+      {"__builtin_offsetof", Tag::kOffsetof},
+      {"__builtin_huge_val", Tag::kHugeVal},
+      {"__builtin_inff", Tag::kInff},
+
+      // GNU 扩展
+      {"typeof", Tag::kTypeof},
+      {"__typeof__", Tag::kTypeof},
+      {"__attribute__", Tag::kAttribute},
+      {"__extension__", Tag::kExtension},
+      {"__FUNCTION__", Tag::kFuncName},
+      {"__PRETTY_FUNCTION__", Tag::kFuncSignature},
+
+      {"__inline", Tag::kInline},
+      {"__alignof__", Tag::kAlignof},
+      {"__inline__", Tag::kInline},
+      {"__restrict", Tag::kRestrict},
+      {"__restrict__", Tag::kRestrict},
+      {"__signed__", Tag::kSigned},
+      {"__volatile__", Tag::kVolatile},
+      {"asm", Tag::kAsm},
+      {"__asm__", Tag::kAsm},
+      {"__asm", Tag::kAsm},
+
+      // 一个显示表达式类型名称的扩展
+      {"typeid", Tag::kTypeid}};
+
+  constexpr static std::size_t KeywordCount{std::size(KeywordList)};
+  constexpr static std::uint32_t TableBits{9};
+  constexpr static std::size_t TableSize{std::size_t{1} << TableBits};
+  constexpr static std::size_t MaxKeywordLength{32};
+  constexpr static std::uint32_t MaxSeed{4096};
+
+  static_assert(KeywordCount < 256, "slot index must fit in std::uint8_t");
+
+  // 只用长度和首, 中, 尾三个字符, 乘法哈希取高位
+  constexpr static std::uint32_t Hash(std::string_view name,
+                                      std::uint32_t seed);
+  constexpr static bool IsPerfect(std::uint32_t seed);
+  constexpr static std::uint32_t FindSeed();
+
+  std::uint32_t seed_{};
+  // 0 表示空槽, 否则为 KeywordList 的下标加 1
+  std::uint8_t slots_[TableSize]{};
 };
 
+constexpr std::uint32_t KeywordsDictionary::Hash(std::string_view name,
+                                                 std::uint32_t seed) {
+  auto size{std::size(name)};
+  auto byte{[](char c) {
+    return static_cast<std::uint32_t>(static_cast<std::uint8_t>(c));
+  }};
+  auto key{static_cast<std::uint32_t>(size) | byte(name[0]) << 8 |
+           byte(name[size - 1]) << 16 | byte(name[size / 2]) << 24};
+
+  return ((key ^ seed) * 0x9E3779B1U) >> (32 - TableBits);
+}
+
+constexpr bool KeywordsDictionary::IsPerfect(std::uint32_t seed) {
+  std::uint64_t used[TableSize / 64]{};
+
+  for (const auto& keyword : KeywordList) {
+    auto slot{Hash(keyword.name, seed)};
+    auto bit{std::uint64_t{1} << (slot % 64)};
+
+    if (used[slot / 64] & bit) {
+      return false;
+    }
+    used[slot / 64] |= bit;
+  }
+
+  return true;
+}
+
+constexpr std::uint32_t KeywordsDictionary::FindSeed() {
+  std::uint32_t seed{};
+  while (seed < MaxSeed && !IsPerfect(seed)) {
+    ++seed;
+  }
+  return seed;
+}
+
+constexpr KeywordsDictionary::KeywordsDictionary() : seed_{FindSeed()} {
+  static_assert(IsPerfect(FindSeed()), "no perfect hash seed found");
+
+  for (std::size_t i{}; i < KeywordCount; ++i) {
+    slots_[Hash(KeywordList[i].name, seed_)] =
+        static_cast<std::uint8_t>(i + 1);
+  }
+}
+
+constexpr Tag KeywordsDictionary::Find(std::string_view name) const {
+  auto size{std::size(name)};
+  if (size < 2 || size > MaxKeywordLength) {
+    return Tag::kIdentifier;
+  }
+
+  if (auto index{slots_[Hash(name, seed_)]};
+      index != 0 && KeywordList[index - 1].name == name) {
+    return KeywordList[index - 1].tag;
+  } else {
+    return Tag::kIdentifier;
+  }
+}
+
+// 关键字表在编译期构造完成, 没有运行时初始化
+inline constexpr KeywordsDictionary Keywords;
+
 }  // namespace kcc
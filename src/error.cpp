@@ -4,72 +4,118 @@
 
 #include "error.h"
 
+#include "util.h"
+
 namespace kcc {
 
+namespace {
+
+// 当前编译线程中的错误信息
+thread_local std::string ErrorString;
+thread_local std::uint32_t ErrorCount;
+
+}  // namespace
+
 [[noreturn]] void Error(Tag tag, const Token &actual) {
-  auto loc{actual.GetLoc()};
-  fmt::print(fmt::fg(fmt::terminal_color::red), fmt("{}: error: "),
-             loc.ToLocStr());
-  fmt::print(fmt::fg(fmt::terminal_color::red), "expected {}, but got {}\n",
-             TokenTag::ToString(tag), TokenTag::ToString(actual.GetTag()));
+  std::string str;
+  auto loc{actual.GetLoc().Decode()};
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), fmt("{}: error: "),
+                     loc.ToLocStr());
+  str += fmt::format(fmt::fg(fmt::terminal_color::red),
+                     "expected {}, but got {}\n", TokenTag::ToString(tag),
+                     TokenTag::ToString(actual.GetTag()));
 
-  fmt::print(fmt::fg(fmt::terminal_color::red), fmt("{}"),
-             loc.GetLineContent());
-  fmt::print(fmt::fg(fmt::terminal_color::green), fmt("{}"),
-             loc.GetPositionArrow());
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), fmt("{}"),
+                     loc.GetLineContent());
+  str += fmt::format(fmt::fg(fmt::terminal_color::green), fmt("{}"),
+                     loc.GetPositionArrow());
 
-  PrintWarnings();
-  std::exit(EXIT_FAILURE);
+  ReportError(str);
 }
 
 [[noreturn]] void Error(const UnaryOpExpr *unary, std::string_view msg) {
-  auto loc{unary->GetLoc()};
+  std::string str;
+  auto loc{unary->GetLoc().Decode()};
 
-  fmt::print(fmt::fg(fmt::terminal_color::red), fmt("{}: error: "),
-             loc.ToLocStr());
-  fmt::print(fmt::fg(fmt::terminal_color::red),
-             "'{}': ", TokenTag::ToString(unary->GetOp()));
-  fmt::print(fmt::fg(fmt::terminal_color::red), msg);
-  fmt::print(fmt::fg(fmt::terminal_color::red), fmt(" (got '{}')\n"),
-             unary->GetExpr()->GetQualType().ToString());
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), fmt("{}: error: "),
+                     loc.ToLocStr());
+  str += fmt::format(fmt::fg(fmt::terminal_color::red),
+                     "'{}': ", TokenTag::ToString(unary->GetOp()));
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), msg);
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), fmt(" (got '{}')\n"),
+                     unary->GetExpr()->GetQualType().ToString());
 
-  fmt::print(fmt::fg(fmt::terminal_color::red), fmt("{}"),
-             loc.GetLineContent());
-  fmt::print(fmt::fg(fmt::terminal_color::green), fmt("{}"),
-             loc.GetPositionArrow());
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), fmt("{}"),
+                     loc.GetLineContent());
+  str += fmt::format(fmt::fg(fmt::terminal_color::green), fmt("{}"),
+                     loc.GetPositionArrow());
 
-  PrintWarnings();
-  std::exit(EXIT_FAILURE);
+  ReportError(str);
 }
 
 [[noreturn]] void Error(const BinaryOpExpr *binary, std::string_view msg) {
-  auto loc{binary->GetLoc()};
-
-  fmt::print(fmt::fg(fmt::terminal_color::red), fmt("{}: error: "),
-             loc.ToLocStr());
-  fmt::print(fmt::fg(fmt::terminal_color::red),
-             "'{}': ", TokenTag::ToString(binary->GetOp()));
-  fmt::print(fmt::fg(fmt::terminal_color::red), msg);
-  fmt::print(fmt::fg(fmt::terminal_color::red), fmt(" (got '{}' and '{}')\n"),
-             binary->GetLHS()->GetQualType().ToString(),
-             binary->GetRHS()->GetQualType().ToString());
-
-  fmt::print(fmt::fg(fmt::terminal_color::red), fmt("{}"),
-             loc.GetLineContent());
-  fmt::print(fmt::fg(fmt::terminal_color::green), fmt("{}"),
-             loc.GetPositionArrow());
+  std::string str;
+  auto loc{binary->GetLoc().Decode()};
+
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), fmt("{}: error: "),
+                     loc.ToLocStr());
+  str += fmt::format(fmt::fg(fmt::terminal_color::red),
+                     "'{}': ", TokenTag::ToString(binary->GetOp()));
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), msg);
+  str += fmt::format(fmt::fg(fmt::terminal_color::red),
+                     fmt(" (got '{}' and '{}')\n"),
+                     binary->GetLHS()->GetQualType().ToString(),
+                     binary->GetRHS()->GetQualType().ToString());
+
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), fmt("{}"),
+                     loc.GetLineContent());
+  str += fmt::format(fmt::fg(fmt::terminal_color::green), fmt("{}"),
+                     loc.GetPositionArrow());
+
+  ReportError(str);
+}
+
+[[noreturn]] void ReportError(const std::string &error) {
+  if (InCompileThread) {
+    ErrorString += error;
+    ++ErrorCount;
+
+    if (ErrorLimitReached()) {
+      ErrorString += fmt::format(
+          fmt::fg(fmt::terminal_color::red),
+          fmt("fatal error: too many errors emitted, stopping now "
+              "[-ferror-limit={}]\n"),
+          ErrorLimit.getValue());
+    }
+
+    throw CompileError{};
+  }
 
+  fmt::print(fmt("{}"), error);
   PrintWarnings();
   std::exit(EXIT_FAILURE);
 }
 
-void PrintWarnings() {
+bool HasErrors() { return ErrorCount != 0; }
+
+bool ErrorLimitReached() { return ErrorLimit != 0 && ErrorCount >= ErrorLimit; }
+
+std::string TakeDiagnostics() {
+  auto str{std::move(ErrorString)};
+  ErrorString.clear();
+  ErrorCount = 0;
+
   for (const auto &[item, arrow] : WarningStrings) {
-    fmt::print(fmt::fg(fmt::terminal_color::white), fmt("{}"), item);
+    str += fmt::format(fmt::fg(fmt::terminal_color::white), fmt("{}"), item);
     if (!std::empty(arrow)) {
-      fmt::print(fmt::fg(fmt::terminal_color::green), fmt("{}"), arrow);
+      str += fmt::format(fmt::fg(fmt::terminal_color::green), fmt("{}"), arrow);
     }
   }
+  WarningStrings.clear();
+
+  return str;
 }
 
+void PrintWarnings() { fmt::print(fmt("{}"), TakeDiagnostics()); }
+
 }  // namespace kcc
@@ -20,38 +20,64 @@
 
 namespace kcc {
 
-inline std::vector<std::pair<std::string, std::string>> WarningStrings;
+inline thread_local std::vector<std::pair<std::string, std::string>>
+    WarningStrings;
+
+// 编译线程中的错误只终止当前翻译单元, 而不是整个进程
+inline thread_local bool InCompileThread{};
+
+// Parser 在语句和外部声明的边界捕获 CompileError 并跳过出错的部分,
+// 以便一次报告翻译单元中的所有错误
+struct CompileError {};
 
 [[noreturn]] void Error(Tag expect, const Token &actual);
 [[noreturn]] void Error(const UnaryOpExpr *unary, std::string_view msg);
 [[noreturn]] void Error(const BinaryOpExpr *binary, std::string_view msg);
+
+// 在编译线程中记录错误并抛出 CompileError, 否则输出后退出
+[[noreturn]] void ReportError(const std::string &error);
+
+bool HasErrors();
+// 错误数达到 -ferror-limit 后不再恢复
+bool ErrorLimitReached();
+
+// 取出当前线程中的错误和警告, 并重置错误数
+std::string TakeDiagnostics();
+
 void PrintWarnings();
 
 template <typename... Args>
 [[noreturn]] void Error(std::string_view format_str, const Args &... args) {
-  fmt::print(fmt::fg(fmt::terminal_color::red), "error: ");
-  fmt::print(fmt::fg(fmt::terminal_color::red), format_str, args...);
-  fmt::print("\n");
+  std::string str;
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), "error: ");
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), format_str, args...);
+  str += '\n';
 
-  PrintWarnings();
-  std::exit(EXIT_FAILURE);
+  ReportError(str);
 }
 
 template <typename... Args>
 [[noreturn]] void Error(const Location &loc, std::string_view format_str,
                         const Args &... args) {
-  fmt::print(fmt::fg(fmt::terminal_color::red), fmt("{}: error: "),
-             loc.ToLocStr());
-  fmt::print(fmt::fg(fmt::terminal_color::red), format_str, args...);
-  fmt::print("\n");
-
-  fmt::print(fmt::fg(fmt::terminal_color::red), fmt("{}"),
-             loc.GetLineContent());
-  fmt::print(fmt::fg(fmt::terminal_color::green), fmt("{}"),
-             loc.GetPositionArrow());
-
-  PrintWarnings();
-  std::exit(EXIT_FAILURE);
+  std::string str;
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), fmt("{}: error: "),
+                     loc.ToLocStr());
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), format_str, args...);
+  str += '\n';
+
+  str += fmt::format(fmt::fg(fmt::terminal_color::red), fmt("{}"),
+                     loc.GetLineContent());
+  str += fmt::format(fmt::fg(fmt::terminal_color::green), fmt("{}"),
+                     loc.GetPositionArrow());
+
+  ReportError(str);
+}
+
+// 只有在报错时才解码
+template <typename... Args>
+[[noreturn]] void Error(SourceLocation loc, std::string_view format_str,
+                        const Args &... args) {
+  Error(loc.Decode(), format_str, args...);
 }
 
 template <typename... Args>
@@ -89,6 +115,12 @@ void Warning(const Location &loc, std::string_view format_str,
   WarningStrings.push_back({str, loc.GetPositionArrow()});
 }
 
+template <typename... Args>
+void Warning(SourceLocation loc, std::string_view format_str,
+             const Args &... args) {
+  Warning(loc.Decode(), format_str, args...);
+}
+
 template <typename... Args>
 void Warning(const Token &tok, std::string_view format_str,
              const Args &... args) {
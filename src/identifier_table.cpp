@@ -0,0 +1,32 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#include "identifier_table.h"
+
+#include <cassert>
+#include <iterator>
+
+namespace kcc {
+
+IdentifierTable::IdentifierTable() : names_{std::string_view{}} {}
+
+std::uint32_t IdentifierTable::Intern(std::string_view name) {
+  auto [iter, inserted]{ids_.try_emplace(
+      llvm::StringRef{name.data(), name.size()},
+      static_cast<std::uint32_t>(std::size(names_)))};
+
+  if (inserted) {
+    auto key{iter->getKey()};
+    names_.emplace_back(key.data(), key.size());
+  }
+
+  return iter->second;
+}
+
+std::string_view IdentifierTable::GetName(std::uint32_t id) const {
+  assert(id != 0 && id < std::size(names_));
+  return names_[id];
+}
+
+}  // namespace kcc
@@ -0,0 +1,33 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <llvm/ADT/StringMap.h>
+
+namespace kcc {
+
+// 标识符在词法分析时只保存一份, 之后用 id 比较和查找
+// id 为 0 表示不是标识符
+class IdentifierTable {
+ public:
+  IdentifierTable();
+
+  std::uint32_t Intern(std::string_view name);
+  std::string_view GetName(std::uint32_t id) const;
+
+ private:
+  llvm::StringMap<std::uint32_t> ids_;
+  // 指向 ids_ 中保存的字符串, 插入时不会失效
+  std::vector<std::string_view> names_;
+};
+
+// 由 CompilationContext 拥有, 只在编译一个翻译单元期间有效
+inline thread_local IdentifierTable* Identifiers;
+
+}  // namespace kcc
@@ -6,8 +6,11 @@
 
 #include <cassert>
 #include <cctype>
+#include <limits>
 
 #include "error.h"
+#include "identifier_table.h"
+#include "source_manager.h"
 
 namespace kcc {
 
@@ -35,10 +38,8 @@ Scanner::Scanner(std::string preprocessed_code)
   loc_.SetContent(source_.data());
 }
 
-Scanner::Scanner(std::string code, const Location& loc)
-    : source_{std::move(code)} {
-  loc_ = loc;
-}
+Scanner::Scanner(std::string code, SourceLocation loc)
+    : source_{std::move(code)}, loc_{loc.Decode()} {}
 
 std::vector<Token> Scanner::Tokenize() {
   std::vector<Token> token_sequence;
@@ -55,6 +56,9 @@ std::vector<Token> Scanner::Tokenize() {
     }
   }
 
+  // token 中只记录偏移量, 之后由 SourceManager 持有代码
+  Sources->SetCode(std::move(source_));
+
   return token_sequence;
 }
 
@@ -62,7 +66,7 @@ std::string Scanner::HandleIdentifier() {
   std::string ident;
 
   while (HasNext()) {
-    std::int32_t ch{Next(false)};
+    std::int32_t ch{Next()};
     if (IsUCN(ch)) {
       AppendUCN(ident, HandleEscape());
     } else {
@@ -79,10 +83,10 @@ std::pair<std::int32_t, Encoding> Scanner::HandleCharacter() {
   std::int32_t val{};
   std::int32_t count{};
   // eat '
-  Next(false);
+  Next();
 
   while (!Test('\'')) {
-    std::int32_t ch{Next(false)};
+    std::int32_t ch{Next()};
     if (ch == '\\') {
       ch = HandleEscape();
     }
@@ -107,10 +111,10 @@ std::pair<std::string, Encoding> Scanner::HandleStringLiteral(
   auto encoding{HandleEncoding()};
   std::string str;
   // eat "
-  Next(false);
+  Next();
 
   while (!Test('"')) {
-    std::int32_t ch{Next(false)};
+    std::int32_t ch{Next()};
     bool is_ucn{IsUCN(ch)};
 
     if (handle_escape && ch == '\\') {
@@ -136,14 +140,10 @@ std::int32_t Scanner::Peek() {
   return ret >= 0 ? ret : ret + 256;
 }
 
-std::int32_t Scanner::Next(bool push) {
+std::int32_t Scanner::Next() {
   auto ch{Peek()};
   ++index_;
 
-  if (push) {
-    buffer_.push_back(ch);
-  }
-
   if (ch == '\n') {
     loc_.NextRow(index_);
   } else {
@@ -157,9 +157,6 @@ void Scanner::PutBack() {
   assert(index_ > 0);
   auto ch{source_[--index_]};
 
-  assert(!std::empty(buffer_));
-  buffer_.pop_back();
-
   if (ch == '\n') {
     loc_.PrevRow();
   } else {
@@ -183,13 +180,18 @@ bool Scanner::IsUCN(std::int32_t ch) {
 }
 
 const Token& Scanner::MakeToken(Tag tag) {
-  token_.SetTag(tag);
-  token_.SetStr(buffer_);
-  buffer_.clear();
+  assert(index_ <= std::numeric_limits<std::uint32_t>::max());
+
+  token_ = Token{tag, static_cast<std::uint32_t>(begin_),
+                 static_cast<std::uint32_t>(index_ - begin_)};
   return token_;
 }
 
-void Scanner::MarkLocation() { token_.SetLoc(loc_); }
+void Scanner::MarkLocation() { begin_ = index_; }
+
+std::string_view Scanner::GetTokenStr() const {
+  return std::string_view{source_}.substr(begin_, index_ - begin_);
+}
 
 const Token& Scanner::Scan() {
   SkipSpace();
@@ -363,7 +365,8 @@ const Token& Scanner::Scan() {
     case '$':
       return SkipIdentifier();
     case '\0':
-      buffer_.clear();
+      // 不包括 '\0'
+      --index_;
       return MakeToken(Tag::kEof);
     default: {
       // 字节 0xFE 和 0xFF 在 UTF-8 编码中从未用到
@@ -378,34 +381,38 @@ const Token& Scanner::Scan() {
 
 void Scanner::SkipSpace() {
   while (std::isspace(Peek())) {
-    Next(false);
+    Next();
   }
 }
 
 void Scanner::SkipLineDirectives() {
-  // clear '#'
-  buffer_.clear();
   // eat space
-  Next(false);
+  Next();
 
   // eat first number
+  MarkLocation();
   Next();
+  SkipNumber();
   // # 后的数字指示的是下一行的行号
-  loc_.SetRow(std::stoi(SkipNumber().GetStr()) - 1);
+  loc_.SetRow(std::stoi(std::string{GetTokenStr()}) - 1);
   // eat space
-  Next(false);
+  Next();
 
   // eat "
+  MarkLocation();
   Next();
-  auto file_name{SkipStringLiteral().GetStr()};
+  SkipStringLiteral();
+  auto file_name{GetTokenStr()};
   // 去掉前后的 "
-  loc_.SetFileName(file_name.substr(1, std::size(file_name) - 2));
+  std::string name{file_name.substr(1, std::size(file_name) - 2)};
+  loc_.SetFileName(name);
 
-  while (HasNext() && Next(false) != '\n') {
+  while (HasNext() && Next() != '\n') {
     // 跳过该行后面的所有内容
   }
 
-  buffer_.clear();
+  Sources->AddLineEntry(static_cast<std::uint32_t>(index_),
+                        Sources->InternFileName(name), loc_.GetRow());
 }
 
 // pp-number:
@@ -423,7 +430,7 @@ const Token& Scanner::SkipNumber() {
   auto tag{Tag::kInteger};
 
   // 第一个字符不能是 identifier-nondigit, 并不需要加 256
-  std::int32_t ch{buffer_.front()};
+  std::int32_t ch{source_[begin_]};
   while (ch == '.' || std::isalnum(ch) || ch == '_' || IsUCN(ch) ||
          (ch >= 0x80 && ch <= 0xfd)) {
     // 注意有 e 不一定是浮点数
@@ -473,17 +480,31 @@ const Token& Scanner::SkipNumber() {
 const Token& Scanner::SkipIdentifier() {
   PutBack();
   std::int32_t ch{Next()};
+  bool has_ucn{false};
 
   while (std::isalnum(ch) || ch == '_' || IsUCN(ch) ||
          (0x80 <= ch && ch <= 0xfd) || ch == '$') {
     if (IsUCN(ch)) {
       HandleEscape();
+      has_ucn = true;
     }
     ch = Next();
   }
   PutBack();
 
-  return MakeToken(Scanner::Keywords.Find(buffer_));
+  auto name{GetTokenStr()};
+  auto tag{Keywords.Find(name)};
+  MakeToken(tag);
+
+  if (tag == Tag::kIdentifier) {
+    // 只有含有 UCN 时才需要处理
+    token_.SetIdentifierId(
+        has_ucn ? Identifiers->Intern(
+                      Scanner{std::string{name}}.HandleIdentifier())
+                : Identifiers->Intern(name));
+  }
+
+  return token_;
 }
 
 // character-constant:
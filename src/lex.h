@@ -7,6 +7,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -21,7 +22,7 @@ class Scanner {
  public:
   explicit Scanner(std::string preprocessed_code);
   // for parser
-  Scanner(std::string code, const Location& loc);
+  Scanner(std::string code, SourceLocation loc);
 
   std::vector<Token> Tokenize();
 
@@ -32,7 +33,7 @@ class Scanner {
  private:
   bool HasNext();
   std::int32_t Peek();
-  std::int32_t Next(bool push = true);
+  std::int32_t Next();
   void PutBack();
   bool Test(std::int32_t c);
   bool Try(std::int32_t c);
@@ -40,6 +41,7 @@ class Scanner {
 
   const Token& MakeToken(Tag tag);
   void MarkLocation();
+  std::string_view GetTokenStr() const;
 
   const Token& Scan();
 
@@ -63,11 +65,10 @@ class Scanner {
   Location loc_;
 
   Token token_;
-  std::string buffer_;
+  // 当前 token 的起始位置
+  std::string::size_type begin_{};
 
   constexpr static std::size_t TokenReserve{1024};
-
-  inline static KeywordsDictionary Keywords;
 };
 
 }  // namespace kcc
@@ -4,13 +4,23 @@
 
 #include "link.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <lld/Common/Driver.h>
 
+#include "time_trace.h"
 #include "util.h"
 
 namespace kcc {
 
 bool Link() {
+  TimeTraceScope scope{Phase::kLink};
+
   /*
    * Platform Specific Code
    */
@@ -60,6 +70,12 @@ bool Link() {
     args.push_back(item.c_str());
   }
 
+  for (std::size_t i{}; i < std::size(InputFilePaths); ++i) {
+    for (const auto &item : GetObjFiles(i)) {
+      args.push_back(item.c_str());
+    }
+  }
+
   for (const auto &item : RPath) {
     args.push_back(item.c_str());
   }
@@ -79,11 +95,30 @@ bool Link() {
   std::string str{"-o" + OutputFilePath};
   args.push_back(str.c_str());
 
-  auto level{static_cast<std::int32_t>(OptimizationLevel.getValue())};
-  std::string level_str{"-plugin-opt=O" + std::to_string(level)};
-  if (level != 0) {
-    args.push_back("-plugin=/usr/bin/../lib/LLVMgold.so");
+  // -flto 时目标文件中是 bitcode, 由 lld 完成优化和代码生成
+  std::string level_str, jobs_str, cache_str, partitions_str;
+  if (LTO != LTOKind::kNone) {
+    auto level{static_cast<std::int32_t>(OptimizationLevel.getValue())};
+    level_str = "--lto-O" + std::to_string(level);
     args.push_back(level_str.c_str());
+
+    if (LTO == LTOKind::kThin) {
+      auto jobs{static_cast<std::uint32_t>(Jobs)};
+      if (jobs == 0) {
+        jobs = std::max(std::thread::hardware_concurrency(), 1U);
+      }
+      jobs_str = "--thinlto-jobs=" + std::to_string(jobs);
+      args.push_back(jobs_str.c_str());
+
+      // 只重新优化改变了的模块, 以及导入了它们的模块
+      if (!std::empty(LTOCacheDir)) {
+        cache_str = "--thinlto-cache-dir=" + LTOCacheDir;
+        args.push_back(cache_str.c_str());
+      }
+    } else {
+      partitions_str = "--lto-partitions=" + std::to_string(ParallelCodegen);
+      args.push_back(partitions_str.c_str());
+    }
   }
 
   return lld::elf::link(args, false);
@@ -4,12 +4,16 @@
 
 #include "llvm_common.h"
 
+#include <algorithm>
 #include <cassert>
+#include <iterator>
+#include <memory>
 
 #include <clang/Basic/LangOptions.h>
 #include <clang/Basic/TargetOptions.h>
 #include <clang/Frontend/FrontendOptions.h>
 #include <clang/Frontend/LangStandard.h>
+#include <clang/Frontend/TextDiagnosticPrinter.h>
 #include <llvm/ADT/Optional.h>
 #include <llvm/Support/Casting.h>
 #include <llvm/Support/CodeGen.h>
@@ -18,8 +22,15 @@
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetOptions.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
 
+#include "abi.h"
+#include "ast_context.h"
 #include "error.h"
+#include "identifier_table.h"
+#include "source_manager.h"
+#include "tbaa.h"
+#include "util.h"
 
 namespace kcc {
 
@@ -29,37 +40,94 @@ void InitLLVM() {
   llvm::InitializeAllTargetMCs();
   llvm::InitializeAllAsmPrinters();
   llvm::InitializeAllAsmParsers();
+}
+
+CompilationContext::CompilationContext() {
+  // 上一个翻译单元的上下文已经释放, 引用它的缓存都已清除
+  assert(Context == nullptr && Module == nullptr);
+  assert(std::empty(StringMap) && std::empty(GlobalVarMap));
+  assert(AstCtx.GetBlockCount() == 0 && FuncBodyCtx.GetBlockCount() == 0);
+
+  // 与线程中的 pass pipeline 一起在翻译单元之间复用
+  // 可能抛出异常, 因此在设置指针之前创建
+  if (!TargetMachine) {
+    InitTargetMachine();
+  }
 
-  Ci.createDiagnostics();
+  Context = &context_;
+  Builder = &builder_;
+  Ci = &ci_;
+  Sources = &sources_;
+  Identifiers = &identifiers_;
+
+  CppDiagnostics.flush();
+  CppDiagnosticsStr.clear();
+
+  if (InCompileThread) {
+    Ci->createDiagnostics(new clang::TextDiagnosticPrinter{
+        CppDiagnostics, &Ci->getDiagnosticOpts()});
+  } else {
+    Ci->createDiagnostics();
+  }
 
   auto pto{std::make_shared<clang::TargetOptions>()};
   auto target_triple{llvm::sys::getDefaultTargetTriple()};
   pto->Triple = target_triple;
 
-  TargetInfo = clang::TargetInfo::CreateTargetInfo(Ci.getDiagnostics(), pto);
+  TargetInfo = clang::TargetInfo::CreateTargetInfo(Ci->getDiagnostics(), pto);
 
-  Ci.setTarget(TargetInfo);
-  Ci.getInvocation().setLangDefaults(
-      Ci.getLangOpts(), clang::InputKind::C, TargetInfo->getTriple(),
-      Ci.getPreprocessorOpts(), clang::LangStandard::lang_c17);
+  Ci->setTarget(TargetInfo);
+  Ci->getInvocation().setLangDefaults(
+      Ci->getLangOpts(), clang::InputKind::C, TargetInfo->getTriple(),
+      Ci->getPreprocessorOpts(), clang::LangStandard::lang_c17);
 
-  auto &lang_opt{Ci.getLangOpts()};
+  auto &lang_opt{Ci->getLangOpts()};
   lang_opt.C17 = true;
   lang_opt.Digraphs = true;
   lang_opt.Trigraphs = true;
   lang_opt.GNUMode = true;
   lang_opt.GNUKeywords = true;
 
-  Ci.createFileManager();
-  Ci.createSourceManager(Ci.getFileManager());
+  Ci->createFileManager();
+  Ci->createSourceManager(Ci->getFileManager());
 
-  Ci.createPreprocessor(clang::TranslationUnitKind::TU_Complete);
+  Ci->createPreprocessor(clang::TranslationUnitKind::TU_Complete);
 
-  Module = std::make_unique<llvm::Module>("", Context);
+  Module = std::make_unique<llvm::Module>("", *Context);
   Module->addModuleFlag(llvm::Module::Error, "wchar_size", 4);
   Module->addModuleFlag(llvm::Module::Max, "PIC Level", llvm::PICLevel::BigPIC);
   Module->addModuleFlag(llvm::Module::Max, "PIE Level", llvm::PIELevel::Large);
 
+  // 配置模块以指定目标机器和数据布局
+  Module->setTargetTriple(target_triple);
+  Module->setDataLayout(TargetMachine->createDataLayout());
+}
+
+CompilationContext::~CompilationContext() {
+  StringMap.clear();
+  GlobalVarMap.clear();
+  ClearABIFuncInfoCache();
+  ClearTBAATags();
+  ClearTypeCache();
+
+  FuncBodyCtx.Clear();
+  AstCtx.Clear();
+  InFuncBody = false;
+
+  // 引用 LLVMContext, 先于它释放
+  Module.reset();
+
+  Context = nullptr;
+  Builder = nullptr;
+  TargetInfo = nullptr;
+  Ci = nullptr;
+  Sources = nullptr;
+  Identifiers = nullptr;
+}
+
+void InitTargetMachine() {
+  auto target_triple{llvm::sys::getDefaultTargetTriple()};
+
   std::string error;
   auto target{llvm::TargetRegistry::lookupTarget(target_triple, error)};
 
@@ -74,10 +142,6 @@ void InitLLVM() {
   llvm::Optional<llvm::Reloc::Model> rm{llvm::Reloc::Model::PIC_};
   TargetMachine = std::unique_ptr<llvm::TargetMachine>{
       target->createTargetMachine(target_triple, cpu, features, opt, rm)};
-
-  // 配置模块以指定目标机器和数据布局
-  Module->setTargetTriple(target_triple);
-  Module->setDataLayout(TargetMachine->createDataLayout());
 }
 
 std::string LLVMTypeToStr(llvm::Type *type) {
@@ -211,7 +275,7 @@ llvm::Constant *ConstantCastTo(llvm::Constant *value, llvm::Type *to,
   } else if (to->isVoidTy() || value->getType() == to) {
     return value;
   } else if (IsArrCastToPtr(value, to)) {
-    auto zero{llvm::ConstantInt::get(Builder.getInt64Ty(), 0)};
+    auto zero{llvm::ConstantInt::get(Builder->getInt64Ty(), 0)};
     llvm::Constant *index[]{zero, zero};
     return llvm::ConstantExpr::getInBoundsGetElementPtr(nullptr, value, index);
   } else if (IsPointerTy(value) && to->isPointerTy()) {
@@ -250,39 +314,39 @@ llvm::Value *CastTo(llvm::Value *value, llvm::Type *to, bool is_unsigned) {
 
   if (IsIntegerTy(value) && to->isIntegerTy()) {
     if (is_unsigned) {
-      return Builder.CreateZExtOrTrunc(value, to);
+      return Builder->CreateZExtOrTrunc(value, to);
     } else {
-      return Builder.CreateSExtOrTrunc(value, to);
+      return Builder->CreateSExtOrTrunc(value, to);
     }
   } else if (IsIntegerTy(value) && to->isFloatingPointTy()) {
     if (is_unsigned) {
-      return Builder.CreateUIToFP(value, to);
+      return Builder->CreateUIToFP(value, to);
     } else {
-      return Builder.CreateSIToFP(value, to);
+      return Builder->CreateSIToFP(value, to);
     }
   } else if (IsFloatingPointTy(value) && to->isIntegerTy()) {
     if (is_unsigned) {
-      return Builder.CreateFPToUI(value, to);
+      return Builder->CreateFPToUI(value, to);
     } else {
-      return Builder.CreateFPToSI(value, to);
+      return Builder->CreateFPToSI(value, to);
     }
   } else if (IsFloatingPointTy(value) && to->isFloatingPointTy()) {
     if (FloatPointRank(value->getType()) > FloatPointRank(to)) {
-      return Builder.CreateFPTrunc(value, to);
+      return Builder->CreateFPTrunc(value, to);
     } else {
-      return Builder.CreateFPExt(value, to);
+      return Builder->CreateFPExt(value, to);
     }
   } else if (IsPointerTy(value) && to->isIntegerTy()) {
-    return Builder.CreatePtrToInt(value, to);
+    return Builder->CreatePtrToInt(value, to);
   } else if (IsIntegerTy(value) && to->isPointerTy()) {
-    return Builder.CreateIntToPtr(value, to);
+    return Builder->CreateIntToPtr(value, to);
   } else if (to->isVoidTy() || value->getType() == to) {
     return value;
   } else if (IsArrCastToPtr(value, to)) {
-    return Builder.CreateInBoundsGEP(
-        value, {Builder.getInt64(0), Builder.getInt64(0)});
+    return Builder->CreateInBoundsGEP(
+        value, {Builder->getInt64(0), Builder->getInt64(0)});
   } else if (IsPointerTy(value) && to->isPointerTy()) {
-    return Builder.CreatePointerCast(value, to);
+    return Builder->CreatePointerCast(value, to);
   } else {
     Error("can not cast this expression with type '{}' to '{}'",
           LLVMTypeToStr(value->getType()), LLVMTypeToStr(to));
@@ -297,9 +361,9 @@ llvm::Value *CastToBool(llvm::Value *value) {
   }
 
   if (IsIntegerTy(value) || IsPointerTy(value)) {
-    return Builder.CreateICmpNE(value, GetZero(value->getType()));
+    return Builder->CreateICmpNE(value, GetZero(value->getType()));
   } else if (IsFloatingPointTy(value)) {
-    return Builder.CreateFCmpONE(value, GetZero(value->getType()));
+    return Builder->CreateFCmpONE(value, GetZero(value->getType()));
   } else {
     Error("this constant expression can not cast to bool: '{}'",
           LLVMTypeToStr(value->getType()));
@@ -353,12 +417,28 @@ llvm::GlobalVariable *CreateGlobalVar(const ObjectExpr *obj) {
 
   auto name{obj->GetName()};
 
+  auto type{obj->GetType()->GetLLVMType()};
+
   if (auto iter{GlobalVarMap.find(name)}; iter != std::end(GlobalVarMap)) {
     ptr = iter->second;
+
+    // 流式编译时, 函数中使用的变量可能在之后的声明中才补全类型
+    // e.g. extern int a[]; void f() { a[0] = 1; } int a[10];
+    if (ptr->getValueType() != type) {
+      auto new_ptr{new llvm::GlobalVariable(
+          *Module, type, obj->GetQualType().IsConst(), linkage, nullptr)};
+      new_ptr->takeName(ptr);
+      ptr->replaceAllUsesWith(
+          llvm::ConstantExpr::getBitCast(new_ptr, ptr->getType()));
+      ptr->eraseFromParent();
+
+      ptr = iter->second = new_ptr;
+    }
+
+    ptr->setLinkage(linkage);
   } else {
-    ptr = new llvm::GlobalVariable(*Module, obj->GetType()->GetLLVMType(),
-                                   obj->GetQualType().IsConst(), linkage,
-                                   nullptr, name);
+    ptr = new llvm::GlobalVariable(*Module, type, obj->GetQualType().IsConst(),
+                                   linkage, nullptr, name);
     GlobalVarMap[name] = ptr;
   }
 
@@ -366,7 +446,8 @@ llvm::GlobalVariable *CreateGlobalVar(const ObjectExpr *obj) {
     ptr->setDSOLocal(true);
   }
 
-  ptr->setAlignment(obj->GetType()->GetAlign());
+  ptr->setAlignment(obj->GetAlign());
+  AddGNUAttributes(ptr, obj->GetAttrs(), !obj->IsExtern());
 
   if (decl->HasConstantInit()) {
     ptr->setInitializer(decl->GetConstant());
@@ -379,6 +460,93 @@ llvm::GlobalVariable *CreateGlobalVar(const ObjectExpr *obj) {
   return ptr;
 }
 
+void AddGNUAttributes(llvm::GlobalObject *value, const Attributes &attrs,
+                      bool is_definition) {
+  if (!std::empty(attrs.section)) {
+    value->setSection(attrs.section);
+  }
+
+  if (attrs.visibility) {
+    switch (*attrs.visibility) {
+      case Visibility::kDefault:
+        value->setVisibility(llvm::GlobalValue::DefaultVisibility);
+        break;
+      case Visibility::kHidden:
+        value->setVisibility(llvm::GlobalValue::HiddenVisibility);
+        break;
+      case Visibility::kProtected:
+        value->setVisibility(llvm::GlobalValue::ProtectedVisibility);
+        break;
+    }
+  }
+
+  if (attrs.attr_spec & kAttrWeak) {
+    value->setLinkage(is_definition ? llvm::GlobalValue::WeakAnyLinkage
+                                    : llvm::GlobalValue::ExternalWeakLinkage);
+  }
+
+  // 即使没有被引用也要保留
+  if (attrs.attr_spec & kAttrUsed) {
+    llvm::appendToUsed(*Module, {value});
+  }
+}
+
+void AddGNUAttributes(llvm::Function *func, const Type *func_type,
+                      bool is_definition) {
+  const auto &attrs{func_type->FuncGetAttrs()};
+  auto attr_spec{attrs.attr_spec};
+  AddGNUAttributes(func, attrs, is_definition);
+
+  if (attrs.align > 0) {
+    func->setAlignment(attrs.align);
+  }
+
+  // noinline 和 alwaysinline 不能同时存在
+  if (attr_spec & kAttrNoInline) {
+    func->addFnAttr(llvm::Attribute::NoInline);
+  } else if (attr_spec & kAttrAlwaysInline) {
+    func->addFnAttr(llvm::Attribute::AlwaysInline);
+  } else if (func_type->FuncIsInline() &&
+             OptimizationLevel != OptLevel::kO0) {
+    func->addFnAttr(llvm::Attribute::InlineHint);
+  }
+
+  // 分别放在 .text.unlikely 和 .text.hot 中,
+  // 调用 cold 函数的分支被认为不太可能执行
+  if (attr_spec & kAttrCold) {
+    func->addFnAttr(llvm::Attribute::Cold);
+    if (OptimizationLevel != OptLevel::kO0) {
+      func->addFnAttr(llvm::Attribute::OptimizeForSize);
+    }
+    func->setSectionPrefix(".unlikely");
+  } else if (attr_spec & kAttrHot) {
+    func->setSectionPrefix(".hot");
+  }
+
+  // 返回值通过 sret 写入内存, 按值传递的结构体需要从栈上读取
+  if ((attr_spec & (kAttrConst | kAttrPure)) && !func->hasStructRetAttr()) {
+    auto has_byval{std::any_of(
+        func->arg_begin(), func->arg_end(),
+        [](const llvm::Argument &arg) { return arg.hasByValAttr(); })};
+
+    if ((attr_spec & kAttrConst) && !has_byval) {
+      func->addFnAttr(llvm::Attribute::ReadNone);
+    } else {
+      func->addFnAttr(llvm::Attribute::ReadOnly);
+    }
+    func->addFnAttr(llvm::Attribute::NoUnwind);
+  }
+
+  if ((attr_spec & kAttrMalloc) && func->getReturnType()->isPointerTy()) {
+    func->addAttribute(llvm::AttributeList::ReturnIndex,
+                       llvm::Attribute::NoAlias);
+  }
+
+  if (attr_spec & kAttrNoreturn) {
+    func->addFnAttr(llvm::Attribute::NoReturn);
+  }
+}
+
 const llvm::fltSemantics &GetFloatTypeSemantics(llvm::Type *type) {
   assert(type->isFloatingPointTy());
 
@@ -396,9 +564,9 @@ const llvm::fltSemantics &GetFloatTypeSemantics(llvm::Type *type) {
 
 llvm::Type *GetBitFieldSpace(std::int8_t width) {
   if (width <= 8) {
-    return Builder.getInt8Ty();
+    return Builder->getInt8Ty();
   } else {
-    return llvm::ArrayType::get(Builder.getInt8Ty(), (width + 7) / 8);
+    return llvm::ArrayType::get(Builder->getInt8Ty(), (width + 7) / 8);
   }
 }
 
@@ -429,7 +597,7 @@ llvm::Constant *GetBitField(llvm::Constant *value, std::int32_t size,
 
     return llvm::ConstantExpr::getAnd(
         value,
-        llvm::ConstantInt::get(Builder.getInt32Ty(), low_one | high_one));
+        llvm::ConstantInt::get(Builder->getInt32Ty(), low_one | high_one));
   } else if (size == 32) {
     std::uint32_t low_one;
     if (begin) {
@@ -447,7 +615,7 @@ llvm::Constant *GetBitField(llvm::Constant *value, std::int32_t size,
 
     return llvm::ConstantExpr::getAnd(
         value,
-        llvm::ConstantInt::get(Builder.getInt32Ty(), low_one | high_one));
+        llvm::ConstantInt::get(Builder->getInt32Ty(), low_one | high_one));
   } else {
     assert(false);
     return nullptr;
@@ -475,7 +643,7 @@ llvm::Value *GetBitField(llvm::Value *value, std::int32_t size,
       high_one = ~zero << bit;
     }
 
-    return Builder.CreateAnd(value, low_one | high_one);
+    return Builder->CreateAnd(value, low_one | high_one);
   } else if (size == 32) {
     std::uint32_t low_one;
     if (begin) {
@@ -491,7 +659,7 @@ llvm::Value *GetBitField(llvm::Value *value, std::int32_t size,
       high_one = ~0U << bit;
     }
 
-    return Builder.CreateAnd(value, low_one | high_one);
+    return Builder->CreateAnd(value, low_one | high_one);
   } else {
     assert(false);
     return nullptr;
@@ -501,12 +669,12 @@ llvm::Value *GetBitField(llvm::Value *value, std::int32_t size,
 llvm::Value *GetBitFieldValue(llvm::Value *value, std::int32_t size,
                               std::int32_t width, std::int32_t begin,
                               bool is_unsigned) {
-  value = Builder.CreateShl(value, size - (begin + width));
+  value = Builder->CreateShl(value, size - (begin + width));
 
   if (is_unsigned) {
-    return Builder.CreateLShr(value, size - width);
+    return Builder->CreateLShr(value, size - width);
   } else {
-    return Builder.CreateAShr(value, size - width);
+    return Builder->CreateAShr(value, size - width);
   }
 }
 
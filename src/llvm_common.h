@@ -11,33 +11,72 @@
 #include <clang/Basic/TargetInfo.h>
 #include <clang/Frontend/CompilerInstance.h>
 #include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalObject.h>
 #include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
+#include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
 
 #include "ast.h"
+#include "identifier_table.h"
+#include "source_manager.h"
 
 namespace kcc {
 
+// 以下为翻译单元的编译上下文, 由 CompilationContext 拥有, 只在编译
+// 一个翻译单元期间有效, 之后为空
+
 // 拥有许多 LLVM 核心数据结构, 如类型和常量值表
-inline llvm::LLVMContext Context;
+inline thread_local llvm::LLVMContext *Context;
 // 一个辅助对象, 跟踪当前位置并且可以插入 LLVM 指令
-inline llvm::IRBuilder<> Builder{Context};
+inline thread_local llvm::IRBuilder<> *Builder;
 // 包含函数和全局变量, 它拥有生成的所有 IR 的内存
-inline std::unique_ptr<llvm::Module> Module;
+// ParallelObjGen 会取走它, 因此不由 CompilationContext 直接持有
+inline thread_local std::unique_ptr<llvm::Module> Module;
+
+inline thread_local clang::TargetInfo *TargetInfo;
+
+inline thread_local clang::CompilerInstance *Ci;
+
+// 以下在线程中的翻译单元之间复用, 线程结束时释放
 
-inline clang::TargetInfo *TargetInfo;
+inline thread_local std::unique_ptr<llvm::TargetMachine> TargetMachine;
 
-inline std::unique_ptr<llvm::TargetMachine> TargetMachine;
+// 预处理器的诊断信息, 与其他错误和警告一起按文件输出
+inline thread_local std::string CppDiagnosticsStr;
+inline thread_local llvm::raw_string_ostream CppDiagnostics{CppDiagnosticsStr};
 
-inline clang::CompilerInstance Ci;
+// 一个翻译单元的编译上下文, 构造时设置上面的指针, 析构时先清除引用它的
+// 所有缓存 (AST, 类型, ABI, TBAA 等), 再整体释放. 之后残留的指针指向已释放
+// 的内存, 而不是下一个翻译单元的对象
+class CompilationContext {
+ public:
+  CompilationContext();
+  ~CompilationContext();
 
+  CompilationContext(const CompilationContext &) = delete;
+  CompilationContext &operator=(const CompilationContext &) = delete;
+
+ private:
+  // 按依赖关系声明, Builder 和预处理器先于 LLVMContext 析构
+  llvm::LLVMContext context_;
+  llvm::IRBuilder<> builder_{context_};
+  clang::CompilerInstance ci_;
+  SourceManager sources_;
+  IdentifierTable identifiers_;
+};
+
+// 注册目标平台, 整个进程只需调用一次
 void InitLLVM();
 
+// 只初始化当前线程的 TargetMachine, 用于并行生成目标代码的线程
+void InitTargetMachine();
+
 std::string LLVMTypeToStr(llvm::Type *type);
 
 std::string LLVMConstantToStr(llvm::Constant *constant);
@@ -74,6 +113,12 @@ llvm::GlobalVariable *CreateGlobalString(llvm::Constant *init,
 
 llvm::GlobalVariable* CreateGlobalVar(const ObjectExpr *obj);
 
+// GNU 扩展, 将 __attribute__((...)) 转换为 LLVM 中的属性, 可以重复调用
+void AddGNUAttributes(llvm::GlobalObject *value, const Attributes &attrs,
+                      bool is_definition);
+void AddGNUAttributes(llvm::Function *func, const Type *func_type,
+                      bool is_definition);
+
 const llvm::fltSemantics &GetFloatTypeSemantics(llvm::Type *type);
 
 llvm::Type *GetBitFieldSpace(std::int8_t width);
@@ -6,11 +6,23 @@
 
 #include <cassert>
 #include <cstring>
+#include <utility>
 
 #include <fmt/format.h>
 
+#include "source_manager.h"
+
 namespace kcc {
 
+Location::Location(std::string file_name, const char* content,
+                   std::size_t line_begin, std::int32_t row,
+                   std::int32_t column)
+    : file_name_{std::move(file_name)},
+      content_{content},
+      line_begin_{line_begin},
+      row_{row},
+      column_{column} {}
+
 void Location::SetFileName(const std::string& file_name) {
   assert(!std::empty(file_name));
   file_name_ = file_name;
@@ -86,4 +98,20 @@ std::int32_t Location::GetRow() const { return row_; }
 
 std::int32_t Location::GetColumn() const { return column_; }
 
+SourceLocation::SourceLocation(std::uint32_t offset) : offset_{offset} {}
+
+std::uint32_t SourceLocation::GetOffset() const { return offset_; }
+
+Location SourceLocation::Decode() const { return Sources->Decode(offset_); }
+
+const std::string& SourceLocation::GetFileName() const {
+  return Sources->GetFileName(Sources->GetFileId(offset_));
+}
+
+std::int32_t SourceLocation::GetRow() const { return Sources->GetRow(offset_); }
+
+std::int32_t SourceLocation::GetColumn() const {
+  return Sources->GetColumn(offset_);
+}
+
 }  // namespace kcc
@@ -12,6 +12,10 @@ namespace kcc {
 
 class Location {
  public:
+  Location() = default;
+  Location(std::string file_name, const char *content, std::size_t line_begin,
+           std::int32_t row, std::int32_t column);
+
   void SetFileName(const std::string &file_name);
   void SetContent(const char *content);
   void NextRow(std::size_t line_begin);
@@ -30,7 +34,7 @@ class Location {
 
  private:
   std::string file_name_;
-  const char *content_;
+  const char *content_{};
 
   std::size_t line_begin_{};
   std::int32_t row_{1};
@@ -40,4 +44,22 @@ class Location {
   std::int32_t column_backup_{};
 };
 
+// 32 位的位置编码, 即在预处理后的代码中的偏移量
+// 只在需要时通过 SourceManager 解码为 Location
+class SourceLocation {
+ public:
+  SourceLocation() = default;
+  explicit SourceLocation(std::uint32_t offset);
+
+  std::uint32_t GetOffset() const;
+  Location Decode() const;
+
+  const std::string &GetFileName() const;
+  std::int32_t GetRow() const;
+  std::int32_t GetColumn() const;
+
+ private:
+  std::uint32_t offset_{};
+};
+
 }  // namespace kcc
@@ -2,20 +2,28 @@
 // Created by kaiser on 2019/10/30.
 //
 
-#include <unistd.h>
-#include <wait.h>
-
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <system_error>
+#include <thread>
 #include <utility>
+#include <vector>
+
+#include <fmt/color.h>
+#include <fmt/format.h>
 
+#include <llvm/IR/PassTimingInfo.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
 
+#include "ast_context.h"
 #include "code_gen.h"
 #include "cpp.h"
 #include "error.h"
@@ -26,11 +34,20 @@
 #include "obj_gen.h"
 #include "opt.h"
 #include "parse.h"
+#include "stats.h"
+#include "time_trace.h"
 #include "util.h"
 
 using namespace kcc;
 
-void RunKcc(const std::string &file_name);
+struct CompileResult {
+  bool success{};
+  std::string diagnostics;
+};
+
+bool RunJobs();
+CompileResult CompileFile(std::size_t index);
+void RunKcc(const std::string &file_name, std::size_t index);
 
 #ifdef DEV
 #include <cstdlib>
@@ -42,6 +59,7 @@ int main(int argc, char *argv[]) try {
 
   InitCommandLine(argc, argv);
   CommandLineCheck();
+  llvm::TimePassesIsEnabled = TimeReport;
 
 #ifdef DEV
   if (DevMode) {
@@ -51,29 +69,22 @@ int main(int argc, char *argv[]) try {
 #endif
 
   TimingStart();
-  for (const auto &item : InputFilePaths) {
-    auto pid{fork()};
-    if (pid < 0) {
-      Error("fork error");
-    } else if (pid == 0) {
-      RunKcc(item);
-      PrintWarnings();
-      return EXIT_SUCCESS;
-    }
-  }
+  auto success{RunJobs()};
 
-  std::int32_t status{};
+  // 代码生成仍使用旧的 PassManager, 其计时与优化的计时都在所有翻译单元
+  // 完成后统一输出
+  if (TimeReport) {
+    PrintPassTimings();
+    llvm::reportAndResetTimings();
+  }
 
-  while (waitpid(-1, &status, 0) > 0) {
-    // WIFEXITED 如果通过调用 exit 或者 return 正常终止, 则为真
-    // WEXITSTATUS 返回一个正常终止的子进程的退出状态, 只有在
-    // WIFEXITED 为真时才会定义
-    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
-      Error("Compile Error");
-    }
+  if (!success) {
+    Error("Compile Error");
   }
 
   if (DoNotLink()) {
+    PrintTimeTraceSummary();
+    PrintStatsReport();
     TimingEnd("Timing");
     return EXIT_SUCCESS;
   }
@@ -82,26 +93,100 @@ int main(int argc, char *argv[]) try {
     OutputFilePath = "a.out";
   }
 
-  if (!Link()) {
-    RemoveFiles();
+  TimeTraceBegin();
+  auto linked{Link()};
+  TimeTraceEnd(OutputFilePath, GetFileName(OutputFilePath, ".json"));
+  PrintWarnings();
+
+  RemoveFiles();
+  if (!linked) {
     Error("Link Failed");
-  } else {
-    RemoveFiles();
   }
 
+  PrintTimeTraceSummary();
+  PrintStatsReport();
   TimingEnd("Timing");
 } catch (const std::exception &error) {
   Error("{}", error.what());
 }
 
-void RunKcc(const std::string &file_name) {
+// 最多同时运行 Jobs 个编译线程, 每个线程依次编译多个翻译单元,
+// 每个翻译单元的编译上下文在编译结束后释放, 因此内存占用只与线程数有关,
+// 而 TargetMachine 和 pass pipeline 在线程中只构建一次. 错误和警告按输入
+// 文件的顺序输出
+bool RunJobs() {
+  auto size{std::size(InputFilePaths)};
+  std::vector<CompileResult> results(size);
+
+  auto jobs{static_cast<std::size_t>(Jobs)};
+  if (jobs == 0) {
+    jobs = std::max(std::thread::hardware_concurrency(), 1U);
+  }
+  jobs = std::min(jobs, size);
+
+  std::atomic<std::size_t> next{};
+  std::vector<std::thread> workers;
+
+  for (std::size_t i{}; i < jobs; ++i) {
+    workers.emplace_back([&] {
+      for (auto index{next++}; index < size; index = next++) {
+        results[index] = CompileFile(index);
+      }
+      CollectPassTimings();
+    });
+  }
+
+  for (auto &&worker : workers) {
+    worker.join();
+  }
+
+  bool success{true};
+  for (const auto &[ok, diagnostics] : results) {
+    fmt::print(fmt("{}"), diagnostics);
+    success = success && ok;
+  }
+
+  return success;
+}
+
+CompileResult CompileFile(std::size_t index) {
+  const auto &file_name{InputFilePaths[index]};
+  InCompileThread = true;
+  TimeTraceBegin();
+  StatsBegin();
+
+  CompileResult result;
+  std::string error;
+  // 统计信息仍需要访问 AST, 在其之后释放
+  std::optional<CompilationContext> context;
+
+  try {
+    context.emplace();
+    RunKcc(file_name, index);
+    result.success = true;
+  } catch (const CompileError &) {
+  } catch (const std::exception &err) {
+    error = fmt::format(fmt::fg(fmt::terminal_color::red), fmt("error: {}\n"),
+                        err.what());
+  }
+
+  TimeTraceEnd(file_name, GetFileName(file_name, ".json"));
+  StatsEnd(file_name);
+  context.reset();
+
+  result.diagnostics = CppDiagnostics.str() + error + TakeDiagnostics();
+  return result;
+}
+
+void RunKcc(const std::string &file_name, std::size_t index) {
   Preprocessor preprocessor;
   preprocessor.AddIncludePaths(IncludePaths);
   preprocessor.AddMacroDefinitions(MacroDefines);
 
-  auto preprocessed_code{preprocessor.Cpp(file_name)};
-
   if (Preprocess) {
+    TimeTraceScope scope{Phase::kPreprocess};
+    auto preprocessed_code{preprocessor.Cpp(file_name)};
+
     if (std::empty(OutputFilePath)) {
       std::cout << preprocessed_code << '\n' << std::endl;
     } else {
@@ -111,10 +196,17 @@ void RunKcc(const std::string &file_name) {
     return;
   }
 
-  Scanner scanner{std::move(preprocessed_code)};
-  auto tokens{scanner.Tokenize()};
-
   if (EmitTokens) {
+    std::string preprocessed_code;
+    {
+      TimeTraceScope scope{Phase::kPreprocess};
+      preprocessed_code = preprocessor.Cpp(file_name);
+    }
+
+    TimeTraceScope scope{Phase::kTokenize};
+    Scanner scanner{std::move(preprocessed_code)};
+    auto tokens{scanner.Tokenize()};
+
     if (std::empty(OutputFilePath)) {
       for (const auto &tok : tokens) {
         if (tok.GetLoc().GetFileName() == file_name) {
@@ -134,10 +226,17 @@ void RunKcc(const std::string &file_name) {
     return;
   }
 
-  Parser parser{std::move(tokens)};
-  auto unit{parser.ParseTranslationUnit()};
+  preprocessor.EnterMainFile(file_name);
+  Parser parser{&preprocessor};
 
   if (EmitAST) {
+    auto unit{parser.ParseTranslationUnit()};
+
+    // Parser 会报告翻译单元中的所有错误, 有错误时不再生成代码
+    if (HasErrors()) {
+      throw CompileError{};
+    }
+
     JsonGen json_gen{file_name};
     if (std::empty(OutputFilePath)) {
       json_gen.GenJson(unit, GetFileName(file_name, ".html"));
@@ -147,9 +246,26 @@ void RunKcc(const std::string &file_name) {
     return;
   }
 
+  // 每解析完一个外部声明就生成代码, 之后释放函数体的 AST,
+  // 因此内存占用只与最大的函数和尚未被引用的推迟生成的函数有关.
+  // 出现错误后只继续解析以报告所有错误
   CodeGen code_gen;
-  code_gen.GenCode(unit);
+  while (auto ext_decl{parser.ParseNextExtDecl()}) {
+    if (!HasErrors()) {
+      code_gen.GenCode(ext_decl, &FuncBodyCtx);
+    }
+    FuncBodyCtx.Clear();
+  }
+
+  if (HasErrors()) {
+    throw CompileError{};
+  }
+
+  code_gen.Finish();
+  RecordPhase("CodeGen");
+
   Optimization();
+  RecordPhase("Optimization");
 
   if (EmitLLVM) {
     std::error_code error_code;
@@ -183,7 +299,11 @@ void RunKcc(const std::string &file_name) {
     return;
   }
 
-  ObjGen(GetObjFile(file_name));
+  if (const auto &obj_files{GetObjFiles(index)}; std::size(obj_files) > 1) {
+    ParallelObjGen(obj_files);
+  } else {
+    ObjGen(obj_files.front());
+  }
 }
 
 #ifdef DEV
@@ -232,11 +352,13 @@ void Run(const std::string &file) {
     Error("emit asm fail");
   }
 
-  ObjGen(GetObjFile(file));
+  ObjGen(GetObjFiles(0).front());
 }
 
 void RunDev() {
   assert(std::size(InputFilePaths) == 1);
+  CompilationContext context;
+
   auto file{InputFilePaths.front()};
   Run(file);
 
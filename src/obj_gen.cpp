@@ -4,19 +4,35 @@
 
 #include "obj_gen.h"
 
+#include <cstddef>
+#include <memory>
 #include <system_error>
+#include <thread>
+#include <utility>
 
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Bitcode/BitcodeWriterPass.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Support/Error.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO/ThinLTOBitcodeWriter.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
 
 #include "error.h"
 #include "llvm_common.h"
+#include "time_trace.h"
+#include "util.h"
 
 namespace kcc {
 
 void ObjGen(const std::string& obj_file,
             llvm::TargetMachine::CodeGenFileType file_type) {
+  TimeTraceScope scope{Phase::kObjGen};
+
   std::error_code error_code;
   llvm::raw_fd_ostream dest{obj_file, error_code, llvm::sys::fs::F_None};
 
@@ -27,7 +43,17 @@ void ObjGen(const std::string& obj_file,
   // 定义 PassManager 以生成目标代码
   llvm::legacy::PassManager pass;
 
-  if (TargetMachine->addPassesToEmitFile(pass, dest, nullptr, file_type)) {
+  // -flto 时目标文件中是 bitcode, 由链接器统一优化和生成代码
+  auto is_obj{file_type ==
+              llvm::TargetMachine::CodeGenFileType::CGFT_ObjectFile};
+
+  if (is_obj && LTO == LTOKind::kThin) {
+    // 同时写入 ThinLTO 需要的模块摘要
+    pass.add(llvm::createWriteThinLTOBitcodePass(dest));
+  } else if (is_obj && LTO == LTOKind::kFull) {
+    pass.add(llvm::createBitcodeWriterPass(dest));
+  } else if (TargetMachine->addPassesToEmitFile(pass, dest, nullptr,
+                                                file_type)) {
     Error("The TargetMachine can't emit a file of this type");
   }
 
@@ -35,4 +61,65 @@ void ObjGen(const std::string& obj_file,
   dest.flush();
 }
 
+// 各部分共享同一个 LLVMContext, 不能在多个线程中同时使用,
+// 因此先序列化为 bitcode, 再在各个线程自己的 LLVMContext 中读取
+void ParallelObjGen(const std::vector<std::string>& obj_files) {
+  auto size{std::size(obj_files)};
+
+  std::vector<llvm::SmallString<0>> bitcodes;
+  bitcodes.reserve(size);
+
+  // 保留局部符号 (字符串常量, static 函数与变量), 否则它们会被改为
+  // external hidden, 多个翻译单元链接时产生重复定义
+  llvm::SplitModule(
+      std::move(Module), size,
+      [&](std::unique_ptr<llvm::Module> part) {
+        auto& bitcode{bitcodes.emplace_back()};
+        llvm::raw_svector_ostream os{bitcode};
+        llvm::WriteBitcodeToFile(*part, os);
+      },
+      true);
+
+  std::vector<std::string> diagnostics(size);
+  std::vector<std::thread> workers;
+
+  for (std::size_t i{}; i < std::size(bitcodes); ++i) {
+    workers.emplace_back([&, i] {
+      InCompileThread = true;
+      llvm::LLVMContext context;
+
+      try {
+        auto part{llvm::parseBitcodeFile(
+            llvm::MemoryBufferRef{bitcodes[i], obj_files[i]}, context)};
+        if (!part) {
+          Error("{}", llvm::toString(part.takeError()));
+        }
+
+        Module = std::move(*part);
+        InitTargetMachine();
+        ObjGen(obj_files[i]);
+      } catch (const CompileError&) {
+      }
+
+      // 引用 context, 先于它释放
+      Module.reset();
+      diagnostics[i] = TakeDiagnostics();
+    });
+  }
+
+  for (auto&& worker : workers) {
+    worker.join();
+  }
+
+  // 按划分的顺序报告错误
+  std::string error;
+  for (const auto& item : diagnostics) {
+    error += item;
+  }
+
+  if (!std::empty(error)) {
+    ReportError(error);
+  }
+}
+
 }  // namespace kcc
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include <llvm/Target/TargetMachine.h>
 
@@ -14,4 +15,7 @@ void ObjGen(const std::string &obj_file,
             llvm::TargetMachine::CodeGenFileType file_type =
                 llvm::TargetMachine::CodeGenFileType::CGFT_ObjectFile);
 
+// 将模块划分为 std::size(obj_files) 个部分, 在多个线程中同时生成目标文件
+void ParallelObjGen(const std::vector<std::string> &obj_files);
+
 }  // namespace kcc
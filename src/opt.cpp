@@ -4,132 +4,172 @@
 
 #include "opt.h"
 
-#include <cstdint>
+#include <cassert>
 #include <memory>
+#include <mutex>
+#include <string>
 
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Analysis/AliasAnalysis.h>
 #include <llvm/Analysis/TargetLibraryInfo.h>
-#include <llvm/Analysis/TargetTransformInfo.h>
-#include <llvm/CodeGen/TargetPassConfig.h>
-#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/PassInstrumentation.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/IR/PassTimingInfo.h>
 #include <llvm/IR/Verifier.h>
-#include <llvm/InitializePasses.h>
-#include <llvm/PassRegistry.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
-#include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/IPO/AlwaysInliner.h>
-#include <llvm/Transforms/IPO/PassManagerBuilder.h>
 
 #include "llvm_common.h"
+#include "time_trace.h"
 #include "util.h"
 
 namespace kcc {
 
-void AddOptimizationPasses(llvm::legacy::PassManagerBase &mpm,
-                           llvm::legacy::FunctionPassManager &fpm,
-                           llvm::TargetMachine *tm, std::uint32_t opt_level) {
-  fpm.add(llvm::createVerifierPass());
+namespace {
+
+llvm::PassBuilder::OptimizationLevel GetOptimizationLevel() {
+  switch (OptimizationLevel.getValue()) {
+    case OptLevel::kO1:
+      return llvm::PassBuilder::O1;
+    case OptLevel::kO2:
+      return llvm::PassBuilder::O2;
+    case OptLevel::kO3:
+      return llvm::PassBuilder::O3;
+    default:
+      assert(false);
+      return llvm::PassBuilder::O0;
+  }
+}
 
-  llvm::PassManagerBuilder builder;
-  builder.OptLevel = opt_level;
-  builder.SizeLevel = 0;
+llvm::PipelineTuningOptions GetTuningOptions() {
+  llvm::PipelineTuningOptions options;
 
-  if (opt_level > 1) {
-    builder.Inliner = llvm::createFunctionInliningPass(opt_level, 0, false);
-  } else {
-    builder.Inliner = llvm::createAlwaysInlinerLegacyPass();
-  }
+  options.LoopUnrolling = true;
+  options.LoopVectorization = OptimizationLevel > OptLevel::kO1;
+  options.SLPVectorization = OptimizationLevel > OptLevel::kO1;
 
-  builder.DisableUnrollLoops = false;
+  return options;
+}
 
-  if (builder.LoopVectorize) {
-    builder.LoopVectorize = (opt_level > 1);
+// 每个编译线程有自己的 TargetMachine, 因此 PassBuilder 和 pipeline
+// 在线程中只构建一次, 之后优化的模块直接复用
+// -flto 时只运行链接前的 pipeline, 其余的 pass 在链接时由 lld 运行
+// -O0 时只内联 always_inline 的函数
+class PassPipeline {
+ public:
+  PassPipeline();
+
+  void Run(llvm::Module &module);
+  // 线程中所有模块累计的 pass 耗时
+  std::string TakeTimeReport();
+
+ private:
+  llvm::PassInstrumentationCallbacks callbacks_;
+  // -ftime-report, 记录每个 pass 的耗时
+  std::string time_report_;
+  llvm::raw_string_ostream time_report_os_{time_report_};
+  llvm::TimePassesHandler time_passes_{TimeReport};
+  llvm::PassBuilder builder_;
+
+  llvm::LoopAnalysisManager loop_analysis_;
+  llvm::FunctionAnalysisManager func_analysis_;
+  llvm::CGSCCAnalysisManager cgscc_analysis_;
+  llvm::ModuleAnalysisManager module_analysis_;
+
+  llvm::ModulePassManager passes_;
+};
+
+PassPipeline::PassPipeline()
+    : builder_{TargetMachine.get(), GetTuningOptions(), llvm::None,
+               &callbacks_} {
+  time_passes_.setOutStream(time_report_os_);
+  time_passes_.registerCallbacks(callbacks_);
+
+  // 需要在 registerFunctionAnalyses 之前注册, 否则使用默认的空实现
+  func_analysis_.registerPass(
+      [&] { return builder_.buildDefaultAAPipeline(); });
+
+  llvm::TargetLibraryInfoImpl tlii{TargetMachine->getTargetTriple()};
+  func_analysis_.registerPass(
+      [=] { return llvm::TargetLibraryAnalysis{tlii}; });
+
+  builder_.registerModuleAnalyses(module_analysis_);
+  builder_.registerCGSCCAnalyses(cgscc_analysis_);
+  builder_.registerFunctionAnalyses(func_analysis_);
+  builder_.registerLoopAnalyses(loop_analysis_);
+  builder_.crossRegisterProxies(loop_analysis_, func_analysis_,
+                                cgscc_analysis_, module_analysis_);
+
+  passes_.addPass(llvm::VerifierPass{});
+
+  if (OptimizationLevel == OptLevel::kO0) {
+    // 与 clang 相同, 不插入 lifetime 标记
+    passes_.addPass(llvm::AlwaysInlinerPass{false});
+  } else if (LTO == LTOKind::kThin) {
+    passes_.addPass(
+        builder_.buildThinLTOPreLinkDefaultPipeline(GetOptimizationLevel()));
+  } else if (LTO == LTOKind::kFull) {
+    passes_.addPass(
+        builder_.buildLTOPreLinkDefaultPipeline(GetOptimizationLevel()));
+  } else {
+    passes_.addPass(
+        builder_.buildPerModuleDefaultPipeline(GetOptimizationLevel()));
   }
 
-  builder.SLPVectorize = (opt_level > 1);
+  passes_.addPass(llvm::VerifierPass{});
+}
 
-  tm->adjustPassManager(builder);
+void PassPipeline::Run(llvm::Module &module) {
+  passes_.run(module, module_analysis_);
 
-  builder.populateFunctionPassManager(fpm);
-  builder.populateModulePassManager(mpm);
+  // 分析的结果与模块绑定, 复用前清除
+  loop_analysis_.clear();
+  func_analysis_.clear();
+  cgscc_analysis_.clear();
+  module_analysis_.clear();
 }
 
-void AddStandardLinkPasses(llvm::legacy::PassManagerBase &pm) {
-  llvm::PassManagerBuilder builder;
-  builder.VerifyInput = true;
+std::string PassPipeline::TakeTimeReport() {
+  time_passes_.print();
+  time_report_os_.flush();
 
-  builder.Inliner = llvm::createFunctionInliningPass();
-  builder.populateLTOPassManager(pm);
+  auto report{std::move(time_report_)};
+  time_report_.clear();
+  return report;
 }
 
+thread_local std::unique_ptr<PassPipeline> Pipeline;
+
+std::mutex TimeReportMutex;
+std::string TimeReports;
+
+}  // namespace
+
 void Optimization() {
-  auto level{static_cast<std::int32_t>(OptimizationLevel.getValue())};
-
-  if (level != 0) {
-    llvm::PassRegistry &registry{*llvm::PassRegistry::getPassRegistry()};
-
-    llvm::initializeCore(registry);
-    llvm::initializeCoroutines(registry);
-    llvm::initializeScalarOpts(registry);
-    llvm::initializeObjCARCOpts(registry);
-    llvm::initializeVectorization(registry);
-    llvm::initializeIPO(registry);
-    llvm::initializeAnalysis(registry);
-    llvm::initializeTransformUtils(registry);
-    llvm::initializeInstCombine(registry);
-    llvm::initializeAggressiveInstCombine(registry);
-    llvm::initializeInstrumentation(registry);
-    llvm::initializeTarget(registry);
-    llvm::initializeExpandMemCmpPassPass(registry);
-    llvm::initializeScalarizeMaskedMemIntrinPass(registry);
-    llvm::initializeCodeGenPreparePass(registry);
-    llvm::initializeAtomicExpandPass(registry);
-    llvm::initializeRewriteSymbolsLegacyPassPass(registry);
-    llvm::initializeWinEHPreparePass(registry);
-    llvm::initializeDwarfEHPreparePass(registry);
-    llvm::initializeSafeStackLegacyPassPass(registry);
-    llvm::initializeSjLjEHPreparePass(registry);
-    llvm::initializeStackProtectorPass(registry);
-    llvm::initializePreISelIntrinsicLoweringLegacyPassPass(registry);
-    llvm::initializeGlobalMergePass(registry);
-    llvm::initializeIndirectBrExpandPassPass(registry);
-    llvm::initializeInterleavedLoadCombinePass(registry);
-    llvm::initializeInterleavedAccessPass(registry);
-    llvm::initializeEntryExitInstrumenterPass(registry);
-    llvm::initializePostInlineEntryExitInstrumenterPass(registry);
-    llvm::initializeUnreachableBlockElimLegacyPassPass(registry);
-    llvm::initializeExpandReductionsPass(registry);
-    llvm::initializeWasmEHPreparePass(registry);
-    llvm::initializeWriteBitcodePassPass(registry);
-    llvm::initializeHardwareLoopsPass(registry);
-
-    llvm::legacy::PassManager passes;
-
-    llvm::TargetLibraryInfoImpl tlti(llvm::Triple{Module->getTargetTriple()});
-    passes.add(new llvm::TargetLibraryInfoWrapperPass(tlti));
-    passes.add(llvm::createTargetTransformInfoWrapperPass(
-        TargetMachine->getTargetIRAnalysis()));
-
-    auto fp_passes{
-        std::make_unique<llvm::legacy::FunctionPassManager>(Module.get())};
-
-    fp_passes->add(llvm::createTargetTransformInfoWrapperPass(
-        TargetMachine->getTargetIRAnalysis()));
-
-    auto &ltm{static_cast<llvm::LLVMTargetMachine &>(*TargetMachine)};
-    passes.add(ltm.createPassConfig(passes));
-
-    AddStandardLinkPasses(passes);
-    AddOptimizationPasses(passes, *fp_passes, TargetMachine.get(), level);
-
-    fp_passes->doInitialization();
-    for (auto &f : *Module) {
-      fp_passes->run(f);
-    }
-    fp_passes->doFinalization();
-
-    passes.add(llvm::createVerifierPass());
-    passes.run(*Module);
+  TimeTraceScope scope{Phase::kOptimization};
+  if (!Pipeline) {
+    Pipeline = std::make_unique<PassPipeline>();
+  }
+  Pipeline->Run(*Module);
+}
+
+void CollectPassTimings() {
+  if (!TimeReport || !Pipeline) {
+    return;
   }
+
+  auto report{Pipeline->TakeTimeReport()};
+  std::lock_guard lock{TimeReportMutex};
+  TimeReports += report;
+}
+
+void PrintPassTimings() {
+  std::lock_guard lock{TimeReportMutex};
+  llvm::errs() << TimeReports;
+  TimeReports.clear();
 }
 
 }  // namespace kcc
@@ -8,4 +8,9 @@ namespace kcc {
 
 void Optimization();
 
+// -ftime-report, 编译线程结束前收集其中所有翻译单元的 pass 耗时,
+// 所有翻译单元编译完成后再统一输出
+void CollectPassTimings();
+void PrintPassTimings();
+
 }  // namespace kcc
@@ -9,32 +9,98 @@
 #include <limits>
 
 #include "calc.h"
+#include "cpp.h"
 #include "error.h"
-#include "llvm_common.h"
+#include "time_trace.h"
 
 namespace kcc {
 
-Parser::Parser(std::vector<Token> tokens) : tokens_{std::move(tokens)} {
-  Location loc;
-  loc.SetFileName(Module->getSourceFileName());
-  unit_ = MakeAstNode<TranslationUnit>(loc);
+Parser::Parser(std::vector<Token> tokens)
+    : tokens_(std::begin(tokens), std::end(tokens)) {
+  unit_ = MakeAstNode<TranslationUnit>(SourceLocation{});
+
+  AddBuiltin();
+}
+
+Parser::Parser(Preprocessor* preprocessor) : preprocessor_{preprocessor} {
+  unit_ = MakeAstNode<TranslationUnit>(SourceLocation{});
 
   AddBuiltin();
 }
 
 TranslationUnit* Parser::ParseTranslationUnit() {
-  while (HasNext()) {
-    unit_->AddExtDecl(ParseExternalDecl());
+  while (auto ext_decl{ParseNextExtDecl()}) {
+    unit_->AddExtDecl(ext_decl);
   }
 
   return unit_;
 }
 
+ExtDecl* Parser::ParseNextExtDecl() {
+  TimeTraceScope scope{Phase::kParse};
+
+  // 之前的外部声明已经解析完毕, AST 中不会引用 token, 可以释放
+  tokens_.erase(std::begin(tokens_), std::begin(tokens_) + index_);
+  index_ = 0;
+
+  auto file_scope{scope_};
+  auto begin{index_};
+  bool recovering{false};
+
+  while (true) {
+    try {
+      // 恢复时获取 token 也可能出错, 因此同样放在 try 中
+      if (recovering) {
+        recovering = false;
+        Synchronize(begin);
+        // 不属于任何块的 '}'
+        Try(Tag::kRightBrace);
+      }
+
+      if (!HasNext()) {
+        return nullptr;
+      }
+
+      begin = index_;
+      // _Static_assert / e.g. int; 时返回 nullptr
+      if (auto ext_decl{ParseExternalDecl()}) {
+        return ext_decl;
+      }
+    } catch (const CompileError&) {
+      if (ErrorLimitReached()) {
+        throw;
+      }
+
+      scope_ = file_scope;
+      func_def_ = nullptr;
+      InFuncBody = false;
+      labels_.clear();
+      gotos_.clear();
+      compound_stmt_ = {};
+      indexs_.clear();
+
+      recovering = true;
+    }
+  }
+}
+
 bool Parser::HasNext() { return !Peek().TagIs(Tag::kEof); }
 
-const Token& Parser::Peek() { return tokens_[index_]; }
+const Token& Parser::Peek() {
+  // 到达 kEof 后不再获取
+  while (preprocessor_ && index_ >= std::size(tokens_) &&
+         (std::empty(tokens_) || !tokens_.back().IsEof())) {
+    tokens_.push_back(preprocessor_->Lex());
+  }
+
+  return tokens_[index_];
+}
 
-const Token& Parser::Next() { return tokens_[index_++]; }
+const Token& Parser::Next() {
+  auto& token{Peek()};
+  ++index_;
+  return token;
+}
 
 void Parser::PutBack() {
   assert(index_ > 0);
@@ -60,6 +126,44 @@ const Token& Parser::Expect(Tag tag) {
   }
 }
 
+// 出错后跳过当前语句或声明的剩余部分, 直到块外的 ';' 或使块闭合的 '}'
+// begin 为该语句或声明的起始位置, 用于计算出错时所在的块的深度
+void Parser::Synchronize(std::size_t begin) {
+  std::int32_t depth{};
+  for (auto i{begin}; i < index_; ++i) {
+    if (tokens_[i].TagIs(Tag::kLeftBrace)) {
+      ++depth;
+    } else if (tokens_[i].TagIs(Tag::kRightBrace)) {
+      --depth;
+    }
+  }
+  depth = std::max(depth, 0);
+
+  while (HasNext()) {
+    if (Test(Tag::kLeftBrace)) {
+      ++depth;
+    } else if (Test(Tag::kRightBrace)) {
+      // 属于外层的块, 由调用者处理
+      if (depth == 0) {
+        return;
+      }
+
+      Next();
+      if (--depth == 0) {
+        // e.g. struct A { ... };
+        Try(Tag::kSemicolon);
+        return;
+      }
+      continue;
+    } else if (Test(Tag::kSemicolon) && depth == 0) {
+      Next();
+      return;
+    }
+
+    Next();
+  }
+}
+
 void Parser::EnterBlock(Type* func_type) {
   scope_ = Scope::Get(scope_, kBlock);
 
@@ -149,7 +253,8 @@ auto Parser::GetStructDesignator(Type* type, const std::string& name)
 Declaration* Parser::MakeDeclaration(const Token& token, QualType type,
                                      std::uint32_t storage_class_spec,
                                      std::uint32_t func_spec,
-                                     std::int32_t align) {
+                                     std::int32_t align,
+                                     const Attributes& attrs) {
   auto name{token.GetIdentifier()};
 
   if (storage_class_spec & kTypedef) {
@@ -201,6 +306,10 @@ Declaration* Parser::MakeDeclaration(const Token& token, QualType type,
     linkage = Linkage::kNone;
   }
 
+  if ((attrs.attr_spec & kAttrWeak) && linkage != Linkage::kExternal) {
+    Error(token, "weak declaration of '{}' must be public", name);
+  }
+
   auto ident{scope_->FindUsualInCurrScope(name)};
   //有链接对象(外部或内部)的声明可以重复
   if (ident) {
@@ -230,6 +339,7 @@ Declaration* Parser::MakeDeclaration(const Token& token, QualType type,
       if (!(storage_class_spec & kExtern)) {
         obj->SetStorageClassSpec(obj->GetStorageClassSpec() & ~kExtern);
       }
+      obj->AddAttrs(attrs);
 
       if (!ident->GetType()->IsComplete() && type->IsComplete()) {
         ident->ToObjectExpr()->SetType(type.GetType());
@@ -255,6 +365,7 @@ Declaration* Parser::MakeDeclaration(const Token& token, QualType type,
         if (!ident->GetType()->IsComplete() && type->IsComplete()) {
           ident->ToObjectExpr()->SetType(type.GetType());
         }
+        ident->ToObjectExpr()->AddAttrs(attrs);
 
         auto decl{ident->ToObjectExpr()->GetDecl()};
         assert(decl != nullptr);
@@ -268,9 +379,31 @@ Declaration* Parser::MakeDeclaration(const Token& token, QualType type,
       Error(token, "'_Alignas' attribute applies to func");
     }
 
+    // 函数类型可能来自 typedef, 被多个声明共享, 复制一份再设置
+    // 函数说明符, 名字和属性, e.g. typedef int fn_t(int); fn_t f, g;
+    type = FunctionType::Get(type->FuncGetReturnType(), type->FuncGetParams(),
+                             type->FuncIsVarArgs());
     type->FuncSetFuncSpec(func_spec);
     type->FuncSetName(name);
 
+    // 合并之前的声明中的属性
+    Attributes func_attrs;
+    if (ident && ident->GetType()->IsFunctionTy()) {
+      func_attrs = ident->GetType()->FuncGetAttrs();
+    }
+    func_attrs.Merge(attrs);
+    if (func_spec & kNoreturn) {
+      func_attrs.attr_spec |= kAttrNoreturn;
+    }
+    type->FuncSetAttrs(func_attrs);
+
+    // gnu_inline 时 extern 的含义相反
+    if (linkage == Linkage::kExternal && (func_spec & kInline)) {
+      auto is_extern{(storage_class_spec & kExtern) != 0};
+      type->FuncSetInlineDefinition(
+          is_extern == ((func_attrs.attr_spec & kAttrGnuInline) != 0));
+    }
+
     ident = MakeAstNode<IdentifierExpr>(token, name, type, linkage, false);
     scope_->InsertUsual(name, ident);
 
@@ -292,6 +425,7 @@ Declaration* Parser::MakeDeclaration(const Token& token, QualType type,
       }
       obj->SetAlign(align);
     }
+    obj->AddAttrs(attrs);
 
     scope_->InsertUsual(obj);
     auto decl{MakeAstNode<Declaration>(token, obj)};
@@ -335,7 +469,9 @@ FuncDef* Parser::ParseFuncDef(const Declaration* decl) {
   }
 
   EnterFunc(ident);
+  InFuncBody = true;
   func_def_->SetBody(ParseCompoundStmt(ident->GetType()));
+  InFuncBody = false;
   auto ret{func_def_};
   ExitFunc();
 
@@ -381,21 +517,21 @@ FuncDef* Parser::ParseFuncDef(const Declaration* decl) {
 //  expression
 //  expression-list ',' expression
 // 可以有多个
-void Parser::TryParseAttributeSpec() {
+void Parser::TryParseAttributeSpec(Attributes* attrs) {
   while (Try(Tag::kAttribute)) {
     Expect(Tag::kLeftParen);
     Expect(Tag::kLeftParen);
 
-    ParseAttributeList();
+    ParseAttributeList(attrs);
 
     Expect(Tag::kRightParen);
     Expect(Tag::kRightParen);
   }
 }
 
-void Parser::ParseAttributeList() {
+void Parser::ParseAttributeList(Attributes* attrs) {
   while (!Test(Tag::kRightParen)) {
-    ParseAttribute();
+    ParseAttribute(attrs);
 
     if (!Test(Tag::kRightParen)) {
       Expect(Tag::kComma);
@@ -403,12 +539,83 @@ void Parser::ParseAttributeList() {
   }
 }
 
-void Parser::ParseAttribute() {
-  Expect(Tag::kIdentifier);
+// 其他的属性只做语法分析
+void Parser::ParseAttribute(Attributes* attrs) {
+  static const std::unordered_map<std::string, std::uint32_t> attr_specs{
+      {"always_inline", kAttrAlwaysInline},
+      {"noinline", kAttrNoInline},
+      {"hot", kAttrHot},
+      {"cold", kAttrCold},
+      {"pure", kAttrPure},
+      {"const", kAttrConst},
+      {"malloc", kAttrMalloc},
+      {"flatten", kAttrFlatten},
+      {"noreturn", kAttrNoreturn},
+      {"used", kAttrUsed},
+      {"unused", kAttrUnused},
+      {"weak", kAttrWeak},
+      {"gnu_inline", kAttrGnuInline}};
+
+  auto tok{Peek()};
+  std::string name;
+
+  // const 是关键字
+  if (Try(Tag::kConst)) {
+    name = "const";
+  } else {
+    name = Expect(Tag::kIdentifier).GetIdentifier();
+  }
 
-  if (Try(Tag::kLeftParen)) {
-    ParseAttributeParamList();
+  // __name__ 与 name 相同
+  if (std::size(name) > 4 && name.compare(0, 2, "__") == 0 &&
+      name.compare(std::size(name) - 2, 2, "__") == 0) {
+    name = name.substr(2, std::size(name) - 4);
+  }
+
+  Attributes attr;
+
+  if (name == "aligned") {
+    // 没有参数时使用目标平台的最大对齐
+    attr.align = 16;
+
+    if (Try(Tag::kLeftParen)) {
+      auto align{ParseInt64Constant()};
+      if (align <= 0 || (align & (align - 1)) != 0) {
+        Error(tok, "requested alignment is not a positive power of 2");
+      }
+      attr.align = static_cast<std::int32_t>(align);
+      Expect(Tag::kRightParen);
+    }
+  } else if (name == "section" || name == "visibility") {
+    Expect(Tag::kLeftParen);
+    auto str{ParseStringLiteral(false)->GetStr()};
     Expect(Tag::kRightParen);
+
+    if (name == "section") {
+      attr.section = str;
+    } else if (str == "default") {
+      attr.visibility = Visibility::kDefault;
+    } else if (str == "hidden" || str == "internal") {
+      // LLVM 中没有 internal, 与 clang 相同当作 hidden
+      attr.visibility = Visibility::kHidden;
+    } else if (str == "protected") {
+      attr.visibility = Visibility::kProtected;
+    } else {
+      Error(tok, "unknown visibility: '{}'", str);
+    }
+  } else {
+    if (auto iter{attr_specs.find(name)}; iter != std::end(attr_specs)) {
+      attr.attr_spec = iter->second;
+    }
+
+    if (Try(Tag::kLeftParen)) {
+      ParseAttributeParamList();
+      Expect(Tag::kRightParen);
+    }
+  }
+
+  if (attrs) {
+    attrs->Merge(attr);
   }
 }
 
@@ -599,40 +806,60 @@ void Parser::AddBuiltin() {
   scope_->InsertUsual(MakeAstNode<IdentifierExpr>(
       loc, "__builtin_alloca", alloca, Linkage::kExternal, false));
 
-  auto popcount{FunctionType::Get(ArithmeticType::Get(kInt), {integer})};
-  popcount->FuncSetName("__builtin_popcount");
-  scope_->InsertUsual(MakeAstNode<IdentifierExpr>(
-      loc, "__builtin_popcount", popcount, Linkage::kExternal, false));
-
-  auto clz{FunctionType::Get(ArithmeticType::Get(kInt), {integer})};
-  clz->FuncSetName("__builtin_clz");
-  scope_->InsertUsual(MakeAstNode<IdentifierExpr>(loc, "__builtin_clz", clz,
-                                                  Linkage::kExternal, false));
-
-  auto ctz{FunctionType::Get(ArithmeticType::Get(kInt), {integer})};
-  ctz->FuncSetName("__builtin_ctz");
-  scope_->InsertUsual(MakeAstNode<IdentifierExpr>(loc, "__builtin_ctz", ctz,
-                                                  Linkage::kExternal, false));
-
-  auto long_integer{
-      MakeAstNode<ObjectExpr>(loc, "", ArithmeticType::Get(kLong))};
-  auto expect{FunctionType::Get(ArithmeticType::Get(kLong),
-                                {long_integer, long_integer})};
-  expect->FuncSetName("__builtin_expect");
-  scope_->InsertUsual(MakeAstNode<IdentifierExpr>(
-      loc, "__builtin_expect", expect, Linkage::kExternal, false));
+  // 其余的内置函数只需要名字和类型, 由 CodeGen::MayCallBuiltinFunc 生成代码
+  auto add_builtin{[&](const std::string& name, QualType return_type,
+                       const std::vector<QualType>& param_types,
+                       bool is_var_args = false) {
+    std::vector<ObjectExpr*> params;
+    for (const auto& param_type : param_types) {
+      params.push_back(MakeAstNode<ObjectExpr>(loc, "", param_type));
+    }
 
-  auto float_param{
-      MakeAstNode<ObjectExpr>(loc, "", ArithmeticType::Get(kFloat))};
-  auto isinf_sign{FunctionType::Get(ArithmeticType::Get(kInt), {float_param})};
-  isinf_sign->FuncSetName("__builtin_isinf_sign");
-  scope_->InsertUsual(MakeAstNode<IdentifierExpr>(
-      loc, "__builtin_isinf_sign", isinf_sign, Linkage::kExternal, false));
+    auto type{FunctionType::Get(return_type, params, is_var_args)};
+    type->FuncSetName(name);
+    scope_->InsertUsual(MakeAstNode<IdentifierExpr>(loc, name, type,
+                                                    Linkage::kExternal, false));
+  }};
+
+  auto int_type{ArithmeticType::Get(kInt)};
+  auto uint_type{ArithmeticType::Get(kInt | kUnsigned)};
+  auto long_type{ArithmeticType::Get(kLong)};
+  auto ulong_type{ArithmeticType::Get(kLong | kUnsigned)};
+  auto ullong_type{ArithmeticType::Get(kLongLong | kUnsigned)};
+  auto void_ptr{VoidType::Get()->GetPointerTo()};
+  auto const_void_ptr{PointerType::Get(QualType{VoidType::Get(), kConst})};
+
+  const std::pair<const char*, Type*> bit_types[]{
+      {"", uint_type}, {"l", ulong_type}, {"ll", ullong_type}};
+  for (const auto& [suffix, type] : bit_types) {
+    add_builtin(std::string{"__builtin_popcount"} + suffix, int_type, {type});
+    add_builtin(std::string{"__builtin_clz"} + suffix, int_type, {type});
+    add_builtin(std::string{"__builtin_ctz"} + suffix, int_type, {type});
+  }
 
-  auto isfinite{FunctionType::Get(ArithmeticType::Get(kInt), {float_param})};
-  isfinite->FuncSetName("__builtin_isfinite");
-  scope_->InsertUsual(MakeAstNode<IdentifierExpr>(
-      loc, "__builtin_isfinite", isfinite, Linkage::kExternal, false));
+  add_builtin("__builtin_bswap16", ArithmeticType::Get(kShort | kUnsigned),
+              {ArithmeticType::Get(kShort | kUnsigned)});
+  add_builtin("__builtin_bswap32", uint_type, {uint_type});
+  add_builtin("__builtin_bswap64", ulong_type, {ulong_type});
+
+  add_builtin("__builtin_expect", long_type, {long_type, long_type});
+  add_builtin("__builtin_expect_with_probability", long_type,
+              {long_type, long_type, ArithmeticType::Get(kDouble)});
+
+  add_builtin("__builtin_isinf_sign", int_type, {ArithmeticType::Get(kFloat)});
+  add_builtin("__builtin_isfinite", int_type, {ArithmeticType::Get(kFloat)});
+
+  // __builtin_prefetch(addr, rw = 0, locality = 3)
+  add_builtin("__builtin_prefetch", VoidType::Get(), {const_void_ptr}, true);
+  // __builtin_assume_aligned(ptr, align, offset = 0)
+  add_builtin("__builtin_assume_aligned", void_ptr,
+              {const_void_ptr, ulong_type}, true);
+  add_builtin("__builtin_unreachable", VoidType::Get(), {});
+  add_builtin("__builtin_memcpy", void_ptr,
+              {void_ptr, const_void_ptr, ulong_type});
+  add_builtin("__builtin_memset", void_ptr, {void_ptr, int_type, ulong_type});
+  // 参数可以是任意类型
+  add_builtin("__builtin_constant_p", int_type, {}, true);
 }
 
 }  // namespace kcc
@@ -6,6 +6,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <optional>
 #include <stack>
 #include <string>
@@ -24,10 +25,20 @@
 
 namespace kcc {
 
+class Preprocessor;
+
 class Parser {
+  // 二元运算符的优先级个数, 从 || 到 * / %
+  constexpr static std::int32_t MaxBinaryPrecedence{10};
+
  public:
   explicit Parser(std::vector<Token> tokens);
+  // 需要时才从 preprocessor 中获取 token
+  explicit Parser(Preprocessor* preprocessor);
   TranslationUnit* ParseTranslationUnit();
+  // 流式解析, 每次返回一个外部声明, 到达文件末尾时返回 nullptr
+  // 函数体分配在 FuncBodyCtx 中, 调用者使用完毕后可以释放
+  ExtDecl* ParseNextExtDecl();
 
  private:
   bool HasNext();
@@ -37,6 +48,7 @@ class Parser {
   bool Test(Tag tag);
   bool Try(Tag tag);
   const Token& Expect(Tag tag);
+  void Synchronize(std::size_t begin);
 
   void EnterBlock(Type* func_type = nullptr);
   void ExitBlock();
@@ -52,7 +64,8 @@ class Parser {
       -> decltype(std::begin(type->StructGetMembers()));
   Declaration* MakeDeclaration(const Token& token, QualType type,
                                std::uint32_t storage_class_spec,
-                               std::uint32_t func_spec, std::int32_t align);
+                               std::uint32_t func_spec, std::int32_t align,
+                               const Attributes& attrs);
 
   /*
    * ExtDecl
@@ -66,16 +79,9 @@ class Parser {
   Expr* ParseExpr();
   Expr* ParseAssignExpr();
   Expr* ParseConditionExpr();
-  Expr* ParseLogicalOrExpr();
-  Expr* ParseLogicalAndExpr();
-  Expr* ParseInclusiveOrExpr();
-  Expr* ParseExclusiveOrExpr();
-  Expr* ParseAndExpr();
-  Expr* ParseEqualityExpr();
-  Expr* ParseRelationExpr();
-  Expr* ParseShiftExpr();
-  Expr* ParseAdditiveExpr();
-  Expr* ParseMultiplicativeExpr();
+  Expr* ParseBinaryExpr();
+  // 不是二元运算符时返回 0, 数值越大优先级越高
+  static std::int32_t GetBinaryPrecedence(Tag tag);
   Expr* ParseCastExpr();
   Expr* ParseUnaryExpr();
   Expr* ParseSizeof();
@@ -125,7 +131,8 @@ class Parser {
    * Decl Spec
    */
   QualType ParseDeclSpec(std::uint32_t* storage_class_spec,
-                         std::uint32_t* func_spec, std::int32_t* align);
+                         std::uint32_t* func_spec, std::int32_t* align,
+                         Attributes* attrs);
   Type* ParseStructUnionSpec(bool is_struct);
   void ParseStructDeclList(StructType* type);
   void ParseBitField(StructType* type, const Token& tok, QualType member_type);
@@ -139,10 +146,12 @@ class Parser {
   CompoundStmt* ParseInitDeclaratorList(QualType& base_type,
                                         std::uint32_t storage_class_spec,
                                         std::uint32_t func_spec,
-                                        std::int32_t align);
+                                        std::int32_t align,
+                                        const Attributes& attrs);
   Declaration* ParseInitDeclarator(QualType& base_type,
                                    std::uint32_t storage_class_spec,
-                                   std::uint32_t func_spec, std::int32_t align);
+                                   std::uint32_t func_spec, std::int32_t align,
+                                   Attributes attrs);
   void ParseInitDeclaratorSub(Declaration* decl);
   void ParseDeclarator(Token& tok, QualType& base_type);
   void ParsePointer(QualType& type);
@@ -183,9 +192,9 @@ class Parser {
   /*
    * GNU 扩展
    */
-  void TryParseAttributeSpec();
-  void ParseAttributeList();
-  void ParseAttribute();
+  void TryParseAttributeSpec(Attributes* attrs = nullptr);
+  void ParseAttributeList(Attributes* attrs);
+  void ParseAttribute(Attributes* attrs);
   void ParseAttributeParamList();
   void ParseAttributeExprList();
   void TryParseAsm();
@@ -204,8 +213,10 @@ class Parser {
 
   TranslationUnit* unit_;
 
-  std::vector<Token> tokens_;
+  // 添加元素时引用不会失效
+  std::deque<Token> tokens_;
   decltype(tokens_)::size_type index_{};
+  Preprocessor* preprocessor_{};
 
   FuncDef* func_def_{};
   Scope* scope_{Scope::Get(nullptr, kFile)};
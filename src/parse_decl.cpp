@@ -22,17 +22,19 @@ CompoundStmt* Parser::ParseDecl(bool maybe_func_def) {
   } else {
     std::uint32_t storage_class_spec{}, func_spec{};
     std::int32_t align{};
-    auto base_type{ParseDeclSpec(&storage_class_spec, &func_spec, &align)};
+    Attributes attrs;
+    auto base_type{
+        ParseDeclSpec(&storage_class_spec, &func_spec, &align, &attrs)};
 
     if (Try(Tag::kSemicolon)) {
       return nullptr;
     } else {
       if (maybe_func_def) {
         return ParseInitDeclaratorList(base_type, storage_class_spec, func_spec,
-                                       align);
+                                       align, attrs);
       } else {
         auto ret{ParseInitDeclaratorList(base_type, storage_class_spec,
-                                         func_spec, align)};
+                                         func_spec, align, attrs)};
         Expect(Tag::kSemicolon);
         return ret;
       }
@@ -58,7 +60,8 @@ void Parser::ParseStaticAssertDecl() {
  * Decl Spec
  */
 QualType Parser::ParseDeclSpec(std::uint32_t* storage_class_spec,
-                               std::uint32_t* func_spec, std::int32_t* align) {
+                               std::uint32_t* func_spec, std::int32_t* align,
+                               Attributes* attrs) {
 #define CHECK_AND_SET_STORAGE_CLASS_SPEC(spec)                  \
   if (*storage_class_spec != 0) {                               \
     Error(tok, "duplicated storage class specifier");           \
@@ -89,7 +92,7 @@ QualType Parser::ParseDeclSpec(std::uint32_t* storage_class_spec,
   QualType type;
 
   while (true) {
-    TryParseAttributeSpec();
+    TryParseAttributeSpec(attrs);
 
     tok = Next();
 
@@ -232,7 +235,7 @@ QualType Parser::ParseDeclSpec(std::uint32_t* storage_class_spec,
 
       default: {
         if (type_spec == 0 && IsTypeName(tok)) {
-          auto ident{scope_->FindUsual(tok.GetIdentifier())};
+          auto ident{scope_->FindUsual(tok)};
           type = ident->GetQualType();
           type_spec |= kTypedefName;
 
@@ -253,7 +256,7 @@ QualType Parser::ParseDeclSpec(std::uint32_t* storage_class_spec,
 finish:
   PutBack();
 
-  TryParseAttributeSpec();
+  TryParseAttributeSpec(attrs);
 
   switch (type_spec) {
     case 0:
@@ -346,7 +349,7 @@ void Parser::ParseStructDeclList(StructType* type) {
       ParseStaticAssertDecl();
     } else {
       std::int32_t align{};
-      auto base_type{ParseDeclSpec(nullptr, nullptr, &align)};
+      auto base_type{ParseDeclSpec(nullptr, nullptr, &align, nullptr)};
 
       do {
         Token tok;
@@ -421,11 +424,11 @@ finalize:
   type->SetComplete(true);
 
   // struct / union 中的 tag 的作用域与该 struct / union 所在的作用域相同
-  for (const auto& [name, tag] : scope_->AllTagInCurrScope()) {
-    if (scope_backup->FindTagInCurrScope(name)) {
+  for (const auto& [id, tag] : scope_->AllTagInCurrScope()) {
+    if (scope_backup->FindTagInCurrScope(id)) {
       Error(tag->GetLoc(), "redefinition of tag {}", tag->GetName());
     } else {
-      scope_backup->InsertTag(name, tag);
+      scope_backup->InsertTag(id, tag);
     }
   }
 
@@ -570,13 +573,14 @@ std::int32_t Parser::ParseAlignas() {
 CompoundStmt* Parser::ParseInitDeclaratorList(QualType& base_type,
                                               std::uint32_t storage_class_spec,
                                               std::uint32_t func_spec,
-                                              std::int32_t align) {
+                                              std::int32_t align,
+                                              const Attributes& attrs) {
   auto stmts{MakeAstNode<CompoundStmt>(Peek())};
 
   do {
     auto copy{base_type};
-    stmts->AddStmt(
-        ParseInitDeclarator(copy, storage_class_spec, func_spec, align));
+    stmts->AddStmt(ParseInitDeclarator(copy, storage_class_spec, func_spec,
+                                       align, attrs));
     TryParseAttributeSpec();
   } while (Try(Tag::kComma));
 
@@ -586,7 +590,7 @@ CompoundStmt* Parser::ParseInitDeclaratorList(QualType& base_type,
 Declaration* Parser::ParseInitDeclarator(QualType& base_type,
                                          std::uint32_t storage_class_spec,
                                          std::uint32_t func_spec,
-                                         std::int32_t align) {
+                                         std::int32_t align, Attributes attrs) {
   auto token{Peek()};
   Token tok;
   ParseDeclarator(tok, base_type);
@@ -595,8 +599,12 @@ Declaration* Parser::ParseInitDeclarator(QualType& base_type,
     Error(token, "expect identifier");
   }
 
-  auto decl{
-      MakeDeclaration(tok, base_type, storage_class_spec, func_spec, align)};
+  // e.g. void f(void) __attribute__((noreturn));
+  // 只作用于这一个声明符
+  TryParseAttributeSpec(&attrs);
+
+  auto decl{MakeDeclaration(tok, base_type, storage_class_spec, func_spec,
+                            align, attrs)};
 
   if (decl && decl->IsObjDecl()) {
     if (Try(Tag::kEqual)) {
@@ -788,7 +796,7 @@ std::pair<std::vector<ObjectExpr*>, bool> Parser::ParseParamTypeList() {
 }
 
 ObjectExpr* Parser::ParseParamDecl() {
-  auto base_type{ParseDeclSpec(nullptr, nullptr, nullptr)};
+  auto base_type{ParseDeclSpec(nullptr, nullptr, nullptr, nullptr)};
 
   Token tok;
   ParseDeclarator(tok, base_type);
@@ -799,7 +807,7 @@ ObjectExpr* Parser::ParseParamDecl() {
     return MakeAstNode<ObjectExpr>(tok, "", base_type, 0, Linkage::kNone, true);
   }
 
-  auto decl{MakeDeclaration(tok, base_type, 0, 0, 0)};
+  auto decl{MakeDeclaration(tok, base_type, 0, 0, 0, {})};
   auto obj{decl->GetIdent()->ToObjectExpr()};
   obj->SetDecl(decl);
 
@@ -810,7 +818,7 @@ ObjectExpr* Parser::ParseParamDecl() {
  * type name
  */
 QualType Parser::ParseTypeName() {
-  auto base_type{ParseDeclSpec(nullptr, nullptr, nullptr)};
+  auto base_type{ParseDeclSpec(nullptr, nullptr, nullptr, nullptr)};
   ParseAbstractDeclarator(base_type);
   return base_type;
 }
@@ -8,7 +8,11 @@
 #include <limits>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
 
+#include <llvm/ADT/SmallVector.h>
+
+#include "calc.h"
 #include "encoding.h"
 #include "error.h"
 #include "lex.h"
@@ -95,7 +99,7 @@ Expr* Parser::ParseAssignExpr() {
 }
 
 Expr* Parser::ParseConditionExpr() {
-  auto cond{ParseLogicalOrExpr()};
+  auto cond{ParseBinaryExpr()};
 
   auto token{Peek()};
   if (Try(Tag::kQuestion)) {
@@ -111,178 +115,77 @@ Expr* Parser::ParseConditionExpr() {
   return cond;
 }
 
-Expr* Parser::ParseLogicalOrExpr() {
-  auto lhs{ParseLogicalAndExpr()};
-
-  auto token{Peek()};
-  while (Try(Tag::kPipePipe)) {
-    auto rhs{ParseLogicalAndExpr()};
-    lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kPipePipe, lhs, rhs);
-    token = Peek();
-  }
-
-  return lhs;
-}
-
-Expr* Parser::ParseLogicalAndExpr() {
-  auto lhs{ParseInclusiveOrExpr()};
-
-  auto token{Peek()};
-  while (Try(Tag::kAmpAmp)) {
-    auto rhs{ParseInclusiveOrExpr()};
-    lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kAmpAmp, lhs, rhs);
-    token = Peek();
-  }
-
-  return lhs;
-}
-
-Expr* Parser::ParseInclusiveOrExpr() {
-  auto lhs{ParseExclusiveOrExpr()};
-
-  auto token{Peek()};
-  while (Try(Tag::kPipe)) {
-    auto rhs{ParseExclusiveOrExpr()};
-    lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kPipe, lhs, rhs);
-    token = Peek();
-  }
-
-  return lhs;
-}
-
-Expr* Parser::ParseExclusiveOrExpr() {
-  auto lhs{ParseAndExpr()};
-
-  auto token{Peek()};
-  while (Try(Tag::kCaret)) {
-    auto rhs{ParseAndExpr()};
-    lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kCaret, lhs, rhs);
-    token = Peek();
-  }
-
-  return lhs;
-}
-
-Expr* Parser::ParseAndExpr() {
-  auto lhs{ParseEqualityExpr()};
-
-  auto token{Peek()};
-  while (Try(Tag::kAmp)) {
-    auto rhs{ParseEqualityExpr()};
-    lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kAmp, lhs, rhs);
-    token = Peek();
-  }
-
-  return lhs;
-}
-
-Expr* Parser::ParseEqualityExpr() {
-  auto lhs{ParseRelationExpr()};
-
-  auto token{Peek()};
-  while (true) {
-    if (Try(Tag::kEqualEqual)) {
-      auto rhs{ParseRelationExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kEqualEqual, lhs, rhs);
-    } else if (Try(Tag::kExclaimEqual)) {
-      auto rhs{ParseRelationExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kExclaimEqual, lhs, rhs);
-    } else {
-      break;
-    }
-    token = Peek();
+std::int32_t Parser::GetBinaryPrecedence(Tag tag) {
+  switch (tag) {
+    case Tag::kPipePipe:
+      return 1;
+    case Tag::kAmpAmp:
+      return 2;
+    case Tag::kPipe:
+      return 3;
+    case Tag::kCaret:
+      return 4;
+    case Tag::kAmp:
+      return 5;
+    case Tag::kEqualEqual:
+    case Tag::kExclaimEqual:
+      return 6;
+    case Tag::kLess:
+    case Tag::kGreater:
+    case Tag::kLessEqual:
+    case Tag::kGreaterEqual:
+      return 7;
+    case Tag::kLessLess:
+    case Tag::kGreaterGreater:
+      return 8;
+    case Tag::kPlus:
+    case Tag::kMinus:
+      return 9;
+    case Tag::kStar:
+    case Tag::kSlash:
+    case Tag::kPercent:
+      return MaxBinaryPrecedence;
+    default:
+      return 0;
   }
-
-  return lhs;
 }
 
-Expr* Parser::ParseRelationExpr() {
-  auto lhs{ParseShiftExpr()};
-
-  auto token{Peek()};
-  while (true) {
-    if (Try(Tag::kLess)) {
-      auto rhs{ParseShiftExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kLess, lhs, rhs);
-    } else if (Try(Tag::kGreater)) {
-      auto rhs{ParseShiftExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kGreater, lhs, rhs);
-    } else if (Try(Tag::kLessEqual)) {
-      auto rhs{ParseShiftExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kLessEqual, lhs, rhs);
-    } else if (Try(Tag::kGreaterEqual)) {
-      auto rhs{ParseShiftExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kGreaterEqual, lhs, rhs);
-    } else {
-      break;
-    }
-    token = Peek();
-  }
+// 使用优先级爬升解析所有二元运算符, 每个操作数只调用一次 ParseCastExpr
+// 所有二元运算符都是左结合的, 栈中运算符的优先级严格递增,
+// 因此栈的深度不超过优先级的个数, 与表达式的长度无关
+Expr* Parser::ParseBinaryExpr() {
+  struct Operator {
+    Tag tag;
+    SourceLocation loc;
+  };
 
-  return lhs;
-}
+  llvm::SmallVector<Expr*, MaxBinaryPrecedence + 1> operands;
+  llvm::SmallVector<Operator, MaxBinaryPrecedence> operators;
 
-Expr* Parser::ParseShiftExpr() {
-  auto lhs{ParseAdditiveExpr()};
+  operands.push_back(ParseCastExpr());
 
-  auto token{Peek()};
   while (true) {
-    if (Try(Tag::kLessLess)) {
-      auto rhs{ParseAdditiveExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kLessLess, lhs, rhs);
-    } else if (Try(Tag::kGreaterGreater)) {
-      auto rhs{ParseAdditiveExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kGreaterGreater, lhs, rhs);
-    } else {
-      break;
+    auto tag{Peek().GetTag()};
+    auto precedence{GetBinaryPrecedence(tag)};
+
+    while (!std::empty(operators) &&
+           GetBinaryPrecedence(operators.back().tag) >= precedence) {
+      auto op{operators.pop_back_val()};
+      auto rhs{operands.pop_back_val()};
+      auto lhs{operands.pop_back_val()};
+      operands.push_back(MakeAstNode<BinaryOpExpr>(op.loc, op.tag, lhs, rhs));
     }
-    token = Peek();
-  }
-
-  return lhs;
-}
-
-Expr* Parser::ParseAdditiveExpr() {
-  auto lhs{ParseMultiplicativeExpr()};
 
-  auto token{Peek()};
-  while (true) {
-    if (Try(Tag::kPlus)) {
-      auto rhs{ParseMultiplicativeExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kPlus, lhs, rhs);
-    } else if (Try(Tag::kMinus)) {
-      auto rhs{ParseMultiplicativeExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kMinus, lhs, rhs);
-    } else {
+    if (precedence == 0) {
       break;
     }
-    token = Peek();
-  }
-
-  return lhs;
-}
-
-Expr* Parser::ParseMultiplicativeExpr() {
-  auto lhs{ParseCastExpr()};
 
-  auto token{Peek()};
-  while (true) {
-    if (Try(Tag::kStar)) {
-      auto rhs{ParseCastExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kStar, lhs, rhs);
-    } else if (Try(Tag::kSlash)) {
-      auto rhs{ParseCastExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kSlash, lhs, rhs);
-    } else if (Try(Tag::kPercent)) {
-      auto rhs{ParseCastExpr()};
-      lhs = MakeAstNode<BinaryOpExpr>(token, Tag::kPercent, lhs, rhs);
-    } else {
-      break;
-    }
-    token = Peek();
+    operators.push_back({tag, Next().GetLoc()});
+    operands.push_back(ParseCastExpr());
   }
 
-  return lhs;
+  assert(std::size(operands) == 1);
+  return operands.back();
 }
 
 Expr* Parser::ParseCastExpr() {
@@ -476,7 +379,7 @@ Expr* Parser::ParseIndexExpr(Expr* expr) {
 }
 
 Expr* Parser::ParseFuncCallExpr(Expr* expr) {
-  std::vector<Expr*> args;
+  ArenaVector<Expr*> args;
   auto loc{Peek().GetLoc()};
 
   if (expr->GetType()->IsFunctionTy() &&
@@ -485,7 +388,7 @@ Expr* Parser::ParseFuncCallExpr(Expr* expr) {
     Expect(Tag::kComma);
     auto type{ParseTypeName()};
     Expect(Tag::kRightParen);
-    auto ret{MakeAstNode<FuncCallExpr>(loc, expr, args)};
+    auto ret{MakeAstNode<FuncCallExpr>(loc, expr, std::move(args))};
     ret->SetVaArgType(type.GetType());
     return ret;
   }
@@ -498,7 +401,26 @@ Expr* Parser::ParseFuncCallExpr(Expr* expr) {
     }
   }
 
-  return MakeAstNode<FuncCallExpr>(loc, expr, args);
+  auto ret{MakeAstNode<FuncCallExpr>(loc, expr, std::move(args))};
+
+  // 概率的检查与优化级别以及调用是否作为条件无关
+  if (ret->GetFuncType()->FuncGetName() ==
+      "__builtin_expect_with_probability") {
+    auto arg{ret->GetArgs()[2]};
+    auto value{
+        llvm::dyn_cast_or_null<llvm::ConstantFP>(CalcConstantExpr{}.Calc(arg))};
+    if (value == nullptr) {
+      Error(arg->GetLoc(),
+            "probability must be a constant floating-point expression");
+    }
+
+    auto probability{value->getValueAPF().convertToDouble()};
+    if (!(probability >= 0 && probability <= 1)) {
+      Error(arg->GetLoc(), "probability must be in the range [0.0, 1.0]");
+    }
+  }
+
+  return ret;
 }
 
 Expr* Parser::ParseMemberRefExpr(Expr* expr) {
@@ -547,13 +469,12 @@ Expr* Parser::ParsePrimaryExpr() {
   }
 
   if (Peek().IsIdentifier()) {
-    auto name{Next().GetIdentifier()};
-    auto ident{scope_->FindUsual(name)};
+    auto ident{scope_->FindUsual(Next())};
 
     if (ident) {
       return ident;
     } else {
-      Error(token, "undefined symbol: {}", name);
+      Error(token, "undefined symbol: {}", token.GetIdentifier());
     }
   } else if (Peek().IsConstant()) {
     return ParseConstant();
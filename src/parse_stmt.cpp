@@ -102,10 +102,29 @@ CompoundStmt* Parser::ParseCompoundStmt(Type* func_type) {
   compound_stmt_.push(stmts);
 
   while (!Try(Tag::kRightBrace)) {
-    if (IsDecl(Peek())) {
-      stmts->AddStmt(ParseDecl());
-    } else {
-      stmts->AddStmt(ParseStmt());
+    auto begin{index_};
+    auto scope{scope_};
+    auto depth{std::size(compound_stmt_)};
+
+    try {
+      if (IsDecl(Peek())) {
+        stmts->AddStmt(ParseDecl());
+      } else {
+        stmts->AddStmt(ParseStmt());
+      }
+    } catch (const CompileError&) {
+      // 到达文件末尾时由 ParseNextExtDecl 处理
+      if (ErrorLimitReached() || !HasNext()) {
+        throw;
+      }
+
+      scope_ = scope;
+      while (std::size(compound_stmt_) > depth) {
+        compound_stmt_.pop();
+      }
+      indexs_.clear();
+
+      Synchronize(begin);
     }
   }
 
@@ -4,12 +4,13 @@
 
 #include "scope.h"
 
-#include "memory_pool.h"
+#include "ast_context.h"
+#include "identifier_table.h"
 
 namespace kcc {
 
 Scope* Scope::Get(Scope* parent, enum ScopeType type) {
-  return new (ScopePool.Allocate()) Scope{parent, type};
+  return GetNodeCtx().New<Scope>(parent, type);
 }
 
 void Scope::InsertTag(IdentifierExpr* ident) {
@@ -21,57 +22,78 @@ void Scope::InsertUsual(IdentifierExpr* ident) {
 }
 
 void Scope::InsertTag(const std::string& name, IdentifierExpr* ident) {
-  tags_[name] = ident;
+  InsertTag(Identifiers->Intern(name), ident);
 }
 
 void Scope::InsertUsual(const std::string& name, IdentifierExpr* ident) {
-  usual_[name] = ident;
+  InsertUsual(Identifiers->Intern(name), ident);
 }
 
-IdentifierExpr* Scope::FindTag(const std::string& name) {
-  auto iter{tags_.find(name)};
-  if (iter != std::end(tags_)) {
-    return iter->second;
-  }
+void Scope::InsertTag(std::uint32_t id, IdentifierExpr* ident) {
+  tags_[id] = ident;
+}
 
-  if (type_ == kFile || parent_ == nullptr) {
-    return nullptr;
-  } else {
-    return parent_->FindTag(name);
-  }
+void Scope::InsertUsual(std::uint32_t id, IdentifierExpr* ident) {
+  usual_[id] = ident;
+}
+
+IdentifierExpr* Scope::FindTag(const std::string& name) {
+  return FindTag(Identifiers->Intern(name));
 }
 
 IdentifierExpr* Scope::FindUsual(const std::string& name) {
-  auto iter{usual_.find(name)};
-  if (iter != std::end(usual_)) {
-    return iter->second;
+  return FindUsual(Identifiers->Intern(name));
+}
+
+IdentifierExpr* Scope::FindTagInCurrScope(const std::string& name) {
+  return FindTagInCurrScope(Identifiers->Intern(name));
+}
+
+IdentifierExpr* Scope::FindUsualInCurrScope(const std::string& name) {
+  return FindUsualInCurrScope(Identifiers->Intern(name));
+}
+
+IdentifierExpr* Scope::FindTag(std::uint32_t id) {
+  for (auto scope{this}; scope != nullptr; scope = scope->parent_) {
+    if (auto ident{scope->FindTagInCurrScope(id)}) {
+      return ident;
+    }
+
+    if (scope->type_ == kFile) {
+      break;
+    }
   }
 
-  if (type_ == kFile || parent_ == nullptr) {
-    return nullptr;
-  } else {
-    return parent_->FindUsual(name);
+  return nullptr;
+}
+
+IdentifierExpr* Scope::FindUsual(std::uint32_t id) {
+  for (auto scope{this}; scope != nullptr; scope = scope->parent_) {
+    if (auto ident{scope->FindUsualInCurrScope(id)}) {
+      return ident;
+    }
+
+    if (scope->type_ == kFile) {
+      break;
+    }
   }
+
+  return nullptr;
 }
 
-IdentifierExpr* Scope::FindTagInCurrScope(const std::string& name) {
-  auto iter{tags_.find(name)};
-  return iter == std::end(tags_) ? nullptr : iter->second;
+IdentifierExpr* Scope::FindTagInCurrScope(std::uint32_t id) {
+  return tags_.lookup(id);
 }
 
-IdentifierExpr* Scope::FindUsualInCurrScope(const std::string& name) {
-  auto iter{usual_.find(name)};
-  return iter == std::end(usual_) ? nullptr : iter->second;
+IdentifierExpr* Scope::FindUsualInCurrScope(std::uint32_t id) {
+  return usual_.lookup(id);
 }
 
 IdentifierExpr* Scope::FindUsual(const Token& tok) {
-  return FindUsual(tok.GetIdentifier());
+  return FindUsual(tok.GetIdentifierId());
 }
 
-std::unordered_map<std::string, IdentifierExpr*> Scope::AllTagInCurrScope()
-    const {
-  return tags_;
-}
+const Scope::SymbolTable& Scope::AllTagInCurrScope() const { return tags_; }
 
 Scope* Scope::GetParent() { return parent_; }
 
@@ -4,8 +4,10 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
-#include <unordered_map>
+
+#include <llvm/ADT/DenseMap.h>
 
 #include "ast.h"
 #include "token.h"
@@ -31,8 +33,11 @@ enum ScopeType { kBlock, kFile, kFunc, kFuncProto };
 // 跟随成员访问或通过指针的成员访问运算符的标识符, 会在类型成员命名空间中查找
 // 该类型由成员访问运算符左运算数确定
 // 所有其他标识符, 会在通常命名空间中查找
+// 标识符在词法分析时已经 intern, 查找时以 id 为键, 不需要构造字符串
 class Scope {
  public:
+  using SymbolTable = llvm::DenseMap<std::uint32_t, IdentifierExpr*>;
+
   static Scope* Get(Scope* parent, enum ScopeType type);
 
   auto begin() { return std::begin(usual_); }
@@ -44,30 +49,38 @@ class Scope {
   void InsertUsual(IdentifierExpr* ident);
   void InsertTag(const std::string& name, IdentifierExpr* ident);
   void InsertUsual(const std::string& name, IdentifierExpr* ident);
+  void InsertTag(std::uint32_t id, IdentifierExpr* ident);
+  void InsertUsual(std::uint32_t id, IdentifierExpr* ident);
 
   IdentifierExpr* FindTag(const std::string& name);
   IdentifierExpr* FindUsual(const std::string& name);
   IdentifierExpr* FindTagInCurrScope(const std::string& name);
   IdentifierExpr* FindUsualInCurrScope(const std::string& name);
+  IdentifierExpr* FindTag(std::uint32_t id);
+  IdentifierExpr* FindUsual(std::uint32_t id);
+  IdentifierExpr* FindTagInCurrScope(std::uint32_t id);
+  IdentifierExpr* FindUsualInCurrScope(std::uint32_t id);
 
   IdentifierExpr* FindUsual(const Token& tok);
 
-  std::unordered_map<std::string, IdentifierExpr*> AllTagInCurrScope() const;
+  const SymbolTable& AllTagInCurrScope() const;
   Scope* GetParent();
 
   bool IsFileScope() const;
   bool IsBlockScope() const;
 
  private:
+  friend class AstContext;
+
   Scope(Scope* parent, enum ScopeType type);
 
   Scope* parent_;
   enum ScopeType type_;
 
   // struct / union / enum 的名字
-  std::unordered_map<std::string, IdentifierExpr*> tags_;
+  SymbolTable tags_;
   // 函数 / 对象 / typedef名 / 枚举常量
-  std::unordered_map<std::string, IdentifierExpr*> usual_;
+  SymbolTable usual_;
 };
 
 }  // namespace kcc
@@ -0,0 +1,204 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#include "source_manager.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <utility>
+
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Basic/SourceManager.h>
+
+namespace kcc {
+
+// 编号 0 保留给还未遇到行控制指令时的空文件名
+SourceManager::SourceManager() { InternFileName(""); }
+
+void SourceManager::SetCode(std::string code) {
+  code_ = std::move(code);
+  line_begins_.clear();
+}
+
+const std::string& SourceManager::GetCode() const { return code_; }
+
+std::string_view SourceManager::GetStr(std::uint32_t offset,
+                                       std::uint32_t length) const {
+  if (length == 0) {
+    return {};
+  }
+
+  if (clang_source_manager_) {
+    if (!std::empty(cleaned_spellings_)) {
+      if (auto iter{cleaned_spellings_.find(offset)};
+          iter != std::end(cleaned_spellings_)) {
+        return iter->second;
+      }
+    }
+
+    auto loc{clang::SourceLocation::getFromRawEncoding(offset)};
+    return {clang_source_manager_->getCharacterData(
+                clang_source_manager_->getSpellingLoc(loc)),
+            length};
+  }
+
+  assert(offset + length <= std::size(code_));
+  return std::string_view{code_}.substr(offset, length);
+}
+
+std::uint32_t SourceManager::InternFileName(
+    const std::string& file_name) const {
+  if (auto iter{file_ids_.find(file_name)}; iter != std::end(file_ids_)) {
+    return iter->second;
+  }
+
+  auto file_id{static_cast<std::uint32_t>(std::size(file_names_))};
+  file_names_.push_back(file_name);
+  file_ids_[file_name] = file_id;
+
+  return file_id;
+}
+
+const std::string& SourceManager::GetFileName(std::uint32_t file_id) const {
+  assert(file_id < std::size(file_names_));
+  return file_names_[file_id];
+}
+
+void SourceManager::AddLineEntry(std::uint32_t offset, std::uint32_t file_id,
+                                 std::int32_t row) {
+  assert(std::empty(line_entries_) || line_entries_.back().offset <= offset);
+  line_entries_.push_back({offset, file_id, row});
+}
+
+void SourceManager::SetClangSourceManager(
+    const clang::SourceManager* source_manager) {
+  clang_source_manager_ = source_manager;
+}
+
+void SourceManager::AddCleanedSpelling(std::uint32_t offset,
+                                       std::string spelling) {
+  cleaned_spellings_[offset] = std::move(spelling);
+}
+
+// 在第一个行控制指令之前的内容视为属于第一个文件
+std::uint32_t SourceManager::GetFileId(std::uint32_t offset) const {
+  if (clang_source_manager_) {
+    return GetClangFileId(offset);
+  }
+
+  if (auto entry{FindLineEntry(offset)}) {
+    return entry->file_id;
+  } else if (!std::empty(line_entries_)) {
+    return line_entries_.front().file_id;
+  } else {
+    return 0;
+  }
+}
+
+std::int32_t SourceManager::GetRow(std::uint32_t offset) const {
+  if (clang_source_manager_) {
+    return DecodeClang(offset).GetRow();
+  }
+
+  auto index{GetLineIndex(offset)};
+
+  if (auto entry{FindLineEntry(offset)}) {
+    return entry->row +
+           static_cast<std::int32_t>(index - GetLineIndex(entry->offset));
+  } else {
+    return static_cast<std::int32_t>(index) + 1;
+  }
+}
+
+std::int32_t SourceManager::GetColumn(std::uint32_t offset) const {
+  if (clang_source_manager_) {
+    return DecodeClang(offset).GetColumn();
+  }
+
+  auto index{GetLineIndex(offset)};
+  return static_cast<std::int32_t>(offset - line_begins_[index]) + 1;
+}
+
+Location SourceManager::Decode(std::uint32_t offset) const {
+  if (clang_source_manager_) {
+    return DecodeClang(offset);
+  }
+
+  auto index{GetLineIndex(offset)};
+
+  return Location{GetFileName(GetFileId(offset)), code_.data(),
+                  line_begins_[index], GetRow(offset), GetColumn(offset)};
+}
+
+const SourceManager::LineEntry* SourceManager::FindLineEntry(
+    std::uint32_t offset) const {
+  auto iter{std::upper_bound(
+      std::begin(line_entries_), std::end(line_entries_), offset,
+      [](std::uint32_t lhs, const LineEntry& rhs) { return lhs < rhs.offset; })};
+
+  if (iter == std::begin(line_entries_)) {
+    return nullptr;
+  } else {
+    return &*std::prev(iter);
+  }
+}
+
+std::uint32_t SourceManager::GetLineIndex(std::uint32_t offset) const {
+  if (std::empty(line_begins_)) {
+    line_begins_.push_back(0);
+    for (std::uint32_t i{}; i < std::size(code_); ++i) {
+      if (code_[i] == '\n') {
+        line_begins_.push_back(i + 1);
+      }
+    }
+  }
+
+  auto iter{std::upper_bound(std::begin(line_begins_), std::end(line_begins_),
+                             offset)};
+  return static_cast<std::uint32_t>(
+      std::distance(std::begin(line_begins_), iter) - 1);
+}
+
+// 宏展开得到的 token 的位置为展开处的位置
+std::uint32_t SourceManager::GetClangFileId(std::uint32_t offset) const {
+  auto loc{clang::SourceLocation::getFromRawEncoding(offset)};
+
+  if (loc.isValid()) {
+    auto presumed{clang_source_manager_->getPresumedLoc(
+        clang_source_manager_->getExpansionLoc(loc))};
+    if (presumed.isValid()) {
+      return InternFileName(presumed.getFilename());
+    }
+  }
+
+  auto main_file{clang_source_manager_->getFileEntryForID(
+      clang_source_manager_->getMainFileID())};
+  return InternFileName(main_file->getName().str());
+}
+
+Location SourceManager::DecodeClang(std::uint32_t offset) const {
+  auto loc{clang::SourceLocation::getFromRawEncoding(offset)};
+  auto file_name{GetFileName(GetClangFileId(offset))};
+
+  if (loc.isInvalid()) {
+    return Location{file_name, "", 0, 1, 1};
+  }
+
+  auto expansion_loc{clang_source_manager_->getExpansionLoc(loc)};
+  auto presumed{clang_source_manager_->getPresumedLoc(expansion_loc)};
+  if (presumed.isInvalid()) {
+    return Location{file_name, "", 0, 1, 1};
+  }
+
+  // 内容从该行的起始位置开始
+  auto column{static_cast<std::int32_t>(presumed.getColumn())};
+  auto content{clang_source_manager_->getCharacterData(expansion_loc) -
+               (column - 1)};
+
+  return Location{file_name, content, 0,
+                  static_cast<std::int32_t>(presumed.getLine()), column};
+}
+
+}  // namespace kcc
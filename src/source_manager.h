@@ -0,0 +1,81 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "location.h"
+
+namespace clang {
+class SourceManager;
+}
+
+namespace kcc {
+
+// 保存预处理后的代码, 文件名表以及行控制指令表
+// SourceLocation 只是在预处理后的代码中的偏移量, 需要时再从这里解码
+// 直接从 clang::Preprocessor 获取 token 时, SourceLocation 为
+// clang::SourceLocation 的编码, 由 clang 的 SourceManager 解码
+class SourceManager {
+ public:
+  SourceManager();
+
+  void SetCode(std::string code);
+  const std::string& GetCode() const;
+  std::string_view GetStr(std::uint32_t offset, std::uint32_t length) const;
+
+  std::uint32_t InternFileName(const std::string& file_name) const;
+  const std::string& GetFileName(std::uint32_t file_id) const;
+
+  // 由 Scanner 在处理 # line 指令时添加, offset 为下一行的起始位置
+  void AddLineEntry(std::uint32_t offset, std::uint32_t file_id,
+                    std::int32_t row);
+
+  void SetClangSourceManager(const clang::SourceManager* source_manager);
+  // 需要清理的 token (如含有续行符), 其拼写单独保存
+  void AddCleanedSpelling(std::uint32_t offset, std::string spelling);
+
+  std::uint32_t GetFileId(std::uint32_t offset) const;
+  std::int32_t GetRow(std::uint32_t offset) const;
+  std::int32_t GetColumn(std::uint32_t offset) const;
+  Location Decode(std::uint32_t offset) const;
+
+ private:
+  struct LineEntry {
+    std::uint32_t offset;
+    std::uint32_t file_id;
+    std::int32_t row;
+  };
+
+  const LineEntry* FindLineEntry(std::uint32_t offset) const;
+  std::uint32_t GetLineIndex(std::uint32_t offset) const;
+
+  std::uint32_t GetClangFileId(std::uint32_t offset) const;
+  Location DecodeClang(std::uint32_t offset) const;
+
+  std::string code_;
+
+  // 直接从 clang 获取 token 时, 文件名在解码时才登记
+  // 使用 deque, 登记新的文件名时 GetFileName 返回的引用不会失效
+  mutable std::deque<std::string> file_names_;
+  mutable std::unordered_map<std::string, std::uint32_t> file_ids_;
+
+  std::vector<LineEntry> line_entries_;
+  // 每一行的起始位置, 只在第一次解码时计算
+  mutable std::vector<std::uint32_t> line_begins_;
+
+  const clang::SourceManager* clang_source_manager_{};
+  std::unordered_map<std::uint32_t, std::string> cleaned_spellings_;
+};
+
+// 由 CompilationContext 拥有, 只在编译一个翻译单元期间有效
+inline thread_local SourceManager* Sources;
+
+}  // namespace kcc
@@ -0,0 +1,166 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#include "stats.h"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "ast.h"
+#include "ast_context.h"
+#include "code_gen.h"
+#include "llvm_common.h"
+#include "time_trace.h"
+#include "util.h"
+
+namespace kcc {
+
+namespace {
+
+struct NodeStats {
+  std::uint64_t count{};
+  std::uint64_t bytes{};
+};
+
+// 类型名来自 llvm::getTypeName, 是静态存储的字符串
+thread_local std::map<llvm::StringRef, NodeStats> ThreadNodeStats;
+thread_local std::uint64_t ThreadTokenCount{};
+thread_local std::uint64_t ThreadTokenBytes{};
+thread_local llvm::json::Array ThreadPhases;
+
+std::mutex StatsMutex;
+llvm::json::Array FileStats;
+
+// llvm::json 中的整数是有符号的
+template <typename T>
+std::int64_t ToJson(T value) {
+  return static_cast<std::int64_t>(value);
+}
+
+// 单位为 KB, 是整个进程到目前为止的峰值
+std::int64_t GetMaxRss() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+}  // namespace
+
+void RecordAllocation(llvm::StringRef type, std::size_t size) {
+  auto &stats{ThreadNodeStats[type]};
+  ++stats.count;
+  stats.bytes += size;
+}
+
+void RecordToken(std::size_t length) {
+  ++ThreadTokenCount;
+  ThreadTokenBytes += length;
+}
+
+void RecordPhase(llvm::StringRef phase) {
+  if (!CollectStats) {
+    return;
+  }
+
+  llvm::json::Object stats{{"phase", phase.str()},
+                           {"max_rss_kb", GetMaxRss()}};
+  if (Module) {
+    stats["instructions"] = ToJson(Module->getInstructionCount());
+  }
+
+  ThreadPhases.push_back(std::move(stats));
+}
+
+void StatsBegin() {
+  if (!PrintStats) {
+    return;
+  }
+
+  CollectStats = true;
+  ResetPhaseTimes();
+  ThreadNodeStats.clear();
+  ThreadTokenCount = 0;
+  ThreadTokenBytes = 0;
+  ThreadPhases.clear();
+}
+
+void StatsEnd(const std::string &file_name) {
+  if (!CollectStats) {
+    return;
+  }
+
+  // 生成目标文件, 汇编或 IR 之后
+  RecordPhase("Emit");
+  CollectStats = false;
+
+  llvm::json::Object nodes;
+  for (const auto &[type, stats] : ThreadNodeStats) {
+    nodes[type.str()] = llvm::json::Object{{"count", ToJson(stats.count)},
+                                           {"bytes", ToJson(stats.bytes)}};
+  }
+
+  // 不包括嵌套的阶段, 各阶段之和为总耗时
+  llvm::json::Object phase_times;
+  for (std::size_t i{}; i < static_cast<std::size_t>(Phase::kPhaseCount);
+       ++i) {
+    auto phase{static_cast<Phase>(i)};
+    phase_times[std::string{GetPhaseName(phase)}] =
+        std::chrono::duration<double, std::milli>{GetPhaseTime(phase)}
+            .count();
+  }
+
+  std::uint64_t scopes{};
+  if (auto iter{ThreadNodeStats.find("kcc::Scope")};
+      iter != std::end(ThreadNodeStats)) {
+    scopes = iter->second.count;
+  }
+
+  llvm::json::Object ast{
+      {"bytes", ToJson(AstCtx.GetBytesAllocated())},
+      {"blocks", ToJson(AstCtx.GetBlockCount())},
+      {"func_body_peak_bytes", ToJson(FuncBodyCtx.GetPeakBytes())},
+      {"deferred_body_peak_reserved_bytes", ToJson(DeferredBodyPeakBytes)},
+      {"nodes", std::move(nodes)}};
+
+  llvm::json::Object stats{{"file", file_name},
+                           {"tokens", ToJson(ThreadTokenCount)},
+                           {"token_bytes", ToJson(ThreadTokenBytes)},
+                           {"scopes", ToJson(scopes)},
+                           {"string_literals", ToJson(std::size(StringMap))},
+                           {"global_vars", ToJson(std::size(GlobalVarMap))},
+                           {"ast", std::move(ast)},
+                           {"phase_times_ms", std::move(phase_times)},
+                           {"phases", std::move(ThreadPhases)}};
+  ThreadPhases = {};
+
+  std::lock_guard lock{StatsMutex};
+  FileStats.push_back(std::move(stats));
+}
+
+void PrintStatsReport() {
+  if (!PrintStats) {
+    return;
+  }
+
+  std::lock_guard lock{StatsMutex};
+  llvm::json::Object report{
+      {"files", std::move(FileStats)},
+      {"skipped_unreferenced_functions", ToJson(SkippedFuncCount.load())},
+      {"max_rss_kb", GetMaxRss()}};
+  FileStats = {};
+
+  llvm::errs() << llvm::formatv("{0:2}", llvm::json::Value{std::move(report)})
+               << '\n';
+}
+
+}  // namespace kcc
@@ -0,0 +1,30 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <llvm/ADT/StringRef.h>
+
+namespace kcc {
+
+// 只在 -print-stats 时为 true, 统计的都是当前翻译单元的信息
+inline thread_local bool CollectStats{false};
+
+void RecordAllocation(llvm::StringRef type, std::size_t size);
+
+void RecordToken(std::size_t length);
+
+// 记录阶段结束时进程的峰值内存, 以及 Module 中的指令数
+void RecordPhase(llvm::StringRef phase);
+
+void StatsBegin();
+void StatsEnd(const std::string &file_name);
+
+// 以 JSON 格式输出到 stderr
+void PrintStatsReport();
+
+}  // namespace kcc
@@ -0,0 +1,86 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#include "tbaa.h"
+
+#include <cassert>
+#include <unordered_map>
+
+#include <llvm/IR/MDBuilder.h>
+
+#include "llvm_common.h"
+#include "util.h"
+
+namespace kcc {
+
+namespace {
+
+thread_local llvm::MDNode* CharNode{};
+thread_local std::unordered_map<const Type*, llvm::MDNode*> Tags;
+
+// 与 clang 使用相同的类型树, 链接时可以和 clang 编译的代码一起优化
+llvm::MDNode* GetCharNode() {
+  if (!CharNode) {
+    llvm::MDBuilder builder{*Context};
+    CharNode = builder.createTBAAScalarTypeNode(
+        "omnipotent char", builder.createTBAARoot("Simple C/C++ TBAA"));
+  }
+
+  return CharNode;
+}
+
+// 有符号和无符号的类型可以互相访问, 返回 nullptr 表示字符类型
+const char* GetTypeName(const Type* type) {
+  if (type->IsBoolTy()) {
+    return "_Bool";
+  } else if (type->IsCharacterTy()) {
+    return nullptr;
+  } else if (type->IsShortTy()) {
+    return "short";
+  } else if (type->IsIntTy()) {
+    return "int";
+  } else if (type->IsLongTy()) {
+    return "long";
+  } else if (type->IsLongLongTy()) {
+    return "long long";
+  } else if (type->IsFloatTy()) {
+    return "float";
+  } else if (type->IsDoubleTy()) {
+    return "double";
+  } else if (type->IsLongDoubleTy()) {
+    return "long double";
+  } else {
+    assert(type->IsPointerTy());
+    return "any pointer";
+  }
+}
+
+}  // namespace
+
+llvm::MDNode* GetTBAATag(const Type* type) {
+  // 只对标量生成, 结构体作为整体访问时可能与其成员的类型重叠
+  if (NoStrictAliasing || OptimizationLevel == OptLevel::kO0 ||
+      !type->IsScalarTy()) {
+    return nullptr;
+  }
+
+  if (auto iter{Tags.find(type)}; iter != std::end(Tags)) {
+    return iter->second;
+  }
+
+  llvm::MDBuilder builder{*Context};
+  auto node{GetCharNode()};
+  if (auto name{GetTypeName(type)}) {
+    node = builder.createTBAAScalarTypeNode(name, node);
+  }
+
+  return Tags[type] = builder.createTBAAStructTagNode(node, node, 0);
+}
+
+void ClearTBAATags() {
+  CharNode = nullptr;
+  Tags.clear();
+}
+
+}  // namespace kcc
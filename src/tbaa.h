@@ -0,0 +1,19 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#pragma once
+
+#include <llvm/IR/Metadata.h>
+
+#include "type.h"
+
+namespace kcc {
+
+// 基于类型的别名分析 (TBAA) 使用的访问标签, 不同类型的对象不会重叠,
+// 字符类型可以访问任何对象. 不需要时返回 nullptr, 即可能与任何对象重叠
+llvm::MDNode* GetTBAATag(const Type* type);
+// CompilationContext 释放时清除, 标签属于它的 LLVMContext
+void ClearTBAATags();
+
+}  // namespace kcc
@@ -0,0 +1,199 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#include "time_trace.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "error.h"
+#include "util.h"
+
+namespace kcc {
+
+namespace {
+
+constexpr auto PhaseCount{static_cast<std::size_t>(Phase::kPhaseCount)};
+
+constexpr std::string_view PhaseNames[PhaseCount]{
+    "Preprocess", "Tokenize", "Parse", "CodeGen",
+    "Optimization", "ObjGen",  "Link"};
+
+constexpr std::size_t MaxSlowestFuncs{10};
+
+using PhaseTimes = std::array<std::chrono::nanoseconds, PhaseCount>;
+using FuncTimes =
+    std::vector<std::pair<std::string, std::chrono::nanoseconds>>;
+
+thread_local PhaseTimer *CurrentTimer{};
+thread_local PhaseTimes ThreadPhaseTimes{};
+thread_local FuncTimes ThreadFuncTimes;
+
+struct TimeTraceRecord {
+  std::string name;
+  PhaseTimes phase_times;
+};
+
+std::mutex SummaryMutex;
+std::vector<TimeTraceRecord> Records;
+FuncTimes SlowestFuncs;
+
+void KeepSlowest(FuncTimes &funcs) {
+  auto size{std::min(std::size(funcs), MaxSlowestFuncs)};
+  std::partial_sort(
+      std::begin(funcs), std::begin(funcs) + size, std::end(funcs),
+      [](const auto &lhs, const auto &rhs) { return lhs.second > rhs.second; });
+  funcs.resize(size);
+}
+
+double ToMs(std::chrono::nanoseconds time) {
+  return std::chrono::duration<double, std::milli>{time}.count();
+}
+
+}  // namespace
+
+PhaseTimer::PhaseTimer(Phase phase)
+    : enabled_{TimeTrace || PrintStats}, phase_{phase} {
+  if (enabled_) {
+    parent_ = CurrentTimer;
+    CurrentTimer = this;
+    start_ = std::chrono::steady_clock::now();
+  }
+}
+
+PhaseTimer::~PhaseTimer() {
+  if (!enabled_) {
+    return;
+  }
+
+  auto elapsed{std::chrono::steady_clock::now() - start_};
+  ThreadPhaseTimes[static_cast<std::size_t>(phase_)] += elapsed - nested_;
+
+  if (parent_) {
+    parent_->nested_ += elapsed;
+  }
+  CurrentTimer = parent_;
+}
+
+TimeTraceScope::TimeTraceScope(Phase phase, std::string_view detail)
+    : timer_{phase},
+      scope_{GetPhaseName(phase).data(),
+             llvm::StringRef{detail.data(), std::size(detail)}} {}
+
+FuncTimer::FuncTimer(const std::string &name)
+    : name_{name}, scope_{"CodeGenFunction", name} {
+  if (TimeTrace) {
+    start_ = std::chrono::steady_clock::now();
+  }
+}
+
+FuncTimer::~FuncTimer() {
+  if (start_) {
+    ThreadFuncTimes.emplace_back(name_,
+                                 std::chrono::steady_clock::now() - *start_);
+  }
+}
+
+std::string_view GetPhaseName(Phase phase) {
+  return PhaseNames[static_cast<std::size_t>(phase)];
+}
+
+std::chrono::nanoseconds GetPhaseTime(Phase phase) {
+  return ThreadPhaseTimes[static_cast<std::size_t>(phase)];
+}
+
+void ResetPhaseTimes() { ThreadPhaseTimes = {}; }
+
+void TimeTraceBegin() {
+  if (!TimeTrace) {
+    return;
+  }
+
+  ResetPhaseTimes();
+  ThreadFuncTimes.clear();
+  llvm::timeTraceProfilerInitialize();
+}
+
+void TimeTraceEnd(const std::string &name, const std::string &json_file) {
+  if (!TimeTrace) {
+    return;
+  }
+
+  std::error_code error_code;
+  llvm::raw_fd_ostream os{json_file, error_code, llvm::sys::fs::F_Text};
+  if (error_code) {
+    Warning("can not open file '{}': {}", json_file, error_code.message());
+  } else {
+    llvm::timeTraceProfilerWrite(os);
+  }
+  llvm::timeTraceProfilerCleanup();
+
+  for (auto &&[func, time] : ThreadFuncTimes) {
+    func = name + ":" + func;
+  }
+  KeepSlowest(ThreadFuncTimes);
+
+  std::lock_guard lock{SummaryMutex};
+  Records.push_back({name, ThreadPhaseTimes});
+  std::move(std::begin(ThreadFuncTimes), std::end(ThreadFuncTimes),
+            std::back_inserter(SlowestFuncs));
+  KeepSlowest(SlowestFuncs);
+}
+
+void PrintTimeTraceSummary() {
+  if (!TimeTrace || std::empty(Records)) {
+    return;
+  }
+
+  auto width{std::size(std::string_view{"Total"}) + 2};
+  for (const auto &record : Records) {
+    width = std::max(width, std::size(record.name) + 2);
+  }
+
+  fmt::print(fmt("{:<{}}"), "File", width);
+  for (auto name : PhaseNames) {
+    fmt::print(fmt("{:>14}"), name);
+  }
+  fmt::print(fmt("{:>14}\n"), "Total");
+
+  PhaseTimes total_times{};
+  auto print_row{[&](std::string_view name, const PhaseTimes &times) {
+    fmt::print(fmt("{:<{}}"), name, width);
+
+    std::chrono::nanoseconds total{};
+    for (auto time : times) {
+      fmt::print(fmt("{:>14.3f}"), ToMs(time));
+      total += time;
+    }
+    fmt::print(fmt("{:>14.3f}\n"), ToMs(total));
+  }};
+
+  for (const auto &[name, times] : Records) {
+    print_row(name, times);
+    for (std::size_t i{}; i < PhaseCount; ++i) {
+      total_times[i] += times[i];
+    }
+  }
+  print_row("Total", total_times);
+
+  if (!std::empty(SlowestFuncs)) {
+    fmt::print(fmt("\nSlowest functions (ms):\n"));
+    for (const auto &[name, time] : SlowestFuncs) {
+      fmt::print(fmt("{:>14.3f}  {}\n"), ToMs(time), name);
+    }
+  }
+}
+
+}  // namespace kcc
@@ -0,0 +1,83 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <llvm/Support/TimeProfiler.h>
+
+namespace kcc {
+
+enum class Phase {
+  kPreprocess,
+  kTokenize,
+  kParse,
+  kCodeGen,
+  kOptimization,
+  kObjGen,
+  kLink,
+  kPhaseCount
+};
+
+// 只在 -ftime-trace 或 -print-stats 时生效. 统计阶段的耗时,
+// 不包括其中嵌套的其他阶段, 因此各阶段之和就是总耗时
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(Phase phase);
+  ~PhaseTimer();
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+ private:
+  bool enabled_{};
+  Phase phase_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::nanoseconds nested_{};
+  PhaseTimer *parent_{};
+};
+
+// 同时在 Chrome trace 中记录一个事件
+class TimeTraceScope {
+ public:
+  explicit TimeTraceScope(Phase phase, std::string_view detail = "");
+
+ private:
+  PhaseTimer timer_;
+  llvm::TimeTraceScope scope_;
+};
+
+// 记录一个函数的代码生成, 用于找出最慢的函数
+class FuncTimer {
+ public:
+  explicit FuncTimer(const std::string &name);
+  ~FuncTimer();
+
+  FuncTimer(const FuncTimer &) = delete;
+  FuncTimer &operator=(const FuncTimer &) = delete;
+
+ private:
+  std::optional<std::chrono::steady_clock::time_point> start_;
+  const std::string &name_;
+  llvm::TimeTraceScope scope_;
+};
+
+std::string_view GetPhaseName(Phase phase);
+// 当前线程中统计的耗时
+std::chrono::nanoseconds GetPhaseTime(Phase phase);
+void ResetPhaseTimes();
+
+// 在编译线程中调用, 每个翻译单元 (以及链接) 有一个 profiler
+void TimeTraceBegin();
+// 输出 Chrome trace 的 JSON 文件, 并将本线程的统计加入汇总
+void TimeTraceEnd(const std::string &name, const std::string &json_file);
+
+void PrintTimeTraceSummary();
+
+}  // namespace kcc
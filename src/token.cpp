@@ -8,7 +8,8 @@
 
 #include <fmt/format.h>
 
-#include "lex.h"
+#include "identifier_table.h"
+#include "source_manager.h"
 
 namespace kcc {
 
@@ -26,28 +27,37 @@ QString TokenTag::ToQString(TokenTag::Values value) {
 /*
  * Token
  */
+Token::Token(Tag tag, std::uint32_t offset, std::uint32_t length)
+    : tag_{tag}, offset_{offset}, length_{length} {}
+
 bool Token::TagIs(Tag tag) const { return tag_ == tag; }
 
 void Token::SetTag(Tag tag) { tag_ = tag; }
 
 Tag Token::GetTag() const { return tag_; }
 
-std::string Token::GetStr() const { return str_; }
+std::string Token::GetStr() const { return std::string{GetStrView()}; }
 
-void Token::SetStr(const std::string& str) { str_ = str; }
+std::string_view Token::GetStrView() const {
+  return Sources->GetStr(offset_, length_);
+}
 
 std::string Token::GetIdentifier() const {
-  assert(IsIdentifier());
-  return Scanner{str_}.HandleIdentifier();
+  return std::string{Identifiers->GetName(GetIdentifierId())};
 }
 
-Location Token::GetLoc() const { return loc_; }
+void Token::SetIdentifierId(std::uint32_t id) { identifier_id_ = id; }
+
+std::uint32_t Token::GetIdentifierId() const {
+  assert(IsIdentifier() && identifier_id_ != 0);
+  return identifier_id_;
+}
 
-void Token::SetLoc(const Location& loc) { loc_ = loc; }
+SourceLocation Token::GetLoc() const { return SourceLocation{offset_}; }
 
 std::string Token::ToString() const {
   return fmt::format("{:<25}str: {:<25}loc: <{}>", TokenTag::ToString(tag_),
-                     str_, loc_.ToLocStr());
+                     GetStrView(), GetLoc().Decode().ToLocStr());
 }
 
 bool Token::IsEof() const { return tag_ == Tag::kEof; }
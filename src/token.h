@@ -4,7 +4,9 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 #include <QMetaEnum>
 #include <QObject>
@@ -152,18 +154,26 @@ class TokenTag : public QObject {
 
 using Tag = TokenTag::Values;
 
+// token 不保存字符串和完整的位置信息, 只记录在预处理后的代码中的偏移量
+// 以及长度, 使用时再通过 SourceManager 还原, 标识符额外记录其在
+// IdentifierTable 中的 id
 class Token {
  public:
+  Token() = default;
+  Token(Tag tag, std::uint32_t offset, std::uint32_t length);
+
   bool TagIs(Tag tag) const;
   void SetTag(Tag tag);
   Tag GetTag() const;
 
   std::string GetStr() const;
-  void SetStr(const std::string &str);
+  std::string_view GetStrView() const;
   std::string GetIdentifier() const;
+  // 由 Scanner 或 Preprocessor 在生成标识符时设置
+  void SetIdentifierId(std::uint32_t id);
+  std::uint32_t GetIdentifierId() const;
 
-  Location GetLoc() const;
-  void SetLoc(const Location &loc);
+  SourceLocation GetLoc() const;
 
   std::string ToString() const;
 
@@ -180,8 +190,11 @@ class Token {
 
  private:
   Tag tag_{Tag::kNone};
-  std::string str_;
-  Location loc_;
+
+  std::uint32_t offset_{};
+  std::uint32_t length_{};
+
+  std::uint32_t identifier_id_{};
 };
 
 }  // namespace kcc
@@ -7,18 +7,57 @@
 #include <algorithm>
 #include <cassert>
 #include <limits>
+#include <utility>
 
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/Support/Casting.h>
 
 #include "ast.h"
+#include "ast_context.h"
 #include "error.h"
 #include "llvm_common.h"
-#include "memory_pool.h"
 #include "scope.h"
 
 namespace kcc {
 
+namespace {
+
+// 同一个翻译单元中只创建一次的类型
+thread_local VoidType* VoidTy{};
+thread_local llvm::DenseMap<std::uint32_t, ArithmeticType*> ArithmeticTypes;
+// 元素类型 (包括限定符) 相同的指针类型
+thread_local llvm::DenseMap<std::pair<Type*, std::uint32_t>, PointerType*>
+    PointerTypes;
+// 元素类型和数量相同的数组类型
+thread_local llvm::DenseMap<
+    std::pair<std::pair<Type*, std::uint32_t>, std::uint64_t>, ArrayType*>
+    ArrayTypes;
+
+}  // namespace
+
+void ClearTypeCache() {
+  VoidTy = nullptr;
+  ArithmeticTypes.clear();
+  PointerTypes.clear();
+  ArrayTypes.clear();
+}
+
+/*
+ * Attributes
+ */
+void Attributes::Merge(const Attributes& other) {
+  attr_spec |= other.attr_spec;
+  align = std::max(align, other.align);
+
+  if (other.visibility) {
+    visibility = other.visibility;
+  }
+  if (!std::empty(other.section)) {
+    section = other.section;
+  }
+}
+
 /*
  * QualType
  */
@@ -70,6 +109,8 @@ bool QualType::IsConst() const { return type_qual_ & kConst; }
 
 bool QualType::IsVolatile() const { return type_qual_ & kVolatile; }
 
+bool QualType::IsRestrict() const { return type_qual_ & kRestrict; }
+
 bool operator==(QualType lhs, QualType rhs) { return lhs.type_ == rhs.type_; }
 
 bool operator!=(QualType lhs, QualType rhs) { return !(lhs == rhs); }
@@ -389,6 +430,26 @@ bool Type::FuncIsInline() const {
   return ToFunctionType()->IsInline();
 }
 
+void Type::FuncSetInlineDefinition(bool inline_definition) {
+  assert(IsFunctionTy());
+  ToFunctionType()->SetInlineDefinition(inline_definition);
+}
+
+bool Type::FuncIsInlineDefinition() const {
+  assert(IsFunctionTy());
+  return ToFunctionType()->IsInlineDefinition();
+}
+
+void Type::FuncSetAttrs(const Attributes& attrs) {
+  assert(IsFunctionTy());
+  ToFunctionType()->SetAttrs(attrs);
+}
+
+const Attributes& Type::FuncGetAttrs() const {
+  assert(IsFunctionTy());
+  return ToFunctionType()->GetAttrs();
+}
+
 void Type::FuncSetName(const std::string& name) {
   assert(IsFunctionTy());
   ToFunctionType()->SetName(name);
@@ -405,8 +466,10 @@ Type::Type(bool complete) : complete_{complete} {}
  * VoidType
  */
 VoidType* VoidType::Get() {
-  static auto type{new (VoidTypePool.Allocate()) VoidType{}};
-  return type;
+  if (!VoidTy) {
+    VoidTy = AstCtx.New<VoidType>();
+  }
+  return VoidTy;
 }
 
 std::int32_t VoidType::GetWidth() const {
@@ -420,83 +483,48 @@ bool VoidType::Compatible(const Type* other) const { return Equal(other); }
 
 bool VoidType::Equal(const Type* other) const { return other->IsVoidTy(); }
 
-VoidType::VoidType() : Type{false} { llvm_type_ = Builder.getVoidTy(); }
+VoidType::VoidType() : Type{false} { llvm_type_ = Builder->getVoidTy(); }
 
 /*
  * ArithmeticType
  */
 ArithmeticType* ArithmeticType::Get(std::uint32_t type_spec) {
-  static auto bool_type{new (ArithmeticTypePool.Allocate())
-                            ArithmeticType{kBool}};
-  static auto char_type{new (ArithmeticTypePool.Allocate())
-                            ArithmeticType{kChar}};
-  static auto uchar_type{new (ArithmeticTypePool.Allocate())
-                             ArithmeticType{kChar | kUnsigned}};
-  static auto short_type{new (ArithmeticTypePool.Allocate())
-                             ArithmeticType{kShort}};
-  static auto ushort_type{new (ArithmeticTypePool.Allocate())
-                              ArithmeticType{kShort | kUnsigned}};
-  static auto int_type{new (ArithmeticTypePool.Allocate())
-                           ArithmeticType{kInt}};
-  static auto uint_type{new (ArithmeticTypePool.Allocate())
-                            ArithmeticType{kInt | kUnsigned}};
-  static auto long_type{new (ArithmeticTypePool.Allocate())
-                            ArithmeticType{kLong}};
-  static auto ulong_type{new (ArithmeticTypePool.Allocate())
-                             ArithmeticType{kLong | kUnsigned}};
-  static auto long_long_type{new (ArithmeticTypePool.Allocate())
-                                 ArithmeticType{kLongLong}};
-  static auto ulong_long_type{new (ArithmeticTypePool.Allocate())
-                                  ArithmeticType{kLongLong | kUnsigned}};
-  static auto float_type{new (ArithmeticTypePool.Allocate())
-                             ArithmeticType{kFloat}};
-  static auto double_type{new (ArithmeticTypePool.Allocate())
-                              ArithmeticType{kDouble}};
-  static auto long_double_type{new (ArithmeticTypePool.Allocate())
-                                   ArithmeticType{kDouble | kLong}};
-
   type_spec = ArithmeticType::DealWithTypeSpec(type_spec);
 
   switch (type_spec) {
     case kBool:
-      return bool_type;
     case kChar:
-      return char_type;
     case kChar | kUnsigned:
-      return uchar_type;
     case kShort:
-      return short_type;
     case kShort | kUnsigned:
-      return ushort_type;
     case kInt:
-      return int_type;
     case kInt | kUnsigned:
-      return uint_type;
     case kLong:
-      return long_type;
     case kLong | kUnsigned:
-      return ulong_type;
     case kLongLong:
-      return long_long_type;
     case kLongLong | kUnsigned:
-      return ulong_long_type;
     case kFloat:
-      return float_type;
     case kDouble:
-      return double_type;
     case kDouble | kLong:
-      return long_double_type;
+      break;
     default:
       assert(false);
       return nullptr;
   }
+
+  auto& type{ArithmeticTypes[type_spec]};
+  if (!type) {
+    type = AstCtx.New<ArithmeticType>(type_spec);
+  }
+
+  return type;
 }
 
 Type* ArithmeticType::IntegerPromote(Type* type) {
   assert(type != nullptr);
   assert(type->IsIntegerTy() || type->IsBoolTy());
 
-  static auto int_type{ArithmeticType::Get(kInt)};
+  auto int_type{ArithmeticType::Get(kInt)};
 
   if (type->ArithmeticRank() < int_type->Rank()) {
     return int_type;
@@ -618,21 +646,21 @@ ArithmeticType::ArithmeticType(std::uint32_t type_spec) : Type{true} {
   type_spec_ = ArithmeticType::DealWithTypeSpec(type_spec);
 
   if (IsBoolTy()) {
-    llvm_type_ = Builder.getInt1Ty();
+    llvm_type_ = Builder->getInt1Ty();
   } else if (IsCharacterTy()) {
-    llvm_type_ = Builder.getInt8Ty();
+    llvm_type_ = Builder->getInt8Ty();
   } else if (IsShortTy()) {
-    llvm_type_ = Builder.getInt16Ty();
+    llvm_type_ = Builder->getInt16Ty();
   } else if (IsIntTy()) {
-    llvm_type_ = Builder.getInt32Ty();
+    llvm_type_ = Builder->getInt32Ty();
   } else if (IsLongTy() || IsLongLongTy()) {
-    llvm_type_ = Builder.getInt64Ty();
+    llvm_type_ = Builder->getInt64Ty();
   } else if (IsFloatTy()) {
-    llvm_type_ = Builder.getFloatTy();
+    llvm_type_ = Builder->getFloatTy();
   } else if (IsDoubleTy()) {
-    llvm_type_ = Builder.getDoubleTy();
+    llvm_type_ = Builder->getDoubleTy();
   } else if (IsLongDoubleTy()) {
-    llvm_type_ = llvm::Type::getX86_FP80Ty(Context);
+    llvm_type_ = llvm::Type::getX86_FP80Ty(*Context);
   } else {
     assert(false);
   }
@@ -688,8 +716,17 @@ std::int32_t ArithmeticType::Rank() const {
 /*
  * PointerType
  */
+// 元素类型 (包括限定符) 相同的指针类型只创建一次
 PointerType* PointerType::Get(QualType element_type) {
-  return new (PointerTypePool.Allocate()) PointerType{element_type};
+  std::pair key{element_type.GetType(), element_type.GetTypeQual()};
+  if (auto iter{PointerTypes.find(key)}; iter != std::end(PointerTypes)) {
+    return iter->second;
+  }
+
+  auto type{AstCtx.New<PointerType>(element_type)};
+  PointerTypes[key] = type;
+
+  return type;
 }
 
 std::int32_t PointerType::GetWidth() const { return 8; }
@@ -700,6 +737,10 @@ std::int32_t PointerType::GetAlign() const { return GetWidth(); }
 bool PointerType::Compatible(const Type* other) const {
   assert(other != nullptr);
 
+  if (this == other) {
+    return true;
+  }
+
   if (other->IsPointerTy()) {
     return element_type_->Compatible(
         other->ToPointerType()->element_type_.GetType());
@@ -711,6 +752,10 @@ bool PointerType::Compatible(const Type* other) const {
 bool PointerType::Equal(const Type* other) const {
   assert(other != nullptr);
 
+  if (this == other) {
+    return true;
+  }
+
   if (other->IsPointerTy()) {
     return element_type_->Equal(
         other->ToPointerType()->element_type_.GetType());
@@ -724,7 +769,7 @@ QualType PointerType::GetElementType() const { return element_type_; }
 PointerType::PointerType(QualType element_type)
     : Type{true}, element_type_{element_type} {
   if (element_type_->IsVoidTy()) {
-    llvm_type_ = Builder.getInt8PtrTy();
+    llvm_type_ = Builder->getInt8PtrTy();
   } else {
     llvm_type_ = element_type_->GetLLVMType()->getPointerTo();
   }
@@ -733,9 +778,25 @@ PointerType::PointerType(QualType element_type)
 /*
  * ArrayType
  */
+// 元素类型和数量相同的数组类型只创建一次
+// 元素数量未知的数组之后会被修改, 每次都创建新的
 ArrayType* ArrayType::Get(QualType contained_type,
                           std::optional<std::size_t> num_elements) {
-  return new (ArrayTypePool.Allocate()) ArrayType{contained_type, num_elements};
+  if (!num_elements) {
+    return AstCtx.New<ArrayType>(contained_type, num_elements);
+  }
+
+  std::pair key{
+      std::pair{contained_type.GetType(), contained_type.GetTypeQual()},
+      static_cast<std::uint64_t>(*num_elements)};
+  if (auto iter{ArrayTypes.find(key)}; iter != std::end(ArrayTypes)) {
+    return iter->second;
+  }
+
+  auto type{AstCtx.New<ArrayType>(contained_type, num_elements)};
+  ArrayTypes[key] = type;
+
+  return type;
 }
 
 std::int32_t ArrayType::GetWidth() const {
@@ -751,6 +812,10 @@ std::int32_t ArrayType::GetAlign() const { return contained_type_->GetAlign(); }
 bool ArrayType::Compatible(const Type* other) const {
   assert(other != nullptr);
 
+  if (this == other) {
+    return true;
+  }
+
   if (other->IsArrayTy()) {
     auto other_arr{other->ToArrayType()};
     if (!contained_type_->Compatible(other_arr->contained_type_.GetType())) {
@@ -769,6 +834,10 @@ bool ArrayType::Compatible(const Type* other) const {
 bool ArrayType::Equal(const Type* other) const {
   assert(other != nullptr);
 
+  if (this == other) {
+    return true;
+  }
+
   if (other->IsArrayTy()) {
     auto other_arr{other->ToArrayType()};
     if (!contained_type_->Equal(other_arr->contained_type_.GetType())) {
@@ -821,7 +890,7 @@ ArrayType::ArrayType(QualType contained_type,
  */
 StructType* StructType::Get(bool is_struct, const std::string& name,
                             Scope* parent) {
-  return new (StructTypePool.Allocate()) StructType{is_struct, name, parent};
+  return AstCtx.New<StructType>(is_struct, name, parent);
 }
 
 std::int32_t StructType::GetWidth() const {
@@ -983,12 +1052,12 @@ void StructType::MergeAnonymous(ObjectExpr* anonymous) {
 
   members_.push_back(anonymous);
 
-  for (auto&& [name, obj] : *anonymous_type->scope_) {
-    if (auto member{obj->ToObjectExpr()}; !member) {
+  for (const auto& item : *anonymous_type->scope_) {
+    if (auto member{item.second->ToObjectExpr()}; !member) {
       continue;
     } else {
-      if (GetMember(name)) {
-        Error(member->GetLoc(), "duplicated member: '{}'", name);
+      if (GetMember(member->GetName())) {
+        Error(member->GetLoc(), "duplicated member: '{}'", member->GetName());
       }
 
       member->SetOffset(offset + member->GetOffset());
@@ -1174,9 +1243,9 @@ StructType::StructType(bool is_struct, const std::string& name, Scope* parent)
   std::string prefix{is_struct ? "struct." : "union."};
 
   if (HasName()) {
-    llvm_type_ = llvm::StructType::create(Context, prefix + name);
+    llvm_type_ = llvm::StructType::create(*Context, prefix + name);
   } else {
-    llvm_type_ = llvm::StructType::create(Context, prefix + "anon");
+    llvm_type_ = llvm::StructType::create(*Context, prefix + "anon");
   }
 }
 
@@ -1315,8 +1384,7 @@ void StructType::AddSpaceBetweenBitField() {
 FunctionType* FunctionType::Get(QualType return_type,
                                 std::vector<ObjectExpr*> params,
                                 bool is_var_args) {
-  return new (FunctionTypePool.Allocate())
-      FunctionType{return_type, params, is_var_args};
+  return AstCtx.New<FunctionType>(return_type, params, is_var_args);
 }
 
 std::int32_t FunctionType::GetWidth() const {
@@ -1398,6 +1466,16 @@ void FunctionType::SetFuncSpec(std::uint32_t func_spec) {
 
 bool FunctionType::IsInline() const { return func_spec_ & kInline; }
 
+void FunctionType::SetInlineDefinition(bool inline_definition) {
+  inline_definition_ = inline_definition;
+}
+
+bool FunctionType::IsInlineDefinition() const { return inline_definition_; }
+
+void FunctionType::SetAttrs(const Attributes& attrs) { attrs_ = attrs; }
+
+const Attributes& FunctionType::GetAttrs() const { return attrs_; }
+
 void FunctionType::SetName(const std::string& name) { name_ = name; }
 
 const std::string& FunctionType::GetName() const { return name_; }
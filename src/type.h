@@ -57,6 +57,37 @@ enum StorageClassSpec {
 
 enum FuncSpec { kInline = 0x1, kNoreturn = 0x2 };
 
+// GNU 扩展, __attribute__((...))
+enum AttrSpec {
+  kAttrAlwaysInline = 0x1,
+  kAttrNoInline = 0x2,
+  kAttrHot = 0x4,
+  kAttrCold = 0x8,
+  kAttrPure = 0x10,
+  kAttrConst = 0x20,
+  kAttrMalloc = 0x40,
+  kAttrFlatten = 0x80,
+  kAttrNoreturn = 0x100,
+  kAttrUsed = 0x200,
+  // 只用于抑制警告
+  kAttrUnused = 0x400,
+  kAttrWeak = 0x800,
+  // extern inline 不提供外部定义, 而 inline 提供 (GNU89 语义)
+  kAttrGnuInline = 0x1000
+};
+
+enum class Visibility { kDefault, kHidden, kProtected };
+
+struct Attributes {
+  // 重复声明时合并, 之后的声明可以覆盖之前的 section 和 visibility
+  void Merge(const Attributes& other);
+
+  std::uint32_t attr_spec{};
+  std::int32_t align{};
+  std::optional<Visibility> visibility;
+  std::string section;
+};
+
 enum TypeSpecCompatibility {
   kCompSigned = kShort | kInt | kLong | kLongLong,
   kCompUnsigned = kShort | kInt | kLong | kLongLong,
@@ -97,6 +128,7 @@ class QualType {
 
   bool IsConst() const;
   bool IsVolatile() const;
+  bool IsRestrict() const;
 
  private:
   Type* type_{};
@@ -202,6 +234,10 @@ class Type {
   const std::vector<ObjectExpr*>& FuncGetParams() const;
   void FuncSetFuncSpec(std::uint32_t func_spec);
   bool FuncIsInline() const;
+  void FuncSetInlineDefinition(bool inline_definition);
+  bool FuncIsInlineDefinition() const;
+  void FuncSetAttrs(const Attributes& attrs);
+  const Attributes& FuncGetAttrs() const;
   void FuncSetName(const std::string& name);
   const std::string& FuncGetName() const;
 
@@ -224,6 +260,8 @@ class VoidType : public Type {
   virtual bool Equal(const Type* other) const override;
 
  private:
+  friend class AstContext;
+
   VoidType();
 };
 
@@ -242,6 +280,8 @@ class ArithmeticType : public Type {
   virtual bool Equal(const Type* other) const override;
 
  private:
+  friend class AstContext;
+
   explicit ArithmeticType(std::uint32_t type_spec);
 
   std::int32_t Rank() const;
@@ -264,6 +304,8 @@ class PointerType : public Type {
   QualType GetElementType() const;
 
  private:
+  friend class AstContext;
+
   explicit PointerType(QualType element_type);
 
   QualType element_type_;
@@ -284,6 +326,8 @@ class ArrayType : public Type {
   QualType GetElementType() const;
 
  private:
+  friend class AstContext;
+
   ArrayType(QualType contained_type, std::optional<std::size_t> num_elements);
 
   QualType contained_type_;
@@ -325,6 +369,8 @@ class StructType : public Type {
   static std::int32_t MakeAlign(std::int32_t offset, std::int32_t align);
 
  private:
+  friend class AstContext;
+
   StructType(bool is_struct, const std::string& name, Scope* parent);
 
   void AddLLVMType(Type* type);
@@ -371,10 +417,18 @@ class FunctionType : public Type {
   const std::vector<ObjectExpr*>& GetParams() const;
   void SetFuncSpec(std::uint32_t func_spec);
   bool IsInline() const;
+  // C99 6.7.4p7, 该声明有 inline 且没有 extern, 如果函数的所有文件作用域
+  // 声明都是这样, 它的定义就是内联定义, 不提供外部定义
+  void SetInlineDefinition(bool inline_definition);
+  bool IsInlineDefinition() const;
+  void SetAttrs(const Attributes& attrs);
+  const Attributes& GetAttrs() const;
   void SetName(const std::string& name);
   const std::string& GetName() const;
 
  private:
+  friend class AstContext;
+
   FunctionType(QualType return_type, std::vector<ObjectExpr*> param,
                bool is_var_args);
 
@@ -383,8 +437,13 @@ class FunctionType : public Type {
   bool is_var_args_;
 
   std::uint32_t func_spec_{};
+  bool inline_definition_{};
+  Attributes attrs_;
 
   std::string name_;
 };
 
+// 类型分配在 AstCtx 中, CompilationContext 释放时清除缓存的类型
+void ClearTypeCache();
+
 }  // namespace kcc
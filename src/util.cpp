@@ -4,6 +4,7 @@
 
 #include "util.h"
 
+#include <sys/mman.h>
 #include <unistd.h>
 #include <wait.h>
 
@@ -14,13 +15,62 @@
 #include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <mutex>
+#include <system_error>
 
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Signals.h>
 #include <llvm/Support/raw_ostream.h>
 
 #include "error.h"
 
 namespace kcc {
 
+namespace {
+
+// 第 i 个输入文件的目标文件, 在编译时才创建. 同一路径出现多次时各自
+// 使用不同的目标文件
+std::vector<std::vector<std::string>> ObjFiles;
+
+std::vector<std::int32_t> ObjFileFds;
+
+// 编译线程同时创建目标文件
+std::mutex ObjFileMutex;
+
+// Error 通过 std::exit 退出时不会展开栈, 静态对象的析构函数仍会执行,
+// 因此在这里删除临时文件. 收到信号时由 LLVM 删除
+struct ObjFileGuard {
+  ~ObjFileGuard() { RemoveFiles(); }
+} Guard;
+
+// 链接用的目标文件优先放在 memfd 中, 以 /proc/self/fd/N 的路径交给 lld,
+// 不经过文件系统. memfd 不可用时使用名字唯一的临时文件, 因此不同目录中
+// 的同名文件, 以及同时运行的多个 kcc 不会相互覆盖
+std::string CreateObjFile(const std::string &name) {
+  auto file_name{std::filesystem::path{name}.filename().string()};
+  std::lock_guard lock{ObjFileMutex};
+
+  if (auto fd{memfd_create(file_name.c_str(), MFD_CLOEXEC)}; fd != -1) {
+    ObjFileFds.push_back(fd);
+    return "/proc/self/fd/" + std::to_string(fd);
+  }
+
+  std::int32_t fd;
+  llvm::SmallString<128> path;
+  if (auto error_code{
+          llvm::sys::fs::createTemporaryFile(file_name, "o", fd, path)}) {
+    Error("can not create temporary file: {}", error_code.message());
+  }
+  close(fd);
+
+  llvm::sys::RemoveFileOnSignal(path);
+  RemoveFile.push_back(path.str().str());
+  return path.str().str();
+}
+
+}  // namespace
+
 void InitCommandLine(int argc, char *argv[]) {
   llvm::cl::HideUnrelatedOptions(Category);
 
@@ -118,12 +168,23 @@ void CommandLineCheck() {
     item = "-l" + item;
   }
 
-  for (const auto &item : InputFilePaths) {
-    ObjFile.push_back(GetObjFile(item));
+  if (ParallelCodegen == 0) {
+    Error("invalid value '0' in '-fparallel-codegen'");
   }
 
-  for (const auto &item : InputFilePaths) {
-    RemoveFile.push_back(GetObjFile(item));
+  // LLVM 的 time trace profiler 是全局的, 同时只能记录一个线程
+  if (TimeTrace) {
+    Jobs = 1;
+    ParallelCodegen = 1;
+  }
+
+  // 峰值内存是整个进程的
+  if (PrintStats) {
+    Jobs = 1;
+  }
+
+  if (!DoNotLink()) {
+    ObjFiles.resize(std::size(InputFilePaths));
   }
 }
 
@@ -171,9 +232,23 @@ void EnsureFileExists(const std::string &file_name) {
   }
 }
 
-std::string GetObjFile(const std::string &name) {
-  auto file_name{std::filesystem::path{name + ".o"}};
-  return ("/tmp" / file_name).string();
+const std::vector<std::string> &GetObjFiles(std::size_t index) {
+  auto &files{ObjFiles.at(index)};
+  if (!std::empty(files)) {
+    return files;
+  }
+
+  const auto &name{InputFilePaths[index]};
+  // -flto 时由链接器划分
+  if (ParallelCodegen <= 1 || LTO != LTOKind::kNone) {
+    files.push_back(CreateObjFile(name));
+  } else {
+    for (std::uint32_t i{}; i < ParallelCodegen; ++i) {
+      files.push_back(CreateObjFile(name + "." + std::to_string(i)));
+    }
+  }
+
+  return files;
 }
 
 std::string GetFileName(const std::string &name, std::string_view extension) {
@@ -182,8 +257,16 @@ std::string GetFileName(const std::string &name, std::string_view extension) {
 
 void RemoveFiles() {
   for (const auto &item : RemoveFile) {
-    std::filesystem::remove(item);
+    std::error_code error_code;
+    std::filesystem::remove(item, error_code);
+    llvm::sys::DontRemoveFileOnSignal(item);
+  }
+  RemoveFile.clear();
+
+  for (auto fd : ObjFileFds) {
+    close(fd);
   }
+  ObjFileFds.clear();
 }
 
 bool CommandSuccess(std::int32_t status) {
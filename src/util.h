@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <string_view>
@@ -19,6 +20,8 @@ enum class Langs { kC };
 
 enum class LangStds { kC89, kC99, kC11, kC17, kGnu89, kGnu99, kGnu11, kGnu17 };
 
+enum class LTOKind { kNone, kFull, kThin };
+
 inline std::vector<std::string> ObjFile;
 
 inline std::vector<std::string> SoFile;
@@ -84,6 +87,26 @@ inline llvm::cl::opt<bool> OutputAssembly{
 inline llvm::cl::opt<bool> Timing{
     "t", llvm::cl::desc{"Print the amount of time"}, llvm::cl::cat{Category}};
 
+inline llvm::cl::opt<bool> TimeReport{
+    "ftime-report",
+    llvm::cl::desc{"Print the time spent in each optimization and code "
+                   "generation pass"},
+    llvm::cl::cat{Category}};
+
+// 翻译单元依次编译, 并忽略 -fparallel-codegen, 以免多个线程同时记录
+inline llvm::cl::opt<bool> TimeTrace{
+    "ftime-trace",
+    llvm::cl::desc{"Write a Chrome trace of each compilation to <file>.json "
+                   "and print a summary of the time spent in each phase"},
+    llvm::cl::cat{Category}};
+
+// 与 -ftime-trace 相同, 翻译单元依次编译, 以便得到每个阶段的峰值内存
+inline llvm::cl::opt<bool> PrintStats{
+    "print-stats",
+    llvm::cl::desc{"Print memory usage and statistics of each compilation "
+                   "as JSON to stderr"},
+    llvm::cl::cat{Category}};
+
 inline llvm::cl::opt<bool> Shared{"shared",
                                   llvm::cl::desc{"Generate dynamic library"},
                                   llvm::cl::cat{Category}};
@@ -104,6 +127,45 @@ inline llvm::cl::opt<bool> Debug{
     "g", llvm::cl::desc{"Generate source-level debug information"},
     llvm::cl::cat{Category}};
 
+// 0 表示使用硬件支持的并发线程数
+inline llvm::cl::opt<std::uint32_t> Jobs{
+    "j", llvm::cl::desc{"Number of translation units compiled in parallel"},
+    llvm::cl::value_desc{"N"}, llvm::cl::init(0), llvm::cl::Prefix,
+    llvm::cl::cat{Category}};
+
+// 目标文件中是 bitcode, 优化和代码生成在链接时由 lld 完成
+inline llvm::cl::opt<LTOKind> LTO{
+    "flto",
+    llvm::cl::desc{"Enable link time optimization"},
+    llvm::cl::init(LTOKind::kNone),
+    llvm::cl::ValueOptional,
+    llvm::cl::values(
+        clEnumValN(LTOKind::kFull, "full", "Full LTO (default)"),
+        clEnumValN(LTOKind::kThin, "thin", "ThinLTO"),
+        // -flto
+        clEnumValN(LTOKind::kFull, "", "")),
+    llvm::cl::cat{Category}};
+
+// 默认不使用缓存, 避免多个用户共享同一个目录
+inline llvm::cl::opt<std::string> LTOCacheDir{
+    "flto-cache-dir",
+    llvm::cl::desc{"Directory for the ThinLTO cache (disabled by default)"},
+    llvm::cl::value_desc{"directory"}, llvm::cl::cat{Category}};
+
+// 只在链接时生效, 每个翻译单元生成 N 个目标文件
+inline llvm::cl::opt<std::uint32_t> ParallelCodegen{
+    "fparallel-codegen",
+    llvm::cl::desc{"Split each translation unit into <N> partitions and "
+                   "generate code for them in parallel"},
+    llvm::cl::value_desc{"N"}, llvm::cl::init(1), llvm::cl::cat{Category}};
+
+// 0 表示不限制
+inline llvm::cl::opt<std::uint32_t> ErrorLimit{
+    "ferror-limit",
+    llvm::cl::desc{"Stop reporting errors after <N> errors in a translation "
+                   "unit (default 20)"},
+    llvm::cl::value_desc{"N"}, llvm::cl::init(20), llvm::cl::cat{Category}};
+
 // 忽略
 inline llvm::cl::opt<LangStds> LangStd{
     "std",
@@ -134,6 +196,13 @@ inline llvm::cl::opt<bool> FPic{
     "fPIC", llvm::cl::desc{"Emit position-independent code"},
     llvm::cl::cat{Category}};
 
+// 允许通过不同类型的左值访问同一个对象, 不生成 TBAA 元数据
+inline llvm::cl::opt<bool> NoStrictAliasing{
+    "fno-strict-aliasing",
+    llvm::cl::desc{"Do not assume that objects of different types never "
+                   "occupy the same memory"},
+    llvm::cl::cat{Category}};
+
 inline llvm::cl::opt<bool> FPch{
     "fpch-preprocess",
     llvm::cl::desc{"Allows use of a precompiled header together with -E"},
@@ -162,7 +231,9 @@ void TimingEnd(const std::string &str = "");
 
 void EnsureFileExists(const std::string &file_name);
 
-std::string GetObjFile(const std::string &name);
+// 链接时第 index 个输入文件对应的目标文件, 第一次调用时创建,
+// -fparallel-codegen=N 时有 N 个
+const std::vector<std::string> &GetObjFiles(std::size_t index);
 
 std::string GetFileName(const std::string &name, std::string_view extension);
 
@@ -0,0 +1,166 @@
+//
+// Created by kaiser on 2020/1/17.
+//
+
+// 结构体参数和返回值按照 x86-64 System V ABI 传递
+
+#include <stdlib.h>
+
+#include "test.h"
+
+typedef struct {
+  float a, b, c;
+} float3_t;
+
+typedef struct {
+  double d;
+  long l;
+} dl_t;
+
+typedef struct {
+  char a, b, c;
+} char3_t;
+
+typedef struct {
+  short a, b, c;
+} short3_t;
+
+typedef struct {
+  int a, b, c;
+} int3_t;
+
+typedef struct {
+  long a, b, c;
+} long3_t;
+
+typedef struct {
+  long double x;
+  int i;
+} ldouble_t;
+
+typedef struct {
+  long a, b;
+} long2_t;
+
+typedef struct {
+  double a, b;
+} double2_t;
+
+__attribute__((noinline)) float3_t scale_float3(float3_t v, float k) {
+  return (float3_t){v.a * k, v.b * k, v.c * k};
+}
+
+__attribute__((noinline)) dl_t swap_dl(dl_t v) {
+  return (dl_t){(double)v.l, (long)v.d};
+}
+
+__attribute__((noinline)) char3_t inc_char3(char3_t v) {
+  return (char3_t){v.a + 1, v.b + 1, v.c + 1};
+}
+
+__attribute__((noinline)) short3_t inc_short3(short3_t v) {
+  return (short3_t){v.a + 1, v.b + 1, v.c + 1};
+}
+
+__attribute__((noinline)) int3_t inc_int3(int3_t v) {
+  return (int3_t){v.a + 1, v.b + 1, v.c + 1};
+}
+
+// 大于 16 字节, 通过栈传递, 修改参数不影响调用者的对象
+__attribute__((noinline)) long3_t inc_long3(long3_t v) {
+  ++v.a;
+  ++v.b;
+  ++v.c;
+  return v;
+}
+
+// long double 属于 X87 类, 通过栈传递
+__attribute__((noinline)) ldouble_t twice_ldouble(ldouble_t v) {
+  v.x *= 2;
+  v.i *= 2;
+  return v;
+}
+
+// 整数寄存器用完, 整个结构体通过栈传递, 之后的浮点参数仍然使用寄存器
+__attribute__((noinline)) long no_int_regs(long a, long b, long c, long d,
+                                           long e, long2_t v, double2_t w) {
+  return a + b + c + d + e + v.a * 10 + v.b * 100 + (long)(w.a + w.b);
+}
+
+__attribute__((noinline)) double no_sse_regs(double a, double b, double c,
+                                             double d, double e, double f,
+                                             double g, double2_t v, long2_t w) {
+  return a + b + c + d + e + f + g + v.a * 10 + v.b * 100 + w.a + w.b;
+}
+
+static void test_small() {
+  float3_t f = scale_float3((float3_t){1, 2, 3}, 2);
+  expectf(2, f.a);
+  expectf(4, f.b);
+  expectf(6, f.c);
+
+  dl_t dl = swap_dl((dl_t){1.5, 7});
+  expectd(7, dl.d);
+  expectl(1, dl.l);
+
+  char3_t c = inc_char3((char3_t){1, 2, 3});
+  expect(2, c.a);
+  expect(3, c.b);
+  expect(4, c.c);
+
+  short3_t s = inc_short3((short3_t){-1, 1000, 3});
+  expect(0, s.a);
+  expect(1001, s.b);
+  expect(4, s.c);
+
+  int3_t i = inc_int3((int3_t){1, 2, 3});
+  expect(2, i.a);
+  expect(3, i.b);
+  expect(4, i.c);
+}
+
+static void test_memory() {
+  long3_t l = {1, 2, 3};
+  long3_t r = inc_long3(l);
+  expectl(1, l.a);
+  expectl(3, l.c);
+  expectl(2, r.a);
+  expectl(3, r.b);
+  expectl(4, r.c);
+
+  ldouble_t ld = twice_ldouble((ldouble_t){1.25, 3});
+  expect(1, ld.x == 2.5);
+  expect(6, ld.i);
+}
+
+static void test_regs() {
+  expectl(15 + 60 + 700 + 9,
+          no_int_regs(1, 2, 3, 4, 5, (long2_t){6, 7}, (double2_t){4, 5}));
+  expectd(28 + 80 + 900 + 21,
+          no_sse_regs(1, 2, 3, 4, 5, 6, 7, (double2_t){8, 9},
+                      (long2_t){10, 11}));
+}
+
+// 和 libc 之间传递结构体
+static void test_libc() {
+  div_t d = div(17, 5);
+  expect(3, d.quot);
+  expect(2, d.rem);
+
+  ldiv_t ld = ldiv(-17L, 5L);
+  expectl(-3, ld.quot);
+  expectl(-2, ld.rem);
+
+  lldiv_t lld = lldiv(1LL << 40, 3);
+  expectl((1LL << 40) / 3, lld.quot);
+  expectl(1, lld.rem);
+}
+
+void testmain() {
+  print("abi");
+
+  test_small();
+  test_memory();
+  test_regs();
+  test_libc();
+}
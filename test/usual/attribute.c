@@ -0,0 +1,105 @@
+// GNU 扩展, __attribute__((...))
+
+#include <stdlib.h>
+
+#include "test.h"
+
+int aligned_global __attribute__((aligned(64)));
+static int used_global __attribute__((used)) = 1;
+int section_global __attribute__((section(".data.kcc"))) = 2;
+__attribute__((visibility("hidden"))) int hidden_global = 3;
+
+__attribute__((const)) static int square(int x) { return x * x; }
+
+__attribute__((pure)) static int sum(const int *arr, int n) {
+  int ret = 0;
+  for (int i = 0; i < n; ++i) {
+    ret += arr[i];
+  }
+  return ret;
+}
+
+static inline __attribute__((always_inline)) int add(int a, int b) {
+  return a + b;
+}
+
+__attribute__((noinline)) static int sub(int a, int b) { return a - b; }
+
+__attribute__((flatten)) static int add_sub(int a, int b) {
+  return sub(add(a, b), b);
+}
+
+__attribute__((cold)) static int cold_path(int x) { return -x; }
+
+__attribute__((hot)) static int hot_path(int x) {
+  if (x < 0) {
+    return cold_path(x);
+  }
+  return x;
+}
+
+// 返回的指针不能与任何其他存活的对象重叠
+__attribute__((malloc)) static void *alloc_buffer(size_t size) {
+  return malloc(size);
+}
+
+__attribute__((weak)) int weak_func(void) { return 4; }
+
+__attribute__((used)) static int used_func(void) { return 5; }
+
+void noreturn_func(void) __attribute__((__noreturn__));
+
+__attribute__((unused)) static int unused_func(void) { return 6; }
+
+// 属性只属于所在的声明, 不影响使用同一 typedef 的其他函数
+typedef int fn_t(int);
+fn_t abort_with __attribute__((noreturn, const));
+fn_t count_calls;
+
+static int call_count;
+
+int count_calls(int x) {
+  ++call_count;
+  return x;
+}
+
+void testmain() {
+  print("attribute");
+
+  int aligned_local __attribute__((aligned(32))) = 7;
+  expect(0, (long)&aligned_global % 64);
+  expect(0, (long)&aligned_local % 32);
+  expect(7, aligned_local);
+
+  expect(1, used_global);
+  expect(2, section_global);
+  expect(3, hidden_global);
+
+  expect(9, square(3));
+  int arr[] = {1, 2, 3};
+  expect(6, sum(arr, 3));
+
+  expect(3, add(1, 2));
+  expect(1, sub(3, 2));
+  expect(5, add_sub(5, 2));
+
+  expect(1, hot_path(-1));
+  expect(2, hot_path(2));
+
+  char local[16];
+  char *p = alloc_buffer(16);
+  char *q = alloc_buffer(16);
+  expect(1, p != 0 && q != 0);
+  expect(1, p != q);
+  expect(1, p != local);
+  p[0] = 'p';
+  q[0] = 'q';
+  expect('p', p[0]);
+  free(p);
+  free(q);
+  expect(4, weak_func());
+
+  count_calls(1);
+  count_calls(2);
+  expect(2, call_count);
+}
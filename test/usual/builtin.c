@@ -0,0 +1,105 @@
+// GNU 扩展, 内置函数
+
+#include "test.h"
+
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+static int branch(int x) {
+  if (unlikely(x < 0)) {
+    return -1;
+  }
+  if (__builtin_expect_with_probability(x, 10, 0.9) == 10) {
+    return 10;
+  }
+  while (likely(x > 100)) {
+    x /= 2;
+  }
+  return x;
+}
+
+static int sign(int x) {
+  if (x > 0) {
+    return 1;
+  } else if (x < 0) {
+    return -1;
+  } else if (x == 0) {
+    return 0;
+  }
+  __builtin_unreachable();
+}
+
+static inline int is_constant(int x) { return __builtin_constant_p(x); }
+
+static int sum(const int *arr, int n) {
+  const int *p = __builtin_assume_aligned(arr, 16);
+  int ret = 0;
+  for (int i = 0; i < n; ++i) {
+    __builtin_prefetch(p + i + 8);
+    __builtin_prefetch(p + i + 16, 0, 1);
+    ret += p[i];
+  }
+  return ret;
+}
+
+static void test_expect() {
+  expect(-1, branch(-5));
+  expect(10, branch(10));
+  expect(75, branch(300));
+  expect(5, branch(5));
+  expect(1, likely(3));
+  expect(0, unlikely(0));
+}
+
+static void test_bit() {
+  expect(3, __builtin_popcount(7));
+  expect(33, __builtin_popcountl(0x1ffffffffUL));
+  expect(64, __builtin_popcountll(~0ULL));
+  expect(31, __builtin_clz(1));
+  expect(63, __builtin_clzl(1));
+  expect(0, __builtin_clzll(1ULL << 63));
+  expect(4, __builtin_ctz(16));
+  expect(40, __builtin_ctzl(1UL << 40));
+  expect(63, __builtin_ctzll(1ULL << 63));
+}
+
+static void test_bswap() {
+  expect(0x3412, __builtin_bswap16(0x1234));
+  expect(0x78563412, __builtin_bswap32(0x12345678));
+  expectl(0x0807060504030201, __builtin_bswap64(0x0102030405060708));
+}
+
+static void test_memory() {
+  int src[4] __attribute__((aligned(16))) = {1, 2, 3, 4};
+  int dst[4] __attribute__((aligned(16)));
+  expect(1, __builtin_memcpy(dst, src, sizeof(src)) == dst);
+  expect(10, sum(dst, 4));
+
+  char buf[8];
+  expect(1, __builtin_memset(buf, 'a', sizeof(buf)) == buf);
+  expect('a', buf[0]);
+  expect('a', buf[7]);
+}
+
+static void test_misc() {
+  expect(1, sign(5));
+  expect(-1, sign(-5));
+  expect(0, sign(0));
+
+  int x = 1;
+  expect(1, __builtin_constant_p(1));
+  expect(1, __builtin_constant_p(1 + 2 * 3));
+  expect(0, __builtin_constant_p(x++));
+  expect(1, x);
+  expect(1, is_constant(x) == 0 || is_constant(x) == 1);
+}
+
+void testmain() {
+  print("builtin");
+
+  test_expect();
+  test_bit();
+  test_bswap();
+  test_memory();
+  test_misc();
+}
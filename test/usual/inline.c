@@ -0,0 +1,19 @@
+// 与 inline_ext.c 一起编译, 内联定义的函数使用其中的外部定义
+
+#include "inline.h"
+#include "test.h"
+
+int thrice(int x);
+int quad(int x);
+
+void testmain() {
+  print("inline");
+
+  expect(4, twice(2));
+  expect(9, square(3));
+  expect(9, thrice(3));
+  expect(8, quad(2));
+
+  int (*p)(int) = twice;
+  expect(6, p(3));
+}
@@ -0,0 +1,5 @@
+// C99 6.7.4p7, 只有 inline 的定义不提供外部定义
+
+inline int twice(int x) { return 2 * x; }
+
+inline int square(int x) { return x * x; }
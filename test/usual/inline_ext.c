@@ -0,0 +1,12 @@
+// 为 inline.h 中的内联定义提供外部定义
+
+#include "inline.h"
+
+extern int twice(int x);
+extern inline int square(int x);
+
+// 没有被引用的外部定义也要生成
+extern inline int thrice(int x) { return 3 * x; }
+
+inline int quad(int x) { return 4 * x; }
+int quad(int x);
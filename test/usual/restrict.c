@@ -0,0 +1,85 @@
+// restrict 指针的循环在 -O3 时不需要运行时的别名检查就可以向量化
+
+#include "test.h"
+
+#define N 1000
+
+struct vec {
+  float *restrict dst;
+  const float *restrict src;
+};
+
+void add_restrict(int n, float *restrict a, const float *restrict b,
+                  const float *restrict c) {
+  for (int i = 0; i < n; ++i) {
+    a[i] = b[i] + c[i];
+  }
+}
+
+void add_plain(int n, float *a, const float *b, const float *c) {
+  for (int i = 0; i < n; ++i) {
+    a[i] = b[i] + c[i];
+  }
+}
+
+void scale_local(int n, float *x, float *y) {
+  float *restrict dst = x;
+  const float *restrict src = y;
+  for (int i = 0; i < n; ++i) {
+    dst[i] = src[i] * 2;
+  }
+}
+
+void copy_member(int n, struct vec v) {
+  for (int i = 0; i < n; ++i) {
+    v.dst[i] = v.src[i] + 1;
+  }
+}
+
+// 每次迭代中 p 和 q 不重叠, 但上一次迭代的 q 就是这一次的 p
+void shift_loop(int n, int *a) {
+  for (int i = 0; i < n - 1; ++i) {
+    int *restrict p = a + i, *restrict q = a + i + 1;
+    *q = *p + 1;
+  }
+}
+
+static float a[N], b[N], c[N];
+static int d[N];
+
+void testmain() {
+  print("restrict");
+
+  for (int i = 0; i < N; ++i) {
+    b[i] = i;
+    c[i] = 2 * i;
+  }
+
+  add_restrict(N, a, b, c);
+  for (int i = 0; i < N; ++i) {
+    expectf(3 * i, a[i]);
+  }
+
+  scale_local(N, a, b);
+  for (int i = 0; i < N; ++i) {
+    expectf(2 * i, a[i]);
+  }
+
+  struct vec v = {a, c};
+  copy_member(N, v);
+  for (int i = 0; i < N; ++i) {
+    expectf(2 * i + 1, a[i]);
+  }
+
+  shift_loop(N, d);
+  for (int i = 0; i < N; ++i) {
+    expect(i, d[i]);
+  }
+
+  // 没有 restrict 时允许重叠
+  add_plain(N - 1, a + 1, a, b);
+  expectf(1, a[0]);
+  expectf(1, a[1]);
+  expectf(2, a[2]);
+  expectf(4, a[3]);
+}
@@ -0,0 +1,41 @@
+// 通过联合体的成员 (包括其中的数组元素) 访问时不使用 TBAA,
+// 可以用来转换类型
+
+#include "test.h"
+
+union pun {
+  float floats[4];
+  int ints[4];
+};
+
+int pun_member(union pun *u) {
+  u->floats[0] = 1.0f;
+  return u->ints[0];
+}
+
+int pun_subscript(union pun *u, int i) {
+  u->floats[i] = 2.0f;
+  return u->ints[i];
+}
+
+int pun_addr(union pun *u) {
+  *&u->floats[1] = 4.0f;
+  return *&u->ints[1];
+}
+
+int plain_subscript(float *f, int *n, int i) {
+  f[i] = 1.0f;
+  return n[i];
+}
+
+void testmain() {
+  print("tbaa");
+
+  union pun u = {0};
+  expect(0x3f800000, pun_member(&u));
+  expect(0x40000000, pun_subscript(&u, 2));
+  expect(0x40800000, pun_addr(&u));
+
+  int n[2] = {3, 4};
+  expect(4, plain_subscript((float *)&u, n, 1));
+}